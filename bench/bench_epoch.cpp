@@ -0,0 +1,157 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Konstantin Boyarinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "common/utils.hpp"
+#include "tomkv/internal/epoch.hpp"
+#include "boost/program_options/options_description.hpp"
+#include "boost/program_options/variables_map.hpp"
+#include "boost/program_options/parsers.hpp"
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+namespace po = boost::program_options;
+
+struct shared_object {
+    shared_object( std::uint64_t v ) : value(v) {}
+
+    std::uint64_t value;
+};
+
+// Each thread performs num_operations reads of the shared object, update_percentage of them are replacements
+// The replaced object is retired to the epoch domain
+void epoch_benchmark( std::size_t update_percentage, std::size_t num_threads, std::size_t num_operations ) {
+    utils::make_performance_measurements([=] {
+        tomkv::internal::epoch_domain domain;
+        std::atomic<shared_object*> shared{new shared_object(0)};
+        std::atomic<std::uint64_t> checksum{0};
+        std::vector<std::thread> thread_pool;
+
+        for (std::size_t t = 0; t < num_threads; ++t) {
+            thread_pool.emplace_back([&] {
+                std::uint64_t sum = 0;
+                for (std::size_t i = 0; i < num_operations; ++i) {
+                    if (i % 100 < update_percentage) {
+                        shared_object* old_object = shared.exchange(new shared_object(i), std::memory_order_acq_rel);
+                        domain.retire(old_object);
+                    } else {
+                        tomkv::internal::epoch_domain::guard guard{domain};
+                        sum += shared.load(std::memory_order_acquire)->value;
+                    }
+                }
+                checksum += sum;
+            });
+        }
+
+        for (auto& thr : thread_pool) {
+            thr.join();
+        }
+        delete shared.load();
+    });
+}
+
+// The same workload, the shared object is protected by the reader-writer lock
+void rwlock_benchmark( std::size_t update_percentage, std::size_t num_threads, std::size_t num_operations ) {
+    utils::make_performance_measurements([=] {
+        std::shared_mutex mutex;
+        shared_object* shared = new shared_object(0);
+        std::atomic<std::uint64_t> checksum{0};
+        std::vector<std::thread> thread_pool;
+
+        for (std::size_t t = 0; t < num_threads; ++t) {
+            thread_pool.emplace_back([&] {
+                std::uint64_t sum = 0;
+                for (std::size_t i = 0; i < num_operations; ++i) {
+                    if (i % 100 < update_percentage) {
+                        shared_object* new_object = new shared_object(i);
+                        shared_object* old_object = nullptr;
+                        {
+                            std::unique_lock<std::shared_mutex> lock(mutex);
+                            old_object = shared;
+                            shared = new_object;
+                        }
+                        delete old_object;
+                    } else {
+                        std::shared_lock<std::shared_mutex> lock(mutex);
+                        sum += shared->value;
+                    }
+                }
+                checksum += sum;
+            });
+        }
+
+        for (auto& thr : thread_pool) {
+            thr.join();
+        }
+        delete shared;
+    });
+}
+
+int main( int argc, char* argv[] ) {
+    std::size_t update_percentage = 0;
+    std::size_t num_threads = 0;
+    std::size_t num_operations = 0;
+
+    po::options_description desc("Allowed options");
+    desc.add_options()
+        ("help", "Print help message")
+        ("update", po::value<std::size_t>(&update_percentage)->default_value(10), "Percentage of operations that replace the shared object")
+        ("num-threads", po::value<std::size_t>(&num_threads)->default_value(std::thread::hardware_concurrency()), "Number of threads")
+        ("num-operations", po::value<std::size_t>(&num_operations)->default_value(1000000), "Number of operations per thread")
+        ("use-rwlock", "Protect the shared object by std::shared_mutex instead of the epoch-based reclamation")
+        ("verbose", "Verbose mode");
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (vm.count("help")) {
+        std::cout << desc << std::endl;
+        return 0;
+    }
+
+    if (update_percentage > 100) {
+        std::cout << "Error: incorrect percentage of updates" << std::endl;
+        return 1;
+    }
+
+    bool use_rwlock = vm.count("use-rwlock") != 0;
+    if (vm.count("verbose")) {
+        std::cout << "Testing " << (use_rwlock ? "std::shared_mutex" : "tomkv::internal::epoch_domain") << std::endl;
+        std::cout << "Info:" << std::endl;
+        std::cout << "\tNumber of threads = " << num_threads << std::endl;
+        std::cout << "\tNumber of operations per thread = " << num_operations << std::endl;
+        std::cout << "\tPercentage of updates = " << update_percentage << std::endl;
+    }
+
+    if (use_rwlock) {
+        rwlock_benchmark(update_percentage, num_threads, num_operations);
+    } else {
+        epoch_benchmark(update_percentage, num_threads, num_operations);
+    }
+}
@@ -0,0 +1,208 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Konstantin Boyarinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "common/utils.hpp"
+#include "tomkv/ordered_map.hpp"
+#include "boost/program_options/options_description.hpp"
+#include "boost/program_options/variables_map.hpp"
+#include "boost/program_options/parsers.hpp"
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+namespace po = boost::program_options;
+
+struct workload {
+    std::size_t insert_percentage;
+    std::size_t erase_percentage;
+    std::size_t scan_percentage;
+    std::size_t scan_length;
+    std::size_t key_range;
+    std::size_t num_threads;
+    std::size_t num_operations;
+};
+
+enum class operation { insert, erase, scan, lookup };
+
+// Each thread performs num_operations random operations on the random keys, the rest of the operations are lookups
+template <typename Map, typename Body>
+void run_workload( Map& map, const workload& w, const Body& body ) {
+    utils::make_performance_measurements([&] {
+        std::atomic<std::uint64_t> checksum{0};
+        std::vector<std::thread> thread_pool;
+
+        for (std::size_t t = 0; t < w.num_threads; ++t) {
+            thread_pool.emplace_back([&, t] {
+                std::mt19937_64 random(t);
+                std::uint64_t sum = 0;
+                for (std::size_t i = 0; i < w.num_operations; ++i) {
+                    std::uint64_t r = random();
+                    std::uint64_t key = (r >> 8) % w.key_range;
+                    std::size_t percent = r % 100;
+
+                    operation op = operation::lookup;
+                    if (percent < w.insert_percentage) {
+                        op = operation::insert;
+                    } else if (percent < w.insert_percentage + w.erase_percentage) {
+                        op = operation::erase;
+                    } else if (percent < w.insert_percentage + w.erase_percentage + w.scan_percentage) {
+                        op = operation::scan;
+                    }
+                    sum += body(map, op, key);
+                }
+                checksum += sum;
+            });
+        }
+
+        for (auto& thr : thread_pool) {
+            thr.join();
+        }
+    });
+}
+
+void ordered_map_benchmark( const workload& w ) {
+    tomkv::ordered_map<std::uint64_t, std::uint64_t> map;
+    for (std::uint64_t key = 0; key < w.key_range; key += 2) {
+        map.emplace(key, key);
+    }
+
+    run_workload(map, w, [&w]( auto& m, operation op, std::uint64_t key ) -> std::uint64_t {
+        switch (op) {
+        case operation::insert:
+            return m.emplace(key, key);
+        case operation::erase:
+            return m.erase(key);
+        case operation::scan: {
+            std::uint64_t sum = 0;
+            std::size_t count = 0;
+            typename std::decay_t<decltype(m)>::read_accessor racc;
+            for (bool found = m.lower_bound(racc, key); found && count < w.scan_length; found = m.next(racc), ++count) {
+                sum += racc.mapped();
+            }
+            return sum;
+        }
+        default:
+            return m.find_copy(key).value_or(0);
+        }
+    });
+}
+
+// The same workload, std::map is protected by the reader-writer lock
+void std_map_benchmark( const workload& w ) {
+    struct locked_map {
+        std::shared_mutex mutex;
+        std::map<std::uint64_t, std::uint64_t> map;
+    } map;
+    for (std::uint64_t key = 0; key < w.key_range; key += 2) {
+        map.map.emplace(key, key);
+    }
+
+    run_workload(map, w, [&w]( locked_map& m, operation op, std::uint64_t key ) -> std::uint64_t {
+        switch (op) {
+        case operation::insert: {
+            std::unique_lock<std::shared_mutex> lock(m.mutex);
+            return m.map.emplace(key, key).second;
+        }
+        case operation::erase: {
+            std::unique_lock<std::shared_mutex> lock(m.mutex);
+            return m.map.erase(key);
+        }
+        case operation::scan: {
+            std::shared_lock<std::shared_mutex> lock(m.mutex);
+            std::uint64_t sum = 0;
+            std::size_t count = 0;
+            for (auto it = m.map.lower_bound(key); it != m.map.end() && count < w.scan_length; ++it, ++count) {
+                sum += it->second;
+            }
+            return sum;
+        }
+        default: {
+            std::shared_lock<std::shared_mutex> lock(m.mutex);
+            auto it = m.map.find(key);
+            return it == m.map.end() ? 0 : it->second;
+        }
+        }
+    });
+}
+
+int main( int argc, char* argv[] ) {
+    workload w{};
+
+    po::options_description desc("Allowed options");
+    desc.add_options()
+        ("help", "Print help message")
+        ("insert", po::value<std::size_t>(&w.insert_percentage)->default_value(10), "Percentage of insertions")
+        ("erase", po::value<std::size_t>(&w.erase_percentage)->default_value(10), "Percentage of erasures")
+        ("scan", po::value<std::size_t>(&w.scan_percentage)->default_value(10), "Percentage of range scans")
+        ("scan-length", po::value<std::size_t>(&w.scan_length)->default_value(100), "Number of elements visited by each scan")
+        ("key-range", po::value<std::size_t>(&w.key_range)->default_value(1000000), "Number of distinct keys, a half of them is inserted before the measurements")
+        ("num-threads", po::value<std::size_t>(&w.num_threads)->default_value(std::thread::hardware_concurrency()), "Number of threads")
+        ("num-operations", po::value<std::size_t>(&w.num_operations)->default_value(1000000), "Number of operations per thread")
+        ("use-std-map", "Use std::map protected by std::shared_mutex instead of tomkv::ordered_map")
+        ("verbose", "Verbose mode");
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (vm.count("help")) {
+        std::cout << desc << std::endl;
+        return 0;
+    }
+
+    if (w.insert_percentage + w.erase_percentage + w.scan_percentage > 100) {
+        std::cout << "Error: incorrect percentage of operations" << std::endl;
+        return 1;
+    }
+
+    if (w.key_range == 0) {
+        std::cout << "Error: key range should not be empty" << std::endl;
+        return 1;
+    }
+
+    bool use_std_map = vm.count("use-std-map") != 0;
+    if (vm.count("verbose")) {
+        std::cout << "Testing " << (use_std_map ? "std::map with std::shared_mutex" : "tomkv::ordered_map") << std::endl;
+        std::cout << "Info:" << std::endl;
+        std::cout << "\tNumber of threads = " << w.num_threads << std::endl;
+        std::cout << "\tNumber of operations per thread = " << w.num_operations << std::endl;
+        std::cout << "\tKey range = " << w.key_range << std::endl;
+        std::cout << "\tPercentage of insertions = " << w.insert_percentage << std::endl;
+        std::cout << "\tPercentage of erasures = " << w.erase_percentage << std::endl;
+        std::cout << "\tPercentage of scans = " << w.scan_percentage << std::endl;
+        std::cout << "\tScan length = " << w.scan_length << std::endl;
+    }
+
+    if (use_std_map) {
+        std_map_benchmark(w);
+    } else {
+        ordered_map_benchmark(w);
+    }
+}
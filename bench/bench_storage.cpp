@@ -22,7 +22,6 @@
  * SOFTWARE.
  */
 
-#include "common/utils.hpp"
 #include <tomkv/storage.hpp>
 #include <tomkv/tom_management.hpp>
 #include "boost/program_options/options_description.hpp"
@@ -30,154 +29,350 @@
 #include "boost/program_options/parsers.hpp"
 #include "boost/property_tree/ptree.hpp"
 #include "boost/property_tree/xml_parser.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <iomanip>
 #include <iostream>
-#include <cassert>
-#include <vector>
-#include <thread>
+#include <random>
 #include <string>
-#include <atomic>
+#include <thread>
+#include <vector>
 
 namespace po = boost::program_options;
 namespace pt = boost::property_tree;
 
-template <typename T>
-void suppress_unused( T&& ) {}
-
-bool verbose = true;
-
-template <typename Key, typename Mapped>
-void run_benchmark( std::size_t mount_percentage,
-                    std::size_t read_percentage,
-                    std::size_t write_percentage,
-                    std::size_t insert_percentage,
-                    std::size_t num_threads,
-                    std::size_t num_operations )
-{
-    assert(mount_percentage + read_percentage + write_percentage + insert_percentage);
-    std::size_t mount_threads = std::size_t(num_threads / 100. * mount_percentage);
-    std::size_t read_threads = std::size_t(num_threads / 100. * read_percentage);
-    std::size_t write_threads = std::size_t(num_threads / 100. * write_percentage);
-    std::size_t insert_threads = std::size_t(num_threads / 100. * insert_percentage);
-
-    if (verbose) {
-        std::cout << "Info:" << std::endl;
-        std::cout << "\tTotal number of threads = " << num_threads << std::endl;
-        std::cout << "\tNumber of threads for mounting = " << mount_threads << std::endl;
-        std::cout << "\tNumber of threads for reading = " << read_threads << std::endl;
-        std::cout << "\tNumber of threads for writing = " << write_threads << std::endl;
-        std::cout << "\tNumber of threads for inserting = " << insert_threads << std::endl;
-        std::cout << "\tNumber of operations per thread = " << num_operations << std::endl;
+using key_type = int;
+using mapped_type = int;
+using storage_type = tomkv::storage<key_type, mapped_type>;
+
+enum class operation { read, write, insert, remove, mount, count };
+
+constexpr std::size_t operation_count = std::size_t(operation::count);
+const char* operation_names[operation_count] = { "read", "write", "insert", "remove", "mount" };
+
+enum class key_distribution { uniform, zipfian, hot_set };
+
+struct workload {
+    // Shape of the toms
+    std::size_t num_toms;
+    std::size_t depth;
+    std::size_t fan_out;
+    // Mount points, each of them mounts mount_fan_out toms with the increasing priorities
+    std::size_t num_mounts;
+    std::size_t mount_fan_out;
+    // Percentage of the nodes created with the lifetime
+    std::size_t lifetime_percentage;
+    std::size_t lifetime_seconds;
+    std::size_t reaper_period_ms;
+    // Percentage of each operation within each thread
+    std::array<std::size_t, operation_count> percentages;
+    key_distribution distribution;
+    double zipf_theta;
+    double hot_set_fraction;
+    std::size_t hot_set_percentage;
+    std::size_t num_threads;
+    std::size_t num_operations;
+};
+
+// Chooses the index of the target path in [0, n) according to the distribution
+// Rank 0 is the most popular one, the targets are shuffled, so the popular targets are spread over the mounts
+class key_generator {
+public:
+    key_generator( const workload& w, std::size_t n )
+        : my_distribution(w.distribution), my_n(n), my_theta(w.zipf_theta),
+          my_hot_count(std::max(std::size_t(double(n) * w.hot_set_fraction), std::size_t(1))),
+          my_hot_percentage(w.hot_set_percentage)
+    {
+        if (my_distribution == key_distribution::zipfian) {
+            // Zipfian generator by Gray et al., the zeta constants are computed once
+            my_zetan = zeta(my_n, my_theta);
+            double zeta2 = zeta(2, my_theta);
+            my_alpha = 1.0 / (1.0 - my_theta);
+            my_eta = (1.0 - std::pow(2.0 / double(my_n), 1.0 - my_theta)) / (1.0 - zeta2 / my_zetan);
+        }
     }
 
-    auto benchmark_body = [&] {
-        std::string tom_name = "tom.xml";
-        tomkv::create_empty_tom("tom.xml");
-
-        pt::ptree tree;
-        pt::read_xml(tom_name, tree);
+    template <typename Random>
+    std::size_t operator()( Random& random ) const {
+        switch (my_distribution) {
+        case key_distribution::zipfian: {
+            double u = std::uniform_real_distribution<double>(0.0, 1.0)(random);
+            double uz = u * my_zetan;
+            if (uz < 1.0) {
+                return 0;
+            }
+            if (uz < 1.0 + std::pow(0.5, my_theta)) {
+                return std::min(std::size_t(1), my_n - 1);
+            }
+            return std::min(std::size_t(double(my_n) * std::pow(my_eta * u - my_eta + 1.0, my_alpha)), my_n - 1);
+        }
+        case key_distribution::hot_set:
+            if (random() % 100 < my_hot_percentage || my_hot_count == my_n) {
+                return random() % my_hot_count;
+            }
+            return my_hot_count + random() % (my_n - my_hot_count);
+        default:
+            return random() % my_n;
+        }
+    }
+private:
+    static double zeta( std::size_t n, double theta ) {
+        double sum = 0;
+        for (std::size_t i = 1; i <= n; ++i) {
+            sum += 1.0 / std::pow(double(i), theta);
+        }
+        return sum;
+    }
 
-        tree.add("tom.root.a.key", Key(1));
-        tree.add("tom.root.a.mapped", Mapped(100));
+    key_distribution my_distribution;
+    std::size_t my_n;
+    double my_theta;
+    double my_zetan = 0;
+    double my_alpha = 0;
+    double my_eta = 0;
+    std::size_t my_hot_count;
+    std::size_t my_hot_percentage;
+};
+
+std::string tom_name( std::size_t index ) {
+    return "bench_tom_" + std::to_string(index) + ".xml";
+}
 
-        tree.add("tom.root.a.b.key", Key(2));
-        tree.add("tom.root.a.b.mapped", Mapped(200));
+std::string node_name( std::size_t index ) {
+    return "n" + std::to_string(index);
+}
 
-        pt::write_xml(tom_name, tree);
+// Adds fan_out children with depth levels of descendants to parent
+void add_subtree( pt::ptree& parent, std::size_t depth, const workload& w, std::mt19937_64& random, std::int64_t now ) {
+    if (depth == 0) {
+        return;
+    }
+    for (std::size_t i = 0; i < w.fan_out; ++i) {
+        pt::ptree& child = parent.add_child(node_name(i), pt::ptree());
+        child.put("key", key_type(random() % 1000000));
+        child.put("mapped", mapped_type(random() % 1000000));
+        if (random() % 100 < w.lifetime_percentage) {
+            child.put("date_created", now);
+            child.put("lifetime", w.lifetime_seconds);
+        }
+        add_subtree(child, depth - 1, w, random, now);
+    }
+}
 
-        tomkv::storage<Key, Mapped> st;
-        std::vector<std::thread> thread_pool;
+void create_toms( const workload& w ) {
+    std::mt19937_64 random(42);
+    std::int64_t now = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
 
-        std::string mount_path = "mnt";
-        std::string real_path = "a";
+    for (std::size_t t = 0; t < w.num_toms; ++t) {
+        tomkv::remove_tom(tom_name(t));
+        tomkv::create_empty_tom(tom_name(t));
 
-        std::atomic<bool> start_allowed = false;
-        st.mount(mount_path, tom_name, real_path);
+        pt::ptree tree;
+        pt::read_xml(tom_name(t), tree);
+        add_subtree(tree.get_child("tom.root"), w.depth, w, random, now);
+        pt::write_xml(tom_name(t), tree);
+    }
+}
 
-        // Fill the mount threads
-        for (std::size_t i = 0; i < mount_threads; ++i) {
-            thread_pool.emplace_back([num_operations, &st, &mount_path, &real_path, &tom_name, &start_allowed] {
-                while (start_allowed.load(std::memory_order_acquire) == false) {
-                    // Spin until the start is allowed
-                }
+// Appends the paths of the node and all of its descendants up to depth levels below it
+void collect_paths( const std::string& path, std::size_t depth, const workload& w, std::vector<std::string>& paths ) {
+    paths.push_back(path);
+    if (depth == 0) {
+        return;
+    }
+    for (std::size_t i = 0; i < w.fan_out; ++i) {
+        collect_paths(path + '/' + node_name(i), depth - 1, w, paths);
+    }
+}
 
-                for (std::size_t i = 0; i < num_operations; ++i) {
-                    st.mount(mount_path, tom_name, real_path + '/' + std::to_string(i));
-                }
-            });
+// Mount point i mounts the top-level node i % fan_out of mount_fan_out consecutive toms
+std::vector<std::string> mount_toms( storage_type& st, const workload& w ) {
+    std::vector<std::string> paths;
+    for (std::size_t m = 0; m < w.num_mounts; ++m) {
+        std::string mount_id = "mnt" + std::to_string(m);
+        for (std::size_t j = 0; j < w.mount_fan_out; ++j) {
+            st.mount(mount_id, tom_name((m + j) % w.num_toms), node_name(m % w.fan_out), /*priority*/j);
         }
+        collect_paths(mount_id, w.depth - 1, w, paths);
+    }
+    return paths;
+}
 
-        // Fill the read threads
-        for (std::size_t i = 0; i < read_threads; ++i) {
-            thread_pool.emplace_back([num_operations, &st, &mount_path, &start_allowed] {
-                while (start_allowed.load(std::memory_order_acquire) == false) {
-                    // Spin until the start is allowed
-                }
+double percentile( const std::vector<std::uint64_t>& sorted, double fraction ) {
+    std::size_t index = std::min(std::size_t(fraction * double(sorted.size())), sorted.size() - 1);
+    return double(sorted[index]) / 1000.0;
+}
 
-                for (std::size_t i = 0; i < num_operations; ++i) {
-                    volatile auto values = st.value(mount_path + '/' + std::to_string(i));
-                    suppress_unused(values);
-                }
-            });
+void run_benchmark( const workload& w, bool verbose ) {
+    if (verbose) {
+        const char* distribution_names[] = { "uniform", "zipfian", "hot-set" };
+        std::cout << "Info:" << std::endl;
+        std::cout << "\tNumber of threads = " << w.num_threads << std::endl;
+        std::cout << "\tNumber of operations per thread = " << w.num_operations << std::endl;
+        std::cout << "\tToms = " << w.num_toms << ", depth = " << w.depth << ", fan-out = " << w.fan_out << std::endl;
+        std::cout << "\tMounts = " << w.num_mounts << ", toms per mount = " << w.mount_fan_out << std::endl;
+        std::cout << "\tNodes with lifetime = " << w.lifetime_percentage << "%" << std::endl;
+        std::cout << "\tKey distribution = " << distribution_names[std::size_t(w.distribution)] << std::endl;
+        std::cout << "\tOperations =";
+        for (std::size_t op = 0; op < operation_count; ++op) {
+            std::cout << " " << operation_names[op] << " " << w.percentages[op] << "%";
         }
+        std::cout << std::endl;
+    }
 
-        // Fill the write threads
-        for (std::size_t i = 0; i < write_threads; ++i) {
-            thread_pool.emplace_back([num_operations, &st, &mount_path, &start_allowed] {
-                while (start_allowed.load(std::memory_order_acquire) == false) {
-                    // Spin until the start is allowed
-                }
+    create_toms(w);
 
-                for (std::size_t i = 0; i < num_operations; ++i) {
-                    volatile auto count = st.set_value(mount_path + '/' + std::to_string(i), std::pair{Key(42), Mapped(4242)});
-                    suppress_unused(count);
-                }
-            });
+    std::vector<std::array<std::vector<std::uint64_t>, operation_count>> latencies(w.num_threads);
+    // Keeps the results of the operations observable
+    std::atomic<std::uint64_t> checksum{0};
+    double elapsed = 0;
+    {
+        storage_type st;
+        std::vector<std::string> paths = mount_toms(st, w);
+        std::shuffle(paths.begin(), paths.end(), std::mt19937_64(7));
+        key_generator generator(w, paths.size());
+
+        if (w.reaper_period_ms != 0) {
+            st.start_reaper(std::chrono::milliseconds(w.reaper_period_ms));
         }
 
-        // Fill the insert threads
-        for (std::size_t i = 0; i < insert_threads; ++i) {
-            thread_pool.emplace_back([num_operations, &st, &mount_path, &start_allowed] {
-                while (start_allowed.load(std::memory_order_acquire) == false) {
+        std::vector<std::thread> thread_pool;
+        std::atomic<bool> start_allowed{false};
+
+        for (std::size_t t = 0; t < w.num_threads; ++t) {
+            thread_pool.emplace_back([&, t] {
+                std::mt19937_64 random(t + 1);
+                auto& thread_latencies = latencies[t];
+                for (auto& l : thread_latencies) {
+                    l.reserve(w.num_operations);
+                }
+                // Nodes inserted by the thread, removed in the order of the insertion
+                std::deque<std::string> inserted;
+                std::size_t inserted_count = 0;
+                std::string scratch_mount = "scratch" + std::to_string(t);
+                bool scratch_mounted = false;
+                std::uint64_t sum = 0;
+
+                while (!start_allowed.load(std::memory_order_acquire)) {
                     // Spin until the start is allowed
                 }
 
-                for (std::size_t i = 0; i < num_operations; ++i) {
-                    st.insert(mount_path + "/" + std::to_string(i), std::pair{Key(33), Mapped(3333)});
+                for (std::size_t i = 0; i < w.num_operations; ++i) {
+                    std::size_t percent = random() % 100;
+                    std::size_t op = 0;
+                    for (std::size_t bound = w.percentages[0]; percent >= bound; bound += w.percentages[++op]) {}
+
+                    const std::string& path = paths[generator(random)];
+                    auto start = std::chrono::steady_clock::now();
+                    switch (operation(op)) {
+                    case operation::read:
+                        sum += st.value(path).size();
+                        break;
+                    case operation::write:
+                        sum += st.set_mapped(path, mapped_type(i));
+                        break;
+                    case operation::insert: {
+                        std::string new_path = path + "/t" + std::to_string(t) + "_" + std::to_string(inserted_count++);
+                        bool success = random() % 100 < w.lifetime_percentage
+                                       ? st.insert(new_path, {key_type(i), mapped_type(i)}, std::chrono::seconds(w.lifetime_seconds))
+                                       : st.insert(new_path, {key_type(i), mapped_type(i)});
+                        if (success) {
+                            inserted.push_back(std::move(new_path));
+                        }
+                        break;
+                    }
+                    case operation::remove:
+                        if (!inserted.empty()) {
+                            sum += st.remove(inserted.front());
+                            inserted.pop_front();
+                        }
+                        break;
+                    default:
+                        // The scratch mount point of the thread is mounted and unmounted in turn
+                        if (scratch_mounted) {
+                            st.unmount(scratch_mount);
+                        } else {
+                            st.mount(scratch_mount, tom_name(random() % w.num_toms), node_name(random() % w.fan_out), random() % w.mount_fan_out);
+                        }
+                        scratch_mounted = !scratch_mounted;
+                        break;
+                    }
+                    auto finish = std::chrono::steady_clock::now();
+                    thread_latencies[op].push_back(std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(finish - start).count()));
                 }
+                checksum += sum;
             });
         }
 
+        auto start_timepoint = std::chrono::steady_clock::now();
         start_allowed.store(true, std::memory_order_release);
-
         for (auto& thr : thread_pool) {
             thr.join();
         }
+        auto finish_timepoint = std::chrono::steady_clock::now();
+        elapsed = std::chrono::duration_cast<std::chrono::duration<double>>(finish_timepoint - start_timepoint).count();
+        st.stop_reaper();
+    }
 
-        tomkv::remove_tom(tom_name);
-    }; // End of the benchmark body
+    for (std::size_t t = 0; t < w.num_toms; ++t) {
+        tomkv::remove_tom(tom_name(t));
+    }
 
-    utils::make_performance_measurements(benchmark_body);
+    std::size_t total_operations = w.num_threads * w.num_operations;
+    std::cout << "Elapsed time: " << elapsed << std::endl;
+    std::cout << "Throughput (operations per second): " << std::fixed << std::setprecision(0) << double(total_operations) / elapsed << std::endl;
+    std::cout << "Latency (microseconds):" << std::endl;
+    std::cout << std::setprecision(2);
+    for (std::size_t op = 0; op < operation_count; ++op) {
+        std::vector<std::uint64_t> merged;
+        for (auto& thread_latencies : latencies) {
+            merged.insert(merged.end(), thread_latencies[op].begin(), thread_latencies[op].end());
+        }
+        if (merged.empty()) {
+            continue;
+        }
+        std::sort(merged.begin(), merged.end());
+        std::cout << "\t" << std::setw(6) << operation_names[op] << ": count = " << merged.size()
+                  << ", p50 = " << percentile(merged, 0.5)
+                  << ", p90 = " << percentile(merged, 0.9)
+                  << ", p99 = " << percentile(merged, 0.99)
+                  << ", p99.9 = " << percentile(merged, 0.999)
+                  << ", max = " << double(merged.back()) / 1000.0 << std::endl;
+    }
 }
 
 int main( int argc, char* argv[] ) {
-    std::size_t error_percentage = 101;
-    std::size_t mount_percentage = error_percentage;
-    std::size_t read_percentage = error_percentage;
-    std::size_t write_percentage = error_percentage;
-    std::size_t insert_percentage = error_percentage;
-    std::size_t num_threads = 0;
-    std::size_t num_operations = 0;
+    workload w{};
+    std::string distribution;
 
     po::options_description desc("Allowed options");
     desc.add_options()
         ("help", "Print help message")
-        ("mount", po::value<std::size_t>(&mount_percentage), "Percentage of threads that mounts new paths")
-        ("read", po::value<std::size_t>(&read_percentage), "Percentage of threads that reads elements")
-        ("write", po::value<std::size_t>(&write_percentage), "Percentage of threads that modifyes elements")
-        ("insert", po::value<std::size_t>(&insert_percentage), "Percentage of threads that inserts new nodes")
+        ("read", po::value<std::size_t>(&w.percentages[std::size_t(operation::read)])->default_value(80), "Percentage of operations that read the nodes")
+        ("write", po::value<std::size_t>(&w.percentages[std::size_t(operation::write)])->default_value(10), "Percentage of operations that modify the nodes")
+        ("insert", po::value<std::size_t>(&w.percentages[std::size_t(operation::insert)])->default_value(4), "Percentage of operations that insert new nodes")
+        ("remove", po::value<std::size_t>(&w.percentages[std::size_t(operation::remove)])->default_value(4), "Percentage of operations that remove the inserted nodes")
+        ("mount", po::value<std::size_t>(&w.percentages[std::size_t(operation::mount)])->default_value(2), "Percentage of operations that mount or unmount paths")
+        ("num-toms", po::value<std::size_t>(&w.num_toms)->default_value(4), "Number of toms")
+        ("depth", po::value<std::size_t>(&w.depth)->default_value(3), "Number of levels of nodes in each tom")
+        ("fan-out", po::value<std::size_t>(&w.fan_out)->default_value(4), "Number of children of each node")
+        ("num-mounts", po::value<std::size_t>(&w.num_mounts)->default_value(16), "Number of mount points")
+        ("mount-fan-out", po::value<std::size_t>(&w.mount_fan_out)->default_value(2), "Number of toms mounted to each mount point with different priorities")
+        ("lifetime", po::value<std::size_t>(&w.lifetime_percentage)->default_value(10), "Percentage of nodes created and inserted with the lifetime")
+        ("lifetime-seconds", po::value<std::size_t>(&w.lifetime_seconds)->default_value(3600), "Lifetime of the nodes in seconds")
+        ("reaper-period", po::value<std::size_t>(&w.reaper_period_ms)->default_value(0), "Period of the background reaper in milliseconds, 0 disables the reaper")
+        ("distribution", po::value<std::string>(&distribution)->default_value("zipfian"), "Distribution of the accessed paths: uniform, zipfian or hot-set")
+        ("zipf-theta", po::value<double>(&w.zipf_theta)->default_value(0.99), "Skew of the zipfian distribution, in (0, 1)")
+        ("hot-set-fraction", po::value<double>(&w.hot_set_fraction)->default_value(0.2), "Fraction of the paths in the hot set")
+        ("hot-set-access", po::value<std::size_t>(&w.hot_set_percentage)->default_value(80), "Percentage of operations that access the hot set")
+        ("num-threads", po::value<std::size_t>(&w.num_threads)->default_value(std::thread::hardware_concurrency()), "Number of threads")
+        ("num-operations", po::value<std::size_t>(&w.num_operations)->default_value(1000), "Number of operations per thread")
         ("verbose", "Verbose mode")
-        ("num-threads", po::value<std::size_t>(&num_threads)->default_value(std::thread::hardware_concurrency()), "Number of threads")
-        ("num-operations", po::value<std::size_t>(&num_operations)->default_value(10), "Number of mount/read/write/insert operations per thread")
     ;
 
     po::variables_map vm;
@@ -189,37 +384,42 @@ int main( int argc, char* argv[] ) {
         return 0;
     }
 
-    if (vm.count("verbose")) {
-        verbose = true;
+    std::size_t percentage_sum = 0;
+    for (std::size_t p : w.percentages) {
+        percentage_sum += p;
     }
-
-    if (!vm.count("mount")) {
-        std::cout << "Error: percentage of mounts is not set" << std::endl;
+    if (percentage_sum != 100) {
+        std::cout << "Error: incorrect variables for operations percentage" << std::endl;
+        std::cout << "\tread + write + insert + remove + mount = " << percentage_sum << " != 100" << std::endl;
         return 1;
     }
 
-    if (!vm.count("read")) {
-        std::cout << "Error: percentage of reads is not set" << std::endl;
+    if (distribution == "uniform") {
+        w.distribution = key_distribution::uniform;
+    } else if (distribution == "zipfian") {
+        w.distribution = key_distribution::zipfian;
+    } else if (distribution == "hot-set") {
+        w.distribution = key_distribution::hot_set;
+    } else {
+        std::cout << "Error: unknown distribution " << distribution << std::endl;
         return 1;
     }
 
-    if (!vm.count("write")) {
-        std::cout << "Error: percentage of writes is not set" << std::endl;
+    if (w.distribution == key_distribution::zipfian && !(w.zipf_theta > 0 && w.zipf_theta < 1)) {
+        std::cout << "Error: zipf-theta should be in (0, 1)" << std::endl;
         return 1;
     }
 
-    if (!vm.count("insert")) {
-        std::cout << "Error: percentage of inserts is not set" << std::endl;
+    if (w.distribution == key_distribution::hot_set &&
+        (!(w.hot_set_fraction > 0 && w.hot_set_fraction <= 1) || w.hot_set_percentage > 100)) {
+        std::cout << "Error: incorrect hot set parameters" << std::endl;
         return 1;
     }
 
-    if (mount_percentage + read_percentage + write_percentage + insert_percentage != 100) {
-        std::cout << "Error: incorrect variables for operations percentage" << std::endl;
-        std::cout << "\t" << mount_percentage << " + " << read_percentage << " + " << write_percentage << " + " << insert_percentage << " != 100" << std::endl;
+    if (w.num_toms == 0 || w.depth == 0 || w.fan_out == 0 || w.num_mounts == 0 || w.mount_fan_out == 0 || w.num_threads == 0) {
+        std::cout << "Error: toms, depth, fan-out, mounts and threads should not be 0" << std::endl;
         return 1;
     }
 
-    run_benchmark<int, int>(mount_percentage, read_percentage,
-                            write_percentage, insert_percentage,
-                            num_threads, num_operations);
-}
\ No newline at end of file
+    run_benchmark(w, vm.count("verbose") != 0);
+}
@@ -23,6 +23,7 @@
  */
 
 #include "common/unordered_map_benchmark.hpp"
+#include "tomkv/node_pool_allocator.hpp"
 #include "boost/program_options/options_description.hpp"
 #include "boost/program_options/variables_map.hpp"
 #include "boost/program_options/parsers.hpp"
@@ -31,6 +32,22 @@
 
 namespace po = boost::program_options;
 
+template <typename Allocator>
+void run_umap_benchmark( bool striped, std::size_t insert_percentage, std::size_t find_percentage,
+                         std::size_t erase_percentage, std::size_t num_threads, std::size_t num_elements,
+                         bool use_find_copy )
+{
+    if (striped) {
+        basic_umap_benchmark<int, int, std::hash<int>, std::equal_to<int>, Allocator, tomkv::striped_locking<>>(
+            insert_percentage, find_percentage, erase_percentage,
+            num_threads, num_elements, use_find_copy);
+    } else {
+        basic_umap_benchmark<int, int, std::hash<int>, std::equal_to<int>, Allocator>(
+            insert_percentage, find_percentage, erase_percentage,
+            num_threads, num_elements, use_find_copy);
+    }
+}
+
 int main( int argc, char* argv[] ) {
     std::size_t error_percentage = 101;
     std::size_t insert_percentage = error_percentage;
@@ -48,7 +65,11 @@ int main( int argc, char* argv[] ) {
         ("verbose", "Verbose mode")
         ("num-threads", po::value<std::size_t>(&num_threads)->default_value(std::thread::hardware_concurrency()), "Number of threads")
         ("num-elements", po::value<std::size_t>(&num_elements)->default_value(1000), "Number of elements for insert/lookup/erase")
-        ("use-stl", "Use std::unordered_map with std::mutex");
+        ("use-stl", "Use std::unordered_map with std::mutex")
+        ("find-copy", "Use lock-free find_copy for lookups in tomkv::unordered_map")
+        ("striped", "Use lock striping in tomkv::unordered_map")
+        ("use-pool", "Use tomkv::node_pool_allocator in tomkv::unordered_map")
+        ("flat", "Use tomkv::flat_unordered_map");
     ;
 
     po::variables_map vm;
@@ -89,11 +110,26 @@ int main( int argc, char* argv[] ) {
         }
         basic_stl_umap_benchmark<int, int>(insert_percentage, find_percentage, erase_percentage,
                                            num_threads, num_elements);
+    } else if (vm.count("flat")) {
+        if (verbose) {
+            std::cout << "Testing tomkv::flat_unordered_map" << std::endl;
+        }
+        basic_flat_umap_benchmark<int, int>(insert_percentage, find_percentage, erase_percentage,
+                                            num_threads, num_elements, vm.count("find-copy") != 0);
     } else {
         if (verbose) {
             std::cout << "Testing tomkv::unordered_map" << std::endl;
         }
-        basic_umap_benchmark<int, int>(insert_percentage, find_percentage, erase_percentage,
-                                       num_threads, num_elements);
+        bool striped = vm.count("striped") != 0;
+        bool use_find_copy = vm.count("find-copy") != 0;
+        if (vm.count("use-pool")) {
+            run_umap_benchmark<tomkv::node_pool_allocator<std::pair<const int, int>>>(
+                striped, insert_percentage, find_percentage, erase_percentage,
+                num_threads, num_elements, use_find_copy);
+        } else {
+            run_umap_benchmark<std::allocator<std::pair<const int, int>>>(
+                striped, insert_percentage, find_percentage, erase_percentage,
+                num_threads, num_elements, use_find_copy);
+        }
     }
 }
\ No newline at end of file
@@ -27,6 +27,7 @@
 
 #include "utils.hpp"
 #include <tomkv/unordered_map.hpp>
+#include <tomkv/flat_unordered_map.hpp>
 #include <thread>
 #include <cassert>
 #include <iostream>
@@ -39,6 +40,25 @@
 
 static bool verbose = false;
 
+namespace tomkv {
+namespace internal {
+
+// Provides access to the internals of the hash table for memory measurements
+struct hash_table_auxiliary_accessor {
+    template <typename HashTable>
+    static std::size_t bucket_size( const HashTable& ) {
+        return sizeof(typename HashTable::bucket);
+    }
+
+    template <typename HashTable>
+    static std::size_t bucket_count( const HashTable& ht ) {
+        return ht.bucket_count();
+    }
+}; // struct hash_table_auxiliary_accessor
+
+} // namespace internal
+} // namespace tomkv
+
 template <typename T>
 void suppress_unused( T&& ) {}
 
@@ -132,16 +152,31 @@ void basic_stl_umap_benchmark( std::size_t insert_percentage,
     utils::make_performance_measurements(benchmark_body);
 }
 
-template <typename Key, typename Mapped,
-          typename Hasher = std::hash<Key>,
-          typename KeyEqual = std::equal_to<Key>,
-          typename Allocator = std::allocator<std::pair<const Key, Mapped>>>
-void basic_umap_benchmark( std::size_t insert_percentage,
-                           std::size_t find_percentage,
-                           std::size_t erase_percentage,
-                           std::size_t num_threads = std::thread::hardware_concurrency(),
-                           std::size_t number_of_elements_per_thread = 1000 )
+template <typename... Args>
+void report_memory( const tomkv::unordered_map<Args...>& umap ) {
+    using aux = tomkv::internal::hash_table_auxiliary_accessor;
+    std::size_t bucket_size = aux::bucket_size(umap);
+    std::size_t bucket_count = aux::bucket_count(umap);
+
+    std::cout << "\tMemory per bucket = " << bucket_size << " bytes" << std::endl;
+    std::cout << "\tNumber of buckets = " << bucket_count << std::endl;
+    std::cout << "\tMemory for buckets = " << bucket_size * bucket_count << " bytes" << std::endl;
+}
+
+// The flat map has no buckets
+template <typename... Args>
+void report_memory( const tomkv::flat_unordered_map<Args...>& ) {}
+
+template <typename UnorderedMap>
+void concurrent_umap_benchmark( std::size_t insert_percentage,
+                                std::size_t find_percentage,
+                                std::size_t erase_percentage,
+                                std::size_t num_threads,
+                                std::size_t number_of_elements_per_thread,
+                                bool use_find_copy )
 {
+    using key_type = typename UnorderedMap::key_type;
+
     assert(insert_percentage + find_percentage + erase_percentage == 100);
     std::size_t insert_threads = std::size_t(num_threads / 100. * insert_percentage);
     std::size_t find_threads = std::size_t(num_threads / 100. * find_percentage);
@@ -156,10 +191,10 @@ void basic_umap_benchmark( std::size_t insert_percentage,
         std::cout << "\tNumber of elements = " << number_of_elements_per_thread << std::endl;
     }
 
-    auto benchmark_body = [&] {
-        using umap_type = tomkv::unordered_map<Key, Mapped, Hasher, KeyEqual, Allocator>;
+    bool memory_reported = false;
 
-        umap_type umap;
+    auto benchmark_body = [&] {
+        UnorderedMap umap;
 
         std::atomic<bool> start_allowed = false;
 
@@ -183,14 +218,19 @@ void basic_umap_benchmark( std::size_t insert_percentage,
 
         // Fill the lookup threads
         for (std::size_t i = 0; i < find_threads; ++i) {
-            thread_pool.emplace_back([number_of_elements_per_thread, &umap, &start_allowed] {
+            thread_pool.emplace_back([number_of_elements_per_thread, use_find_copy, &umap, &start_allowed] {
                 while (start_allowed.load(std::memory_order_acquire) == false) {
                     // Spin until the start is allowed
                 }
 
                 for (std::size_t i = 0; i < number_of_elements_per_thread; ++i) {
-                    typename decltype(umap)::read_accessor racc;
-                    umap.find(racc, Key(i));
+                    if (use_find_copy) {
+                        volatile bool found = umap.find_copy(key_type(i)).has_value();
+                        suppress_unused(found);
+                    } else {
+                        typename decltype(umap)::read_accessor racc;
+                        umap.find(racc, key_type(i));
+                    }
                 }
             });
         }
@@ -202,7 +242,7 @@ void basic_umap_benchmark( std::size_t insert_percentage,
                 }
 
                 for (std::size_t i = 0; i < number_of_elements_per_thread; ++i) {
-                    umap.erase(Key(i));
+                    umap.erase(key_type(i));
                 }
             });
         }
@@ -212,9 +252,47 @@ void basic_umap_benchmark( std::size_t insert_percentage,
         for (auto& thr : thread_pool) {
             thr.join();
         }
+
+        if (verbose && !memory_reported) {
+            report_memory(umap);
+            memory_reported = true;
+        }
     }; // End of the benchmark body
 
     utils::make_performance_measurements(benchmark_body);
 }
 
+template <typename Key, typename Mapped,
+          typename Hasher = std::hash<Key>,
+          typename KeyEqual = std::equal_to<Key>,
+          typename Allocator = std::allocator<std::pair<const Key, Mapped>>,
+          typename LockingPolicy = tomkv::per_bucket_locking>
+void basic_umap_benchmark( std::size_t insert_percentage,
+                           std::size_t find_percentage,
+                           std::size_t erase_percentage,
+                           std::size_t num_threads = std::thread::hardware_concurrency(),
+                           std::size_t number_of_elements_per_thread = 1000,
+                           bool use_find_copy = false )
+{
+    using umap_type = tomkv::unordered_map<Key, Mapped, Hasher, KeyEqual, Allocator, LockingPolicy>;
+    concurrent_umap_benchmark<umap_type>(insert_percentage, find_percentage, erase_percentage,
+                                         num_threads, number_of_elements_per_thread, use_find_copy);
+}
+
+template <typename Key, typename Mapped,
+          typename Hasher = std::hash<Key>,
+          typename KeyEqual = std::equal_to<Key>,
+          typename Allocator = std::allocator<std::pair<const Key, Mapped>>>
+void basic_flat_umap_benchmark( std::size_t insert_percentage,
+                                std::size_t find_percentage,
+                                std::size_t erase_percentage,
+                                std::size_t num_threads = std::thread::hardware_concurrency(),
+                                std::size_t number_of_elements_per_thread = 1000,
+                                bool use_find_copy = false )
+{
+    using umap_type = tomkv::flat_unordered_map<Key, Mapped, Hasher, KeyEqual, Allocator>;
+    concurrent_umap_benchmark<umap_type>(insert_percentage, find_percentage, erase_percentage,
+                                         num_threads, number_of_elements_per_thread, use_find_copy);
+}
+
 #endif // __TOMKV_BENCH_UNORDERED_MAP_BENCHMARK_HPP
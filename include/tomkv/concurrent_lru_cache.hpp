@@ -0,0 +1,343 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Konstantin Boyarinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __TOMKV_INCLUDE_CONCURRENT_LRU_CACHE_HPP
+#define __TOMKV_INCLUDE_CONCURRENT_LRU_CACHE_HPP
+
+#include "unordered_map.hpp"
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace tomkv {
+namespace internal {
+
+// Mapped object of the underlying unordered_map with the state of the CLOCK eviction
+template <typename Mapped>
+struct lru_cache_entry {
+    template <typename... Args>
+    lru_cache_entry( Args&&... args ) : my_value(std::forward<Args>(args)...), my_referenced(false), my_slot(0) {}
+
+    Mapped my_value;
+    // Set by the lookups, cleared by the clock hand
+    mutable std::atomic<bool> my_referenced;
+    // Index of the element in the clock of its shard, modified under the lock of the shard
+    std::size_t my_slot;
+}; // struct lru_cache_entry
+
+// Bounded cache on top of unordered_map with the approximate LRU eviction
+// The elements are split into the shards by the hash code, each shard has its own CLOCK and the lock
+// Lookups do not take the locks of the shards, they only set the referenced bit of the element
+// Insertions and erasures are serialized within the shard
+template <typename Key, typename Mapped,
+          typename Hash = std::hash<Key>,
+          typename KeyEqual = std::equal_to<Key>,
+          typename Allocator = std::allocator<std::pair<const Key, Mapped>>>
+class concurrent_lru_cache {
+    using entry_type = lru_cache_entry<Mapped>;
+    using map_allocator_type = typename std::allocator_traits<Allocator>::template rebind_alloc<std::pair<const Key, entry_type>>;
+    using map_type = unordered_map<Key, entry_type, Hash, KeyEqual, map_allocator_type>;
+    using map_value_type = typename map_type::value_type;
+public:
+    using key_type = Key;
+    using mapped_type = Mapped;
+    using value_type = std::pair<const key_type, mapped_type>;
+    using allocator_type = Allocator;
+    using hasher = Hash;
+    using key_equal = KeyEqual;
+    using size_type = std::size_t;
+    // Receives the evicted element, called without any locks held
+    using eviction_callback = std::function<void( const key_type&, mapped_type&& )>;
+
+    concurrent_lru_cache( size_type capacity, eviction_callback on_eviction = eviction_callback(),
+                          const Hash& hash = Hash(), const KeyEqual& equal = KeyEqual(), const Allocator& alloc = Allocator() )
+        : my_allocator(alloc),
+          my_hasher(hash),
+          // Buckets for all of the elements are allocated at once, so the cache never grows
+          my_map(checked_capacity(capacity), hash, equal, map_allocator_type(alloc)),
+          my_on_eviction(std::move(on_eviction)),
+          my_shard_count(default_number_of_shards(capacity)),
+          my_shards(new shard[my_shard_count]),
+          my_capacity(capacity),
+          my_hits(my_allocator),
+          my_misses(my_allocator),
+          my_evictions(my_allocator)
+    {
+        // The capacity is split between the shards, so the total number of elements never exceeds it
+        for (size_type i = 0; i < my_shard_count; ++i) {
+            size_type shard_capacity = capacity / my_shard_count + (i < capacity % my_shard_count ? 1 : 0);
+            my_shards[i].my_slots.assign(shard_capacity, nullptr);
+        }
+    }
+
+    concurrent_lru_cache( const concurrent_lru_cache& ) = delete;
+    concurrent_lru_cache& operator=( const concurrent_lru_cache& ) = delete;
+
+    // Returns a copy of the mapped object and marks the element as recently used
+    std::optional<mapped_type> find( const key_type& key ) {
+        typename map_type::read_accessor racc;
+        if (!my_map.find(racc, key)) {
+            my_misses.add(1);
+            return std::nullopt;
+        }
+        mark_referenced(racc.mapped());
+        my_hits.add(1);
+        return racc.mapped().my_value;
+    }
+
+    // Returns true if the element is in the cache, does not mark it and does not change the counters
+    bool contains( const key_type& key ) {
+        typename map_type::read_accessor racc;
+        return my_map.find(racc, key);
+    }
+
+    // The element is inserted only if there is no element with equal key, the mapped object is constructed from args
+    // The element chosen by the clock is evicted if the shard is full
+    // Returns true if the element was inserted
+    template <typename... Args>
+    bool try_emplace( const key_type& key, Args&&... args ) {
+        return internal_insert(key, [] ( mapped_type& ) {}, std::forward<Args>(args)...);
+    }
+
+    // Inserts the element or assigns obj to the mapped object of the existing element
+    // Returns true if the element was inserted
+    template <typename M>
+    bool insert_or_assign( const key_type& key, M&& obj ) {
+        return internal_insert(key, [&obj] ( mapped_type& mapped ) { mapped = std::forward<M>(obj); },
+                               std::forward<M>(obj));
+    }
+
+    // Removes the element without calling the eviction callback
+    bool erase( const key_type& key ) {
+        shard& s = get_shard(key);
+        std::lock_guard<std::mutex> lock(s.my_mutex);
+
+        typename map_type::write_accessor wacc;
+        if (!my_map.find(wacc, key)) {
+            return false;
+        }
+        s.release_slot(wacc.mapped().my_slot);
+        my_map.erase(wacc);
+        return true;
+    }
+
+    size_type size() const { return my_map.size(); }
+
+    bool empty() const { return size() == 0; }
+
+    size_type capacity() const { return my_capacity; }
+
+    size_type shard_count() const { return my_shard_count; }
+
+    // Counters are summed up from the per-thread slots
+    size_type hit_count() const { return my_hits.load(); }
+    size_type miss_count() const { return my_misses.load(); }
+    size_type eviction_count() const { return my_evictions.load(); }
+
+    // Removes all of the elements without calling the eviction callback, the counters are not reset
+    // Not thread-safe
+    void clear() {
+        my_map.clear();
+        for (size_type i = 0; i < my_shard_count; ++i) {
+            my_shards[i].reset();
+        }
+    }
+
+    allocator_type get_allocator() const { return my_allocator; }
+
+private:
+    static constexpr size_type cache_line_size = 64;
+    // The shard should be large enough for the clock to approximate LRU
+    static constexpr size_type min_shard_capacity = 64;
+
+    struct alignas(cache_line_size) shard {
+        // Returns the free slot or max_size() if the shard is full
+        size_type acquire_slot() {
+            if (my_filled < my_slots.size()) {
+                return my_filled++;
+            }
+            if (!my_free_slots.empty()) {
+                size_type slot = my_free_slots.back();
+                my_free_slots.pop_back();
+                return slot;
+            }
+            return no_slot();
+        }
+
+        void release_slot( size_type slot ) {
+            my_slots[slot] = nullptr;
+            my_free_slots.push_back(slot);
+        }
+
+        // Advances the hand until the element which was not referenced since the previous pass
+        // The shard is full, so there are no free slots. Terminates within two passes
+        size_type select_victim() {
+            while (true) {
+                size_type slot = my_hand;
+                my_hand = my_hand + 1 == my_slots.size() ? 0 : my_hand + 1;
+
+                const entry_type& e = my_slots[slot]->second;
+                if (!e.my_referenced.load(std::memory_order_relaxed)) {
+                    return slot;
+                }
+                e.my_referenced.store(false, std::memory_order_relaxed);
+            }
+        }
+
+        void reset() {
+            std::fill(my_slots.begin(), my_slots.end(), nullptr);
+            my_free_slots.clear();
+            my_filled = 0;
+            my_hand = 0;
+        }
+
+        static constexpr size_type no_slot() { return size_type(-1); }
+
+        std::mutex my_mutex;
+        // Elements in the clock, the nodes of the map are stable until they are erased under the lock of the shard
+        std::vector<map_value_type*> my_slots;
+        std::vector<size_type> my_free_slots;
+        // Slots after my_filled were never used
+        size_type my_filled = 0;
+        size_type my_hand = 0;
+    }; // struct shard
+
+    // Writing the shared cache line only if the bit is not set keeps the lookups of the hot elements from contending
+    static void mark_referenced( const entry_type& e ) {
+        if (!e.my_referenced.load(std::memory_order_relaxed)) {
+            e.my_referenced.store(true, std::memory_order_relaxed);
+        }
+    }
+
+    // The table uses the low bits of the hash code, so the shard is selected by the high bits of the mixed hash code
+    shard& get_shard( const key_type& key ) {
+        if (my_shard_count == 1) {
+            return my_shards[0];
+        }
+        std::uint64_t h = std::uint64_t(my_hasher(key)) * 0x9E3779B97F4A7C15ull;
+        return my_shards[size_type(h >> (64 - utils::log2(my_shard_count)))];
+    }
+
+    // Assigner is applied to the mapped object of the existing element
+    template <typename Assigner, typename... Args>
+    bool internal_insert( const key_type& key, const Assigner& assign, Args&&... args ) {
+        shard& s = get_shard(key);
+        std::optional<value_type> evicted;
+        bool is_evicted = false;
+        bool inserted = false;
+        {
+            std::lock_guard<std::mutex> lock(s.my_mutex);
+
+            // Elements of the shard are inserted and erased only under its lock, so the element
+            // cannot appear between this lookup and the insertion below
+            typename map_type::write_accessor wacc;
+            if (my_map.find(wacc, key)) {
+                assign(wacc.mapped().my_value);
+                mark_referenced(wacc.mapped());
+                return false;
+            }
+            // The victim may be in the same bucket, so the lock of the bucket is not held during the eviction
+            wacc.release();
+
+            size_type slot = s.acquire_slot();
+            if (slot == shard::no_slot()) {
+                slot = s.select_victim();
+                evict(s.my_slots[slot]->first, evicted);
+                is_evicted = true;
+            }
+
+            // The slot is returned if the construction throws
+            utils::raii_guard slot_guard([&] { s.release_slot(slot); });
+            inserted = my_map.try_emplace(wacc, key, std::forward<Args>(args)...);
+            __TOMKV_ASSERT(inserted);
+            wacc.mapped().my_slot = slot;
+            s.my_slots[slot] = &wacc.value();
+            slot_guard.release();
+        }
+
+        if (is_evicted) {
+            my_evictions.add(1);
+            if (evicted) {
+                my_on_eviction(evicted->first, std::move(evicted->second));
+            }
+        }
+        return inserted;
+    }
+
+    // Erases the element under the lock of its shard, the element is moved to evicted only if there is a callback
+    void evict( const key_type& key, std::optional<value_type>& evicted ) {
+        typename map_type::write_accessor wacc;
+        bool found = my_map.find(wacc, key);
+        __TOMKV_ASSERT(found);
+        utils::suppress_unused(found);
+
+        if (my_on_eviction) {
+            evicted.emplace(wacc.value().first, std::move(wacc.mapped().my_value));
+        }
+        my_map.erase(wacc);
+    }
+
+    // Several shards per hardware thread to reduce the contention of the insertions
+    // The empty cache cannot evict anything to insert the element
+    static size_type checked_capacity( size_type capacity ) {
+        if (capacity == 0) {
+            throw std::invalid_argument("The capacity of concurrent_lru_cache should not be 0");
+        }
+        return capacity;
+    }
+
+    static size_type default_number_of_shards( size_type capacity ) {
+        size_type requested = std::min(size_type(4 * std::max(std::thread::hardware_concurrency(), 1u)),
+                                       std::max(capacity / min_shard_capacity, size_type(1)));
+        size_type result = 1;
+        while (result * 2 <= requested) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    allocator_type                   my_allocator;
+    hasher                           my_hasher;
+    map_type                         my_map;
+    eviction_callback                my_on_eviction;
+    size_type                        my_shard_count;
+    std::unique_ptr<shard[]>         my_shards;
+    size_type                        my_capacity;
+    // Each thread modifies its own counter, the counters are placed on the separate cache lines
+    sharded_counter<allocator_type>  my_hits;
+    sharded_counter<allocator_type>  my_misses;
+    sharded_counter<allocator_type>  my_evictions;
+}; // class concurrent_lru_cache
+
+} // namespace internal
+
+using internal::concurrent_lru_cache;
+
+} // namespace tomkv
+
+#endif // __TOMKV_INCLUDE_CONCURRENT_LRU_CACHE_HPP
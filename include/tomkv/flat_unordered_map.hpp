@@ -0,0 +1,104 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Konstantin Boyarinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __TOMKV_INCLUDE_FLAT_UNORDERED_MAP_HPP
+#define __TOMKV_INCLUDE_FLAT_UNORDERED_MAP_HPP
+
+#include "internal/flat_hash_table.hpp"
+
+namespace tomkv {
+namespace internal {
+
+template <typename Key, typename Mapped,
+          typename Hash = std::hash<Key>,
+          typename KeyEqual = std::equal_to<Key>,
+          typename Allocator = std::allocator<std::pair<const Key, Mapped>>>
+class flat_unordered_map : public flat_hash_table<Key, Mapped, Hash, KeyEqual, Allocator> {
+    using base_type = flat_hash_table<Key, Mapped, Hash, KeyEqual, Allocator>;
+public:
+    flat_unordered_map( const Hash& hash = Hash(), const KeyEqual& equal = KeyEqual(), const Allocator& alloc = Allocator() )
+        : base_type(hash, equal, alloc) {}
+
+    flat_unordered_map( const Hash& hash, const Allocator& alloc )
+        : flat_unordered_map(hash, KeyEqual(), alloc) {}
+
+    flat_unordered_map( const Allocator& alloc )
+        : flat_unordered_map(Hash(), alloc) {}
+
+    flat_unordered_map( const flat_unordered_map& other )
+        : flat_unordered_map(other, std::allocator_traits<Allocator>::select_on_container_copy_construction(other.my_allocator)) {}
+
+    flat_unordered_map( const flat_unordered_map& other, const Allocator& alloc )
+        : base_type(other.shard_count(), other.my_hasher, other.my_equality, alloc)
+    {
+        base_type::internal_copy(other);
+    }
+
+    flat_unordered_map( flat_unordered_map&& other )
+        : base_type(other.shard_count(), std::move(other.my_hasher), std::move(other.my_equality),
+                    std::move(other.my_allocator))
+    {
+        base_type::internal_move(std::move(other));
+    }
+
+    flat_unordered_map( flat_unordered_map&& other, const Allocator& alloc )
+        : base_type(other.shard_count(), std::move(other.my_hasher), std::move(other.my_equality), alloc)
+    {
+        base_type::internal_move_with_allocator(std::move(other), alloc);
+    }
+
+    flat_unordered_map& operator=( const flat_unordered_map& other ) {
+        if (this != &other) {
+            this->my_hasher = other.my_hasher;
+            this->my_equality = other.my_equality;
+
+            if constexpr (std::allocator_traits<Allocator>::propagate_on_container_copy_assignment::value) {
+                this->my_allocator = other.my_allocator;
+            }
+            base_type::internal_copy_assign(other);
+        }
+        return *this;
+    }
+
+    flat_unordered_map& operator=( flat_unordered_map&& other ) {
+        if (this != &other) {
+            this->my_hasher = std::move(other.my_hasher);
+            this->my_equality = std::move(other.my_equality);
+
+            if constexpr (std::allocator_traits<Allocator>::propagate_on_container_move_assignment::value) {
+                this->my_allocator = std::move(other.my_allocator);
+            }
+            base_type::internal_move_assign(std::move(other));
+        }
+        return *this;
+    }
+}; // class flat_unordered_map
+
+} // namespace internal
+
+using internal::flat_unordered_map;
+
+} // namespace tomkv
+
+#endif // __TOMKV_INCLUDE_FLAT_UNORDERED_MAP_HPP
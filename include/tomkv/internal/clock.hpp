@@ -0,0 +1,108 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Konstantin Boyarinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __TOMKV_INCLUDE_INTERNAL_CLOCK_HPP
+#define __TOMKV_INCLUDE_INTERNAL_CLOCK_HPP
+
+#include <chrono>
+#include <memory>
+#include <atomic>
+#include <ctime>
+
+namespace tomkv {
+namespace internal {
+
+// Clock sources for the lifetime evaluation
+// Each clock source provides the time_point type and now() function
+// time_point is always std::chrono::system_clock::time_point because <date_created> is stored
+// as the number of seconds since std::chrono::system_clock epoch
+
+// Reads std::chrono::system_clock on each call
+class precise_clock {
+public:
+    using time_point = std::chrono::system_clock::time_point;
+
+    time_point now() const { return std::chrono::system_clock::now(); }
+}; // class precise_clock
+
+// Reads the time cached by the kernel on each timer tick (CLOCK_REALTIME_COARSE)
+// It is much cheaper than std::chrono::system_clock but have the resolution of several milliseconds
+// Falls back to std::chrono::system_clock if the coarse clock is not supported
+class coarse_clock {
+public:
+    using time_point = std::chrono::system_clock::time_point;
+
+    time_point now() const {
+#if defined(CLOCK_REALTIME_COARSE)
+        static const std::chrono::nanoseconds tick = resolution();
+
+        timespec ts;
+        clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+
+        // Cached time lags behind the real time by at most one tick
+        // Adding the tick guarantees that the lifetime is never considered as not over after it is over
+        return time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                   std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec) + tick));
+#else
+        return std::chrono::system_clock::now();
+#endif
+    }
+
+private:
+#if defined(CLOCK_REALTIME_COARSE)
+    static std::chrono::nanoseconds resolution() {
+        timespec ts;
+        clock_getres(CLOCK_REALTIME_COARSE, &ts);
+        return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+    }
+#endif
+}; // class coarse_clock
+
+// Clock which is moved only manually
+// Copies of the manual_clock share the same time
+class manual_clock {
+public:
+    using time_point = std::chrono::system_clock::time_point;
+    using duration = time_point::duration;
+
+    manual_clock( time_point start = std::chrono::system_clock::now() )
+        : my_now(std::make_shared<std::atomic<typename duration::rep>>(start.time_since_epoch().count())) {}
+
+    time_point now() const { return time_point(duration(my_now->load(std::memory_order_acquire))); }
+
+    void set( time_point tp ) { my_now->store(tp.time_since_epoch().count(), std::memory_order_release); }
+
+    template <typename Rep, typename Period>
+    void advance( const std::chrono::duration<Rep, Period>& d ) {
+        my_now->fetch_add(std::chrono::duration_cast<duration>(d).count(), std::memory_order_acq_rel);
+    }
+
+private:
+    std::shared_ptr<std::atomic<typename duration::rep>> my_now;
+}; // class manual_clock
+
+} // namespace internal
+} // namespace tomkv
+
+#endif // __TOMKV_INCLUDE_INTERNAL_CLOCK_HPP
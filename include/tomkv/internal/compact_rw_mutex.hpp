@@ -0,0 +1,181 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Konstantin Boyarinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __TOMKV_INCLUDE_INTERNAL_COMPACT_RW_MUTEX_HPP
+#define __TOMKV_INCLUDE_INTERNAL_COMPACT_RW_MUTEX_HPP
+
+#include "utils.hpp"
+#include <atomic>
+#include <cstdint>
+
+namespace tomkv {
+namespace internal {
+
+// Reader-writer mutex which state fits into a single 32-bit word
+// Waiting threads spin for a while and then park on the futex, the spinning time adapts to the hold times
+// Meets the SharedMutex requirements
+class compact_rw_mutex {
+    using state_type = std::uint32_t;
+
+    static constexpr state_type writer = 1;
+    // Prevents the new readers from acquiring the mutex while a writer is waiting
+    static constexpr state_type writer_pending = 2;
+    // Some threads are parked and should be woken up on release
+    static constexpr state_type waiters = 4;
+    static constexpr state_type one_reader = 8;
+    static constexpr state_type readers_mask = ~(writer | writer_pending | waiters);
+public:
+    compact_rw_mutex() noexcept : my_state(0) {}
+
+    compact_rw_mutex( const compact_rw_mutex& ) = delete;
+    compact_rw_mutex& operator=( const compact_rw_mutex& ) = delete;
+
+    void lock() {
+        bool parked = false;
+        for (std::uint32_t spins = 0; ; ++spins) {
+            state_type state = my_state.load(std::memory_order_relaxed);
+            if ((state & (writer | readers_mask)) == 0) {
+                // Pending flag of the other writers is restored by them on the next attempt
+                if (my_state.compare_exchange_weak(state, (state & waiters) | writer,
+                                                   std::memory_order_acquire,
+                                                   std::memory_order_relaxed)) {
+                    adapt(spins, parked);
+                    return;
+                }
+                continue;
+            }
+
+            if ((state & writer_pending) == 0) {
+                my_state.fetch_or(writer_pending, std::memory_order_relaxed);
+                continue;
+            }
+            parked |= wait(state, spins);
+        }
+    }
+
+    bool try_lock() {
+        state_type state = my_state.load(std::memory_order_relaxed);
+        return (state & (writer | readers_mask)) == 0 &&
+               my_state.compare_exchange_strong(state, (state & waiters) | writer,
+                                                std::memory_order_acquire,
+                                                std::memory_order_relaxed);
+    }
+
+    void unlock() {
+        state_type state = my_state.fetch_and(~(writer | waiters), std::memory_order_release);
+        if (state & waiters) {
+            utils::futex_wake_all(my_state);
+        }
+    }
+
+    // Atomically converts the exclusive ownership into the shared one
+    // No writer can acquire the mutex in between
+    void unlock_and_lock_shared() {
+        state_type state = my_state.load(std::memory_order_relaxed);
+        while (!my_state.compare_exchange_weak(state, (state & ~(writer | waiters)) + one_reader,
+                                               std::memory_order_release,
+                                               std::memory_order_relaxed)) {}
+        if (state & waiters) {
+            // Parked readers may proceed, parked writers park again
+            utils::futex_wake_all(my_state);
+        }
+    }
+
+    void lock_shared() {
+        bool parked = false;
+        for (std::uint32_t spins = 0; ; ++spins) {
+            state_type state = my_state.load(std::memory_order_relaxed);
+            if ((state & (writer | writer_pending)) == 0) {
+                if (my_state.compare_exchange_weak(state, state + one_reader,
+                                                   std::memory_order_acquire,
+                                                   std::memory_order_relaxed)) {
+                    adapt(spins, parked);
+                    return;
+                }
+                continue;
+            }
+            parked |= wait(state, spins);
+        }
+    }
+
+    bool try_lock_shared() {
+        state_type state = my_state.load(std::memory_order_relaxed);
+        return (state & (writer | writer_pending)) == 0 &&
+               my_state.compare_exchange_strong(state, state + one_reader,
+                                                std::memory_order_acquire,
+                                                std::memory_order_relaxed);
+    }
+
+    void unlock_shared() {
+        state_type state = my_state.fetch_sub(one_reader, std::memory_order_release);
+        if ((state & readers_mask) == one_reader && (state & waiters)) {
+            // The last reader wakes up the parked writers
+            if (my_state.fetch_and(~waiters, std::memory_order_relaxed) & waiters) {
+                utils::futex_wake_all(my_state);
+            }
+        }
+    }
+
+private:
+    // The spinning time is learned by each thread from its waits for all of the mutexes
+    static utils::adaptive_spin& local_spin() {
+        static thread_local utils::adaptive_spin spin;
+        return spin;
+    }
+
+    // Uncontended acquisitions say nothing about the hold times
+    static void adapt( std::uint32_t spins, bool parked ) {
+        if (parked) {
+            local_spin().parked();
+        } else if (spins != 0) {
+            local_spin().spun(spins);
+        }
+    }
+
+    // Spins while the number of attempts is below the adaptive limit, parks the thread otherwise
+    // Returns true if the thread was parked
+    bool wait( state_type state, std::uint32_t spins ) {
+        if (spins < local_spin().limit()) {
+            utils::cpu_pause();
+            return false;
+        }
+
+        if ((state & waiters) == 0) {
+            if (!my_state.compare_exchange_weak(state, state | waiters, std::memory_order_relaxed)) {
+                // The state is changed - try to acquire once again
+                return false;
+            }
+            state |= waiters;
+        }
+        utils::futex_wait(my_state, state);
+        return true;
+    }
+
+    std::atomic<state_type> my_state;
+}; // class compact_rw_mutex
+
+} // namespace internal
+} // namespace tomkv
+
+#endif // __TOMKV_INCLUDE_INTERNAL_COMPACT_RW_MUTEX_HPP
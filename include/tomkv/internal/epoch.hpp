@@ -0,0 +1,337 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Konstantin Boyarinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __TOMKV_INCLUDE_INTERNAL_EPOCH_HPP
+#define __TOMKV_INCLUDE_INTERNAL_EPOCH_HPP
+
+#include "utils.hpp"
+#include <algorithm>
+#include <atomic>
+#include <vector>
+#include <thread>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace tomkv {
+namespace internal {
+
+// Epoch-based reclamation of the objects which can be accessed without locks
+// The object is retired after it is excluded from the shared data structure and
+// it is reclaimed when all of the threads which could observe it left the critical section
+class epoch_domain {
+public:
+    using epoch_type = std::uint64_t;
+    using deleter_type = void (*)( void* context, void* object );
+
+private:
+    static constexpr std::size_t reclamation_period = 64;
+    // The thread forgets the destroyed domains when the number of the known domains reaches the threshold
+    static constexpr std::size_t min_prune_threshold = 64;
+    static constexpr epoch_type quiescent_epoch = 0;
+
+    static constexpr epoch_type active_epoch( epoch_type epoch ) {
+        return (epoch << 1) | 1;
+    }
+
+    struct retired_object {
+        void* my_object;
+        deleter_type my_deleter;
+        void* my_context;
+        epoch_type my_epoch;
+    }; // struct retired_object
+
+    // The record is owned by a single thread at a time and only the owner modifies it
+    // The record is released when the thread exits and reused with its limbo list by the next registered thread
+    struct alignas(64) thread_record {
+        thread_record()
+            : my_announced_epoch(quiescent_epoch), my_in_use(true), my_nesting(0), my_reclaiming(false), my_next(nullptr) {}
+
+        std::atomic<epoch_type> my_announced_epoch;
+        std::atomic<bool> my_in_use;
+        // Number of the nested guards of the owner
+        std::size_t my_nesting;
+        // The deleters called by the reclamation do not start the nested reclamation
+        bool my_reclaiming;
+        thread_record* my_next;
+        std::vector<retired_object> my_limbo_list;
+    }; // struct thread_record
+
+    // Identifiers of the existing domains, the identifiers are never reused
+    struct domain_registry {
+        std::mutex my_mutex;
+        std::unordered_set<std::uint64_t> my_domains;
+        std::uint64_t my_last_id = 0;
+    }; // struct domain_registry
+
+    static domain_registry& registry() {
+        // Never destroyed, since the threads may exit after the destruction of the static objects
+        static domain_registry* instance = new domain_registry;
+        return *instance;
+    }
+
+    // Records of the current thread in the domains it accessed
+    // The records in the existing domains are released when the thread exits
+    class thread_registration {
+    public:
+        thread_registration() : my_prune_threshold(min_prune_threshold) {}
+
+        thread_registration( const thread_registration& ) = delete;
+        thread_registration& operator=( const thread_registration& ) = delete;
+
+        ~thread_registration() {
+            domain_registry& domains = registry();
+            std::lock_guard<std::mutex> lock(domains.my_mutex);
+            for (auto& [id, record] : my_records) {
+                // The domain cannot be destroyed while the registry is locked
+                if (domains.my_domains.count(id) != 0) {
+                    record->my_in_use.store(false, std::memory_order_release);
+                }
+            }
+        }
+
+        thread_record* find( std::uint64_t id ) const {
+            auto it = my_records.find(id);
+            return it == my_records.end() ? nullptr : it->second;
+        }
+
+        void add( std::uint64_t id, thread_record* record ) {
+            if (my_records.size() >= my_prune_threshold) {
+                prune();
+            }
+            my_records.emplace(id, record);
+        }
+
+    private:
+        // Forgets the destroyed domains
+        void prune() {
+            domain_registry& domains = registry();
+            std::lock_guard<std::mutex> lock(domains.my_mutex);
+            for (auto it = my_records.begin(); it != my_records.end();) {
+                if (domains.my_domains.count(it->first) == 0) {
+                    it = my_records.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            my_prune_threshold = std::max(min_prune_threshold, 2 * my_records.size());
+        }
+
+        std::size_t my_prune_threshold;
+        std::unordered_map<std::uint64_t, thread_record*> my_records;
+    }; // class thread_registration
+
+    static std::uint64_t register_domain() {
+        domain_registry& domains = registry();
+        std::lock_guard<std::mutex> lock(domains.my_mutex);
+        std::uint64_t id = ++domains.my_last_id;
+        domains.my_domains.insert(id);
+        return id;
+    }
+
+public:
+    epoch_domain() : my_global_epoch(0), my_records(nullptr), my_id(register_domain()) {}
+
+    epoch_domain( const epoch_domain& ) = delete;
+    epoch_domain& operator=( const epoch_domain& ) = delete;
+
+    // Not thread-safe
+    ~epoch_domain() {
+        {
+            // The exiting threads do not access the records of the unregistered domain
+            domain_registry& domains = registry();
+            std::lock_guard<std::mutex> lock(domains.my_mutex);
+            domains.my_domains.erase(my_id);
+        }
+
+        thread_record* record = my_records.load(std::memory_order_relaxed);
+        while(record != nullptr) {
+            thread_record* next = record->my_next;
+            reclaim(record, [](epoch_type) { return true; });
+            delete record;
+            record = next;
+        }
+    }
+
+    // Marks the current thread as being inside of the critical section
+    // Guards may be nested, the thread leaves the critical section with the outermost guard
+    class guard {
+    public:
+        guard( epoch_domain& domain ) : my_record(domain.local_record()) {
+            if (my_record->my_nesting++ == 0) {
+                epoch_type epoch = domain.my_global_epoch.load(std::memory_order_seq_cst);
+                my_record->my_announced_epoch.store(active_epoch(epoch), std::memory_order_relaxed);
+                // Announcement should be visible before any access to the shared data
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+            }
+        }
+
+        guard( const guard& ) = delete;
+        guard& operator=( const guard& ) = delete;
+
+        ~guard() {
+            if (--my_record->my_nesting == 0) {
+                my_record->my_announced_epoch.store(quiescent_epoch, std::memory_order_release);
+            }
+        }
+    private:
+        thread_record* my_record;
+    }; // class guard
+
+    // Retires the object which is not reachable from the shared data structure anymore
+    // deleter(context, object) is called when no thread can access the object
+    // The objects retired by the thread are reclaimed in batches by the same thread
+    void retire( void* object, deleter_type deleter, void* context ) {
+        thread_record* record = local_record();
+        // Exclusion of the object should be visible before reading the epoch
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        epoch_type epoch = my_global_epoch.load(std::memory_order_seq_cst);
+        record->my_limbo_list.push_back(retired_object{object, deleter, context, epoch});
+
+        if (record->my_limbo_list.size() % reclamation_period == 0 && !record->my_reclaiming) {
+            collect(record);
+        }
+    }
+
+    // Retires the object allocated by new
+    template <typename T>
+    void retire( T* object ) {
+        retire(object, []( void*, void* obj ) { delete static_cast<T*>(obj); }, nullptr);
+    }
+
+    // Tries to advance the epoch and reclaims the objects retired by the current thread, which cannot be accessed anymore
+    void collect() {
+        collect(local_record());
+    }
+
+    // Returns the number of the objects retired by the current thread, which are not reclaimed yet
+    std::size_t retired_count() {
+        return local_record()->my_limbo_list.size();
+    }
+
+private:
+    thread_record* local_record() {
+        struct record_cache {
+            std::uint64_t my_domain_id = 0;
+            thread_record* my_record = nullptr;
+        };
+        // The record of the last accessed domain is cached separately, since the access to the thread-local object
+        // with the non-trivial destructor requires the initialization check
+        // Domain identifiers are never reused, so the cached record cannot be stale
+        static thread_local record_cache cache;
+
+        if (cache.my_domain_id != my_id) {
+            cache.my_record = find_or_acquire_record();
+            cache.my_domain_id = my_id;
+        }
+        return cache.my_record;
+    }
+
+    thread_record* find_or_acquire_record() {
+        static thread_local thread_registration registration;
+
+        thread_record* record = registration.find(my_id);
+        if (record == nullptr) {
+            record = acquire_record();
+            registration.add(my_id, record);
+        }
+        return record;
+    }
+
+    // Reuses the record released by the exited thread or creates a new one
+    thread_record* acquire_record() {
+        thread_record* head = my_records.load(std::memory_order_acquire);
+        for (thread_record* record = head; record != nullptr; record = record->my_next) {
+            bool in_use = false;
+            if (!record->my_in_use.load(std::memory_order_relaxed) &&
+                record->my_in_use.compare_exchange_strong(in_use, true, std::memory_order_acquire))
+            {
+                return record;
+            }
+        }
+
+        thread_record* new_record = new thread_record();
+        new_record->my_next = head;
+        while(!my_records.compare_exchange_weak(new_record->my_next, new_record,
+                                                std::memory_order_release,
+                                                std::memory_order_relaxed)) {}
+        return new_record;
+    }
+
+    void collect( thread_record* record ) {
+        try_advance();
+        epoch_type current_epoch = my_global_epoch.load(std::memory_order_acquire);
+        // Nobody can observe objects retired two epochs ago
+        reclaim(record, [current_epoch]( epoch_type retire_epoch ) {
+            return retire_epoch + 2 <= current_epoch;
+        });
+    }
+
+    // The global epoch can be advanced if all of the active threads announced it
+    void try_advance() {
+        epoch_type epoch = my_global_epoch.load(std::memory_order_seq_cst);
+
+        for (thread_record* record = my_records.load(std::memory_order_acquire); record != nullptr;
+             record = record->my_next)
+        {
+            epoch_type announced = record->my_announced_epoch.load(std::memory_order_seq_cst);
+            if (announced != quiescent_epoch && announced != active_epoch(epoch)) {
+                return;
+            }
+        }
+        my_global_epoch.compare_exchange_strong(epoch, epoch + 1, std::memory_order_seq_cst);
+    }
+
+    // The deleters may retire other objects, which are appended to the limbo list during the reclamation
+    template <typename Predicate>
+    void reclaim( thread_record* record, const Predicate& can_be_reclaimed ) {
+        auto& limbo_list = record->my_limbo_list;
+        std::size_t n = limbo_list.size();
+        std::size_t kept = 0;
+
+        record->my_reclaiming = true;
+        utils::raii_guard guard([record] { record->my_reclaiming = false; });
+
+        // The list is accessed by the indices, since the deleters may reallocate it
+        for (std::size_t i = 0; i < n; ++i) {
+            retired_object retired = limbo_list[i];
+            if (can_be_reclaimed(retired.my_epoch)) {
+                retired.my_deleter(retired.my_context, retired.my_object);
+            } else {
+                limbo_list[kept++] = retired;
+            }
+        }
+        limbo_list.erase(limbo_list.begin() + kept, limbo_list.begin() + n);
+    }
+
+    std::atomic<epoch_type> my_global_epoch;
+    std::atomic<thread_record*> my_records;
+    const std::uint64_t my_id;
+}; // class epoch_domain
+
+} // namespace internal
+} // namespace tomkv
+
+#endif // __TOMKV_INCLUDE_INTERNAL_EPOCH_HPP
@@ -0,0 +1,770 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Konstantin Boyarinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __TOMKV_INCLUDE_INTERNAL_FLAT_HASH_TABLE_HPP
+#define __TOMKV_INCLUDE_INTERNAL_FLAT_HASH_TABLE_HPP
+
+#include "utils.hpp"
+#include "compact_rw_mutex.hpp"
+#include "locking_policy.hpp"
+#include "sharded_counter.hpp"
+#include <atomic>
+#include <utility>
+#include <mutex>
+#include <shared_mutex>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <functional>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define __TOMKV_FLAT_HASH_TABLE_SSE2 1
+#endif
+
+namespace tomkv {
+namespace internal {
+
+// Control byte of the slot of flat_hash_table
+// The full slot stores 7 lower bits of the hash code, the empty and deleted slots have the high bit set
+using control_byte = std::int8_t;
+
+constexpr control_byte ctrl_empty = -128;
+constexpr control_byte ctrl_deleted = -2;
+
+// Control bytes of the slots, which are probed at once
+class control_group {
+public:
+    static constexpr std::size_t width = 16;
+    using mask_type = std::uint32_t;
+
+    // ctrl should be aligned to width
+    explicit control_group( const control_byte* ctrl ) {
+#if __TOMKV_FLAT_HASH_TABLE_SSE2
+        my_ctrl = _mm_load_si128(reinterpret_cast<const __m128i*>(ctrl));
+#else
+        std::memcpy(my_ctrl, ctrl, width);
+#endif
+    }
+
+    // Returns the bit mask of the slots with the control byte h2
+    mask_type match( control_byte h2 ) const {
+#if __TOMKV_FLAT_HASH_TABLE_SSE2
+        return mask_type(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), my_ctrl)));
+#else
+        return match_if([h2]( control_byte c ) { return c == h2; });
+#endif
+    }
+
+    mask_type match_empty() const {
+        return match(ctrl_empty);
+    }
+
+    mask_type match_empty_or_deleted() const {
+#if __TOMKV_FLAT_HASH_TABLE_SSE2
+        // Only the empty and deleted control bytes have the high bit set
+        return mask_type(_mm_movemask_epi8(my_ctrl));
+#else
+        return match_if([]( control_byte c ) { return c < 0; });
+#endif
+    }
+
+private:
+#if __TOMKV_FLAT_HASH_TABLE_SSE2
+    __m128i my_ctrl;
+#else
+    template <typename Predicate>
+    mask_type match_if( const Predicate& pred ) const {
+        mask_type result = 0;
+        for (std::size_t i = 0; i < width; ++i) {
+            if (pred(my_ctrl[i])) {
+                result |= mask_type(1) << i;
+            }
+        }
+        return result;
+    }
+
+    control_byte my_ctrl[width];
+#endif
+}; // class control_group
+
+// Concurrent hash table with open addressing
+// The table is split into the shards by the high bits of the hash code, each shard is
+// a separate table guarded by its own reader-writer lock and grown independently
+template <typename Key, typename Mapped,
+          typename Hasher, typename KeyEqual,
+          typename Allocator>
+class flat_hash_table {
+public:
+    using key_type = Key;
+    using mapped_type = Mapped;
+    using value_type = std::pair<const key_type, mapped_type>;
+    using allocator_type = Allocator;
+private:
+    using allocator_traits_type = std::allocator_traits<allocator_type>;
+public:
+    using hasher = Hasher;
+    using key_equal = KeyEqual;
+    using size_type = std::size_t;
+
+    class read_accessor;
+    class write_accessor;
+
+private:
+    using mutex_type = compact_rw_mutex;
+    using read_lock_type = std::shared_lock<mutex_type>;
+    using write_lock_type = std::unique_lock<mutex_type>;
+
+    static constexpr size_type group_width = control_group::width;
+
+    struct alignas(group_width) control_block {
+        control_byte my_bytes[group_width];
+    }; // struct control_block
+
+    // Storage for the value, which is constructed only in the full slots
+    union slot {
+        slot() {}
+        ~slot() {}
+
+        value_type my_value;
+    }; // union slot
+
+    class shard_state {
+    public:
+        shard_state() : my_ctrl(nullptr), my_slots(nullptr), my_capacity(0), my_size(0), my_growth_left(0) {}
+
+        size_type number_of_groups() const { return my_capacity / group_width; }
+
+        mutex_type    my_mutex;
+        control_byte* my_ctrl;
+        slot*         my_slots;
+        size_type     my_capacity;
+        size_type     my_size;
+        // Number of empty slots which can be filled before the shard is rehashed
+        size_type     my_growth_left;
+    }; // class shard_state
+
+    static constexpr size_type cache_line_size = 64;
+
+    // Shards are padded to the cache line size to prevent false sharing between the neighbours
+    // alignas is not used, since the user allocator may not support overaligned types
+    // The array of the shards is aligned to the cache line size by hand, see create_shards
+    class shard : public shard_state {
+        char my_padding[cache_line_size - sizeof(shard_state) % cache_line_size];
+    }; // class shard
+
+    template <typename Derived>
+    class accessor_base {
+    public:
+        accessor_base() : my_shard(nullptr), my_slot_index(0) {}
+
+        void release() {
+            Derived* der_this = static_cast<Derived*>(this);
+            auto& der_lock = der_this->lock();
+            if (der_lock) {
+                der_lock.unlock();
+                my_shard = nullptr;
+            }
+        }
+
+        const key_type& key() const { return get_value().first; }
+    protected:
+        void assign( shard* s, size_type slot_index ) {
+            my_shard = s;
+            my_slot_index = slot_index;
+        }
+
+        value_type& get_value() const { return my_shard->my_slots[my_slot_index].my_value; }
+        // The locked shard which contains the value
+        shard* get_shard() const { return my_shard; }
+        size_type get_slot_index() const { return my_slot_index; }
+    private:
+        shard* my_shard;
+        size_type my_slot_index;
+    }; // class accessor_base
+
+public:
+    class read_accessor : public accessor_base<read_accessor> {
+    public:
+        read_accessor() = default;
+        read_accessor( read_accessor&& ) = default;
+
+        ~read_accessor() { this->release(); }
+        const mapped_type& mapped() const { return this->get_value().second; }
+        // See hash_table::read_accessor
+        mapped_type& hazardous_mapped() { return this->get_value().second; }
+        const value_type& value() const { return this->get_value(); }
+        value_type& hazardous_value() { return this->get_value(); }
+
+    private:
+        read_lock_type& lock() { return my_lock; }
+
+        void assign( read_lock_type&& l, shard* s, size_type slot_index ) {
+            my_lock = std::move(l);
+            accessor_base<read_accessor>::assign(s, slot_index);
+        }
+
+        read_lock_type my_lock;
+
+        friend class accessor_base<read_accessor>;
+        friend class flat_hash_table;
+    }; // class read_accessor
+
+    class write_accessor : public accessor_base<write_accessor> {
+    public:
+        write_accessor() = default;
+        write_accessor( write_accessor&& ) = default;
+
+        ~write_accessor() { this->release(); }
+        mapped_type& mapped() { return this->get_value().second; }
+        value_type& value() { return this->get_value(); }
+
+    private:
+        write_lock_type& lock() { return my_lock; }
+
+        void assign( write_lock_type&& l, shard* s, size_type slot_index ) {
+            my_lock = std::move(l);
+            accessor_base<write_accessor>::assign(s, slot_index);
+        }
+
+        write_lock_type my_lock;
+
+        friend class accessor_base<write_accessor>;
+        friend class flat_hash_table;
+    }; // class write_accessor
+
+    flat_hash_table( const hasher& h, const key_equal& key_eq, const allocator_type& allocator )
+        : flat_hash_table(default_number_of_stripes<striped_locking<>>(), h, key_eq, allocator) {}
+
+    flat_hash_table( size_type shard_count, const hasher& h, const key_equal& key_eq, const allocator_type& allocator )
+        : my_allocator(allocator),
+          my_hasher(h),
+          my_equality(key_eq),
+          my_shards_storage(nullptr),
+          my_shards(nullptr),
+          my_shard_count(shard_count),
+          my_shard_shift(sizeof(size_type) * CHAR_BIT - utils::log2(shard_count)),
+          my_size(my_allocator)
+    {
+        __TOMKV_ASSERT(shard_count > 0 && (shard_count & (shard_count - 1)) == 0);
+        create_shards();
+    }
+
+    flat_hash_table( const flat_hash_table& ) = delete;
+    // Copy assignment is implicitly deleted
+
+    ~flat_hash_table() {
+        destroy_shards();
+    }
+
+    template <typename... Args>
+    bool emplace( read_accessor& acc, Args&&... args ) {
+        return internal_emplace(&acc, std::forward<Args>(args)...);
+    }
+
+    template <typename... Args>
+    bool emplace( write_accessor& acc, Args&&... args ) {
+        return internal_emplace(&acc, std::forward<Args>(args)...);
+    }
+
+    template <typename... Args>
+    bool emplace( Args&&... args ) {
+        return internal_emplace(static_cast<read_accessor*>(nullptr), std::forward<Args>(args)...);
+    }
+
+    bool find( read_accessor& acc, const key_type& key ) {
+        return internal_find(acc, key);
+    }
+
+    bool find( write_accessor& acc, const key_type& key ) {
+        return internal_find(acc, key);
+    }
+
+    // The shard is locked for read while the mapped object is copied
+    std::optional<mapped_type> find_copy( const key_type& key ) {
+        size_type hashcode = hash(key);
+        shard& s = get_shard(hashcode);
+        read_lock_type lock(s.my_mutex);
+
+        size_type slot_index = find_slot(s, key, hashcode);
+        if (slot_index == s.my_capacity) {
+            return std::nullopt;
+        }
+        return s.my_slots[slot_index].my_value.second;
+    }
+
+    bool erase( const key_type& key ) {
+        size_type hashcode = hash(key);
+        shard& s = get_shard(hashcode);
+        write_lock_type lock(s.my_mutex);
+
+        size_type slot_index = find_slot(s, key, hashcode);
+        if (slot_index == s.my_capacity) {
+            return false;
+        }
+        erase_slot(s, slot_index);
+        return true;
+    }
+
+    void erase( write_accessor& acc ) {
+        __TOMKV_ASSERT(acc.get_shard() != nullptr);
+        erase_slot(*acc.get_shard(), acc.get_slot_index());
+        acc.release();
+    }
+
+    size_type size() const {
+        return my_size.load();
+    }
+
+    bool empty() const { return size() == 0; }
+
+    // Not thread-safe
+    template <typename Predicate>
+    void for_each( const Predicate& pred ) {
+        for (size_type i = 0; i < my_shard_count; ++i) {
+            shard& s = my_shards[i];
+            for (size_type slot_index = 0; slot_index < s.my_capacity; ++slot_index) {
+                if (s.my_ctrl[slot_index] >= 0) {
+                    pred(s.my_slots[slot_index].my_value);
+                }
+            }
+        }
+    }
+
+    // Not thread-safe
+    void clear() {
+        for (size_type i = 0; i < my_shard_count; ++i) {
+            clear_shard(my_shards[i]);
+        }
+        my_size.store(0);
+    }
+
+    allocator_type get_allocator() const { return my_allocator; }
+
+private:
+    // Allocator types
+    using shard_allocator_type = typename allocator_traits_type::template rebind_alloc<shard>;
+    using control_allocator_type = typename allocator_traits_type::template rebind_alloc<control_block>;
+    using slot_allocator_type = typename allocator_traits_type::template rebind_alloc<slot>;
+
+    // Allocator traits type
+    using shard_allocator_traits = std::allocator_traits<shard_allocator_type>;
+    using control_allocator_traits = std::allocator_traits<control_allocator_type>;
+    using slot_allocator_traits = std::allocator_traits<slot_allocator_type>;
+
+    static constexpr size_type npos = size_type(-1);
+
+    // User hashers (e.g. std::hash for integers) may return the key itself,
+    // so the bits of the hash code are mixed before splitting them
+    size_type hash( const key_type& key ) const {
+        std::uint64_t h = std::uint64_t(my_hasher(key));
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return size_type(h);
+    }
+
+    // Lower 7 bits are stored in the control byte, the rest is used to select the group
+    static control_byte h2( size_type hashcode ) { return control_byte(hashcode & 0x7F); }
+    static size_type h1( size_type hashcode ) { return hashcode >> 7; }
+
+    // Full slots and tombstones may occupy up to 7/8 of the shard
+    static size_type capacity_to_growth( size_type capacity ) {
+        return capacity - capacity / 8;
+    }
+
+    shard& get_shard( size_type hashcode ) const {
+        // Shift by the number of bits in size_type is undefined
+        size_type shard_index = my_shard_count == 1 ? 0 : hashcode >> my_shard_shift;
+        return my_shards[shard_index];
+    }
+
+    void create_shards() {
+        shard_allocator_type shard_allocator(my_allocator);
+        // One extra shard is allocated, so the array fits into the storage after aligning it to the cache line
+        my_shards_storage = shard_allocator_traits::allocate(shard_allocator, my_shard_count + 1);
+        void* base = my_shards_storage;
+        std::size_t space = (my_shard_count + 1) * sizeof(shard);
+        my_shards = static_cast<shard*>(std::align(cache_line_size, my_shard_count * sizeof(shard), base, space));
+        __TOMKV_ASSERT(my_shards != nullptr);
+        for (size_type i = 0; i < my_shard_count; ++i) {
+            shard_allocator_traits::construct(shard_allocator, my_shards + i);
+        }
+    }
+
+    void destroy_shards() {
+        if (my_shards == nullptr) {
+            return;
+        }
+
+        shard_allocator_type shard_allocator(my_allocator);
+        for (size_type i = 0; i < my_shard_count; ++i) {
+            clear_shard(my_shards[i]);
+            deallocate_storage(my_shards[i].my_ctrl, my_shards[i].my_slots, my_shards[i].my_capacity);
+            shard_allocator_traits::destroy(shard_allocator, my_shards + i);
+        }
+        shard_allocator_traits::deallocate(shard_allocator, my_shards_storage, my_shard_count + 1);
+        my_shards_storage = nullptr;
+        my_shards = nullptr;
+    }
+
+    // Allocates the control bytes and the slots for capacity elements, all slots are empty
+    std::pair<control_byte*, slot*> allocate_storage( size_type capacity ) {
+        control_allocator_type control_allocator(my_allocator);
+        slot_allocator_type slot_allocator(my_allocator);
+
+        control_block* blocks = control_allocator_traits::allocate(control_allocator, capacity / group_width);
+        utils::raii_guard guard([&] {
+            control_allocator_traits::deallocate(control_allocator, blocks, capacity / group_width);
+        });
+        slot* slots = slot_allocator_traits::allocate(slot_allocator, capacity);
+        guard.release();
+
+        control_byte* ctrl = reinterpret_cast<control_byte*>(blocks);
+        std::memset(ctrl, ctrl_empty, capacity);
+        return {ctrl, slots};
+    }
+
+    void deallocate_storage( control_byte* ctrl, slot* slots, size_type capacity ) {
+        if (capacity == 0) {
+            return;
+        }
+        control_allocator_type control_allocator(my_allocator);
+        slot_allocator_type slot_allocator(my_allocator);
+
+        control_allocator_traits::deallocate(control_allocator, reinterpret_cast<control_block*>(ctrl),
+                                             capacity / group_width);
+        slot_allocator_traits::deallocate(slot_allocator, slots, capacity);
+    }
+
+    void destroy_value( slot& sl ) {
+        allocator_traits_type::destroy(my_allocator, &sl.my_value);
+    }
+
+    // Not thread-safe, the capacity of the shard is not changed
+    void clear_shard( shard_state& s ) {
+        for (size_type slot_index = 0; slot_index < s.my_capacity; ++slot_index) {
+            if (s.my_ctrl[slot_index] >= 0) {
+                destroy_value(s.my_slots[slot_index]);
+            }
+            s.my_ctrl[slot_index] = ctrl_empty;
+        }
+        s.my_size = 0;
+        s.my_growth_left = capacity_to_growth(s.my_capacity);
+    }
+
+    // Calls body for each group in the probe sequence of the hashcode until it returns true
+    // Triangular probing visits each group exactly once, since the number of groups is a power of 2
+    template <typename Body>
+    static void probe( const shard_state& s, size_type hashcode, const Body& body ) {
+        size_type mask = s.number_of_groups() - 1;
+        size_type group_index = h1(hashcode) & mask;
+
+        for (size_type step = 1; !body(group_index * group_width, control_group(s.my_ctrl + group_index * group_width)); ++step) {
+            __TOMKV_ASSERT(step <= s.number_of_groups());
+            group_index = (group_index + step) & mask;
+        }
+    }
+
+    // Returns the index of the slot with the key or s.my_capacity if the key is not found
+    // Should be called when the shard is locked
+    size_type find_slot( const shard_state& s, const key_type& key, size_type hashcode ) const {
+        if (s.my_size == 0) {
+            return s.my_capacity;
+        }
+
+        size_type result = s.my_capacity;
+        control_byte tag = h2(hashcode);
+
+        probe(s, hashcode, [&]( size_type first_slot, const control_group& group ) {
+            for (control_group::mask_type m = group.match(tag); m != 0; m &= m - 1) {
+                size_type slot_index = first_slot + utils::ctz(m);
+                if (my_equality(s.my_slots[slot_index].my_value.first, key)) {
+                    result = slot_index;
+                    return true;
+                }
+            }
+            // Inserting never skips the group with an empty slot
+            return group.match_empty() != 0;
+        });
+        return result;
+    }
+
+    // Returns the index of the first empty or deleted slot in the probe sequence
+    static size_type find_insert_slot( const shard_state& s, size_type hashcode ) {
+        size_type result = s.my_capacity;
+
+        probe(s, hashcode, [&]( size_type first_slot, const control_group& group ) {
+            control_group::mask_type m = group.match_empty_or_deleted();
+            if (m != 0) {
+                result = first_slot + utils::ctz(m);
+                return true;
+            }
+            return false;
+        });
+        return result;
+    }
+
+    // Constructs the value in the slot for hashcode, the shard should have enough capacity
+    template <typename... Args>
+    size_type construct_in_shard( shard_state& s, size_type hashcode, Args&&... args ) {
+        size_type slot_index = find_insert_slot(s, hashcode);
+        allocator_traits_type::construct(my_allocator, &s.my_slots[slot_index].my_value, std::forward<Args>(args)...);
+
+        if (s.my_ctrl[slot_index] == ctrl_empty) {
+            --s.my_growth_left;
+        }
+        s.my_ctrl[slot_index] = h2(hashcode);
+        ++s.my_size;
+        return slot_index;
+    }
+
+    // Moves the elements of the shard into the new storage
+    // If the shard is filled mostly with tombstones, the capacity is not changed
+    // Should be called when the shard is locked for write
+    void rehash_shard( shard_state& s ) {
+        size_type new_capacity = s.my_capacity == 0 ? group_width : s.my_capacity;
+        if (s.my_size >= capacity_to_growth(new_capacity) / 2) {
+            new_capacity *= 2;
+        }
+
+        std::pair<control_byte*, slot*> new_storage = allocate_storage(new_capacity);
+        shard_state new_shard;
+        new_shard.my_ctrl = new_storage.first;
+        new_shard.my_slots = new_storage.second;
+        new_shard.my_capacity = new_capacity;
+        new_shard.my_growth_left = capacity_to_growth(new_capacity);
+
+        utils::raii_guard guard([&] {
+            clear_shard(new_shard);
+            deallocate_storage(new_shard.my_ctrl, new_shard.my_slots, new_shard.my_capacity);
+        });
+
+        for (size_type slot_index = 0; slot_index < s.my_capacity; ++slot_index) {
+            if (s.my_ctrl[slot_index] >= 0) {
+                value_type& value = s.my_slots[slot_index].my_value;
+                construct_in_shard(new_shard, hash(value.first), std::move_if_noexcept(value));
+            }
+        }
+        guard.release();
+
+        size_type size = s.my_size;
+        clear_shard(s);
+        deallocate_storage(s.my_ctrl, s.my_slots, s.my_capacity);
+
+        s.my_ctrl = new_shard.my_ctrl;
+        s.my_slots = new_shard.my_slots;
+        s.my_capacity = new_shard.my_capacity;
+        s.my_size = size;
+        s.my_growth_left = new_shard.my_growth_left;
+    }
+
+    // Inserts the value if the key is not present in the shard
+    // Returns the index of the slot with the key and true if the value was inserted
+    // Should be called when the shard is locked for write
+    template <typename Value>
+    std::pair<size_type, bool> insert_into_shard( shard_state& s, size_type hashcode, Value&& value ) {
+        size_type slot_index = find_slot(s, value.first, hashcode);
+        if (slot_index != s.my_capacity) {
+            return {slot_index, false};
+        }
+
+        if (s.my_growth_left == 0) {
+            rehash_shard(s);
+        }
+        slot_index = construct_in_shard(s, hashcode, std::forward<Value>(value));
+        my_size.add(1);
+        return {slot_index, true};
+    }
+
+    // Should be called when the shard is locked for write
+    void erase_slot( shard_state& s, size_type slot_index ) {
+        destroy_value(s.my_slots[slot_index]);
+
+        // If the group of the slot has an empty slot, no probe sequence was continued
+        // after this group and the slot can become empty
+        control_group group(s.my_ctrl + slot_index / group_width * group_width);
+        if (group.match_empty() != 0) {
+            s.my_ctrl[slot_index] = ctrl_empty;
+            ++s.my_growth_left;
+        } else {
+            s.my_ctrl[slot_index] = ctrl_deleted;
+        }
+        --s.my_size;
+        my_size.sub(1);
+    }
+
+    // The value is constructed before locking the shard, since the key is required to select the shard
+    // If the accessor is nullptr, the duplicated key is searched under the read lock as well
+    template <typename Accessor, typename... Args>
+    bool internal_emplace( Accessor* accessor, Args&&... args ) {
+        value_type value(std::forward<Args>(args)...);
+        size_type hashcode = hash(value.first);
+        shard& s = get_shard(hashcode);
+
+        if (accessor != nullptr) {
+            accessor->release();
+        }
+
+        if constexpr (std::is_same_v<Accessor, read_accessor>) {
+            // Fast path - the key is already present
+            read_lock_type lock(s.my_mutex);
+            size_type slot_index = find_slot(s, value.first, hashcode);
+            if (slot_index != s.my_capacity) {
+                if (accessor != nullptr) {
+                    accessor->assign(std::move(lock), &s, slot_index);
+                }
+                return false;
+            }
+        }
+
+        write_lock_type lock(s.my_mutex);
+        std::pair<size_type, bool> result = insert_into_shard(s, hashcode, std::move(value));
+
+        if constexpr (std::is_same_v<Accessor, write_accessor>) {
+            accessor->assign(std::move(lock), &s, result.first);
+        } else if (accessor != nullptr) {
+            // The write lock is downgraded, so the element cannot be erased before the accessor is assigned
+            lock.release();
+            s.my_mutex.unlock_and_lock_shared();
+            accessor->assign(read_lock_type(s.my_mutex, std::adopt_lock), &s, result.first);
+        }
+        return result.second;
+    }
+
+    template <typename Accessor>
+    bool internal_find( Accessor& accessor, const key_type& key ) {
+        using lock_type = std::remove_reference_t<decltype(accessor.lock())>;
+        accessor.release();
+
+        size_type hashcode = hash(key);
+        shard& s = get_shard(hashcode);
+        lock_type lock(s.my_mutex);
+
+        size_type slot_index = find_slot(s, key, hashcode);
+        if (slot_index == s.my_capacity) {
+            return false;
+        }
+        accessor.assign(std::move(lock), &s, slot_index);
+        return true;
+    }
+
+protected:
+    size_type shard_count() const { return my_shard_count; }
+
+    template <bool Move, typename HashTable>
+    void internal_move_or_copy( HashTable&& other ) {
+        utils::raii_guard guard([&]{ clear(); });
+
+        for (size_type i = 0; i < other.my_shard_count; ++i) {
+            shard& other_shard = other.my_shards[i];
+            for (size_type slot_index = 0; slot_index < other_shard.my_capacity; ++slot_index) {
+                if (other_shard.my_ctrl[slot_index] >= 0) {
+                    value_type& value = other_shard.my_slots[slot_index].my_value;
+                    size_type hashcode = hash(value.first);
+                    if constexpr (Move) {
+                        insert_into_shard(get_shard(hashcode), hashcode, std::move(value));
+                    } else {
+                        insert_into_shard(get_shard(hashcode), hashcode, value);
+                    }
+                }
+            }
+        }
+        guard.release();
+    }
+
+    void internal_copy( const flat_hash_table& other ) {
+        internal_move_or_copy</*Move*/false>(other);
+    }
+
+    // Stealing move
+    // The shards of this table are exchanged with the shards of other
+    void internal_move( flat_hash_table&& other ) {
+        __TOMKV_ASSERT(empty());
+        std::swap(my_shards_storage, other.my_shards_storage);
+        std::swap(my_shards, other.my_shards);
+        std::swap(my_shard_count, other.my_shard_count);
+        std::swap(my_shard_shift, other.my_shard_shift);
+
+        my_size.store(other.my_size.load());
+        other.my_size.store(0);
+    }
+
+    void internal_move_with_allocator( flat_hash_table&& other, const allocator_type& alloc ) {
+        if constexpr (allocator_traits_type::is_always_equal::value) {
+            internal_move(std::move(other));
+        } else {
+            if (alloc == other.my_allocator) {
+                internal_move(std::move(other));
+            } else {
+                internal_move_or_copy</*Move*/true>(other);
+            }
+        }
+    }
+
+    void internal_copy_assign( const flat_hash_table& other ) {
+        __TOMKV_ASSERT(this != &other);
+        clear();
+        internal_copy(other);
+    }
+
+    void internal_move_assign( flat_hash_table&& other ) {
+        __TOMKV_ASSERT(this != &other);
+        clear();
+
+        if constexpr (allocator_traits_type::propagate_on_container_move_assignment::value ||
+                      allocator_traits_type::is_always_equal::value)
+        {
+            // Stealing move
+            internal_move(std::move(other));
+        } else {
+            if (my_allocator == other.my_allocator) {
+                internal_move(std::move(other));
+            } else {
+                internal_move_or_copy</*Move*/true>(other);
+            }
+        }
+    }
+
+    allocator_type         my_allocator;
+    hasher                 my_hasher;
+    key_equal              my_equality;
+private:
+    // Storage returned by the allocator, my_shards points to the aligned array within it
+    shard*                 my_shards_storage;
+    shard*                 my_shards;
+    size_type              my_shard_count;
+    size_type              my_shard_shift;
+    // Each thread modifies its own counter, the counters are placed on the separate cache lines
+    sharded_counter<allocator_type> my_size;
+}; // class flat_hash_table
+
+} // namespace internal
+} // namespace tomkv
+
+#endif // __TOMKV_INCLUDE_INTERNAL_FLAT_HASH_TABLE_HPP
@@ -26,18 +26,44 @@
 #define __TOMKV_INCLUDE_INTERNAL_HASH_TABLE_HPP
 
 #include "utils.hpp"
+#include "epoch.hpp"
+#include "locking_policy.hpp"
+#include "parallel.hpp"
+#include "sharded_counter.hpp"
+#include "snapshot.hpp"
+#include "statistics.hpp"
 #include <shared_mutex>
 #include <atomic>
 #include <utility>
 #include <mutex>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <functional>
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <vector>
 
 namespace tomkv {
 namespace internal {
 
+template <typename T, typename = void>
+struct is_transparent : std::false_type {};
+
+template <typename T>
+struct is_transparent<T, std::void_t<typename T::is_transparent>> : std::true_type {};
+
 template <typename Key, typename Mapped,
           typename Hasher, typename KeyEqual,
-          typename Allocator>
-class hash_table {
+          typename Allocator,
+          typename LockingPolicy = per_bucket_locking>
+class hash_table : private hash_table_statistics_recorder<> {
+    using statistics_recorder_type = hash_table_statistics_recorder<>;
 public:
     using key_type = Key;
     using mapped_type = Mapped;
@@ -49,12 +75,21 @@ public:
     using hasher = Hasher;
     using key_equal = KeyEqual;
     using size_type = std::size_t;
+    using locking_policy = LockingPolicy;
 
     class read_accessor;
     class write_accessor;
 
 private:
     static constexpr size_type init_bucket_count = 8;
+
+    // Heterogeneous overloads are enabled if both the hasher and the key equality are transparent
+    // The accessors are excluded to keep the overloads taking the accessor as the first argument
+    template <typename K>
+    using enable_if_transparent = std::enable_if_t<is_transparent<hasher>::value &&
+                                                   is_transparent<key_equal>::value &&
+                                                   !std::is_same_v<std::decay_t<K>, read_accessor> &&
+                                                   !std::is_same_v<std::decay_t<K>, write_accessor>>;
 public:
     hash_table( hasher& h,
                 key_equal& key_eq,
@@ -68,16 +103,27 @@ public:
         : my_allocator(allocator),
           my_hasher(h),
           my_equality(key_eq),
-          my_bucket_count(bc),
-          my_size(0),
-          my_rehash_required_flag(false),
-          my_segment_table(create_table()) {}
+          my_size(allocator),
+          my_segment_table(create_table()),
+          my_stripes(nullptr),
+          my_stripe_count(0),
+          my_bucket_count(round_up_bucket_count(bc)),
+          my_max_load_factor(default_max_load_factor),
+          my_approximate_size(0)
+    {
+        utils::raii_guard guard([&]{ destroy_table(); });
+        // Segments for the initial buckets are allocated eagerly
+        allocate_segments(bucket_count());
+        create_stripes();
+        guard.release();
+    }
 
     hash_table( const hash_table& ) = delete;
     // Copy assignment is implicitly deleted
 
     ~hash_table() {
         destroy_table();
+        destroy_stripes();
     }
 
     template <typename... Args>
@@ -96,6 +142,115 @@ public:
         return internal_emplace(racc, std::forward<Args>(args)...);
     }
 
+    // The node is constructed only if there is no element with equal key, the mapped object is constructed from args
+    template <typename... Args>
+    bool try_emplace( read_accessor& acc, const key_type& key, Args&&... args ) {
+        return internal_try_emplace(acc, key, std::forward<Args>(args)...);
+    }
+
+    template <typename... Args>
+    bool try_emplace( read_accessor& acc, key_type&& key, Args&&... args ) {
+        return internal_try_emplace(acc, std::move(key), std::forward<Args>(args)...);
+    }
+
+    template <typename K, typename... Args, typename = enable_if_transparent<K>>
+    bool try_emplace( read_accessor& acc, K&& key, Args&&... args ) {
+        return internal_try_emplace(acc, std::forward<K>(key), std::forward<Args>(args)...);
+    }
+
+    template <typename... Args>
+    bool try_emplace( write_accessor& acc, const key_type& key, Args&&... args ) {
+        return internal_try_emplace(acc, key, std::forward<Args>(args)...);
+    }
+
+    template <typename... Args>
+    bool try_emplace( write_accessor& acc, key_type&& key, Args&&... args ) {
+        return internal_try_emplace(acc, std::move(key), std::forward<Args>(args)...);
+    }
+
+    template <typename K, typename... Args, typename = enable_if_transparent<K>>
+    bool try_emplace( write_accessor& acc, K&& key, Args&&... args ) {
+        return internal_try_emplace(acc, std::forward<K>(key), std::forward<Args>(args)...);
+    }
+
+    template <typename... Args>
+    bool try_emplace( const key_type& key, Args&&... args ) {
+        read_accessor racc;
+        return internal_try_emplace(racc, key, std::forward<Args>(args)...);
+    }
+
+    template <typename... Args>
+    bool try_emplace( key_type&& key, Args&&... args ) {
+        read_accessor racc;
+        return internal_try_emplace(racc, std::move(key), std::forward<Args>(args)...);
+    }
+
+    template <typename K, typename... Args, typename = enable_if_transparent<K>>
+    bool try_emplace( K&& key, Args&&... args ) {
+        read_accessor racc;
+        return internal_try_emplace(racc, std::forward<K>(key), std::forward<Args>(args)...);
+    }
+
+    // Inserts the element or assigns obj to the mapped object of the existing element under the write lock
+    // Returns true if the element was inserted
+    template <typename M>
+    bool insert_or_assign( const key_type& key, M&& obj ) {
+        return internal_insert_or_assign(key, std::forward<M>(obj));
+    }
+
+    template <typename M>
+    bool insert_or_assign( key_type&& key, M&& obj ) {
+        return internal_insert_or_assign(std::move(key), std::forward<M>(obj));
+    }
+
+    template <typename K, typename M, typename = enable_if_transparent<K>>
+    bool insert_or_assign( K&& key, M&& obj ) {
+        return internal_insert_or_assign(std::forward<K>(key), std::forward<M>(obj));
+    }
+
+    // Applies fn to the mapped object under the write lock, the element with value-initialized
+    // mapped object is inserted first if there is no element with equal key
+    // Returns true if the element was inserted
+    template <typename Function>
+    bool compute( const key_type& key, const Function& fn ) {
+        return internal_compute(key, fn);
+    }
+
+    template <typename Function>
+    bool compute( key_type&& key, const Function& fn ) {
+        return internal_compute(std::move(key), fn);
+    }
+
+    template <typename K, typename Function, typename = enable_if_transparent<K>>
+    bool compute( K&& key, const Function& fn ) {
+        return internal_compute(std::forward<K>(key), fn);
+    }
+
+    // Applies fn to the mapped object under the write lock if the element exists and pred returns true for it
+    // Returns true if fn was applied
+    template <typename Predicate, typename Function>
+    bool update_if( const key_type& key, const Predicate& pred, const Function& fn ) {
+        return internal_update_if(key, pred, fn);
+    }
+
+    template <typename K, typename Predicate, typename Function, typename = enable_if_transparent<K>>
+    bool update_if( const K& key, const Predicate& pred, const Function& fn ) {
+        return internal_update_if(key, pred, fn);
+    }
+
+    // Elements with the keys which are already in the table are not inserted
+    template <typename InputIterator>
+    void insert( InputIterator first, InputIterator last ) {
+        internal_insert(first, last);
+    }
+
+    // The elements are partitioned by the hash code and each partition is inserted by a separate thread
+    // The parallel insertion is used only for the random access iterators
+    template <typename InputIterator>
+    void insert( InputIterator first, InputIterator last, const parallel_policy& policy ) {
+        internal_parallel_insert(first, last, policy);
+    }
+
     bool find( read_accessor& acc, const key_type& key ) {
         return internal_find(acc, key);
     }
@@ -104,23 +259,83 @@ public:
         return internal_find(acc, key);
     }
 
+    // Heterogeneous lookup, the key is not converted to key_type
+    template <typename K, typename = enable_if_transparent<K>>
+    bool find( read_accessor& acc, const K& key ) {
+        return internal_find(acc, key);
+    }
+
+    template <typename K, typename = enable_if_transparent<K>>
+    bool find( write_accessor& acc, const K& key ) {
+        return internal_find(acc, key);
+    }
+
+    // Returns a copy of the mapped object without locking the bucket if possible
+    std::optional<mapped_type> find_copy( const key_type& key ) {
+        return internal_find_copy(key);
+    }
+
+    template <typename K, typename = enable_if_transparent<K>>
+    std::optional<mapped_type> find_copy( const K& key ) {
+        return internal_find_copy(key);
+    }
+
+    // Writes the results of find_copy for each key from [first, last) to out, the cache misses of the lookups are overlapped
+    // Returns the number of the found elements
+    template <typename KeyIterator, typename OutputIterator>
+    size_type find_many( KeyIterator first, KeyIterator last, OutputIterator out ) {
+        return internal_find_many(first, last, out);
+    }
+
     bool erase( const key_type& key ) {
         return internal_erase(key);
     }
 
+    template <typename K, typename = enable_if_transparent<K>>
+    bool erase( const K& key ) {
+        return internal_erase(key);
+    }
+
     void erase( write_accessor& acc ) {
         return internal_erase(acc);
     }
 
+    // Sums up the per-thread counters
     size_type size() const {
-        return my_size.load(std::memory_order_relaxed);
+        return my_size.load();
+    }
+
+    // Returns the size observed by the latest periodic check of the counters, without reading them
+    // May lag behind size() by a fraction of the bucket count
+    size_type approximate_size() const {
+        return my_approximate_size.load(std::memory_order_relaxed);
     }
 
     bool empty() const { return size() == 0; }
 
+    // Weakly consistent traversal, see bucket_range
     template <typename Predicate>
     void for_each( const Predicate& pred ) {
-        internal_for_each(pred);
+        range().for_each(pred);
+    }
+
+    class bucket_range;
+
+    // Returns the range of all buckets, which can be split to traverse the table in parallel
+    bucket_range range() {
+        return bucket_range(*this, 0, bucket_count(), bucket_count());
+    }
+
+    // Writes the elements to the snapshot file at path, the writers are blocked only while their group of buckets is copied
+    // The file is replaced only when the snapshot is complete
+    void save_snapshot( const std::string& path ) {
+        internal_save_snapshot(path);
+    }
+
+    // Inserts the elements from the snapshot file at path, the table is reserved for them at once
+    // Elements with the keys which are already in the table are not inserted
+    void load_snapshot( const std::string& path, const parallel_policy& policy = parallel_policy() ) {
+        internal_load_snapshot(path, policy);
     }
 
     // Not thread-safe
@@ -128,33 +343,84 @@ public:
         internal_clear();
     }
 
+    size_type bucket_count() const { return my_bucket_count.load(std::memory_order_relaxed); }
+
+    float load_factor() const { return float(size()) / float(bucket_count()); }
+
+    float max_load_factor() const { return my_max_load_factor.load(std::memory_order_relaxed); }
+
+    // The new value is applied by the next insertions, the buckets are not merged or split at once
+    void max_load_factor( float ml ) {
+        __TOMKV_ASSERT(ml > 0);
+        my_max_load_factor.store(ml, std::memory_order_relaxed);
+    }
+
+    // Sets the number of buckets to at least bc
+    // The number of buckets is never decreased, use shrink_to_fit to decrease it
+    void rehash( size_type bc ) {
+        grow_bucket_count(round_up_bucket_count(bc));
+    }
+
+    // Sets the number of buckets to hold at least n elements without exceeding max_load_factor
+    // The arithmetic is done in double, since float represents the integers above 2^24 inexactly
+    void reserve( size_type n ) {
+        rehash(size_type(std::ceil(double(n) / double(max_load_factor()))));
+    }
+
+    // Merges the buckets to the minimal number required for the current size and deallocates the unused segments
+    // Not thread-safe
+    void shrink_to_fit() {
+        internal_shrink_to_fit();
+    }
+
     allocator_type get_allocator() const { return my_allocator; }
 
+    // The lengths of the chains are counted under the locks of each bucket
+    // The events are reported only if TOMKV_ENABLE_STATISTICS is defined
+    hash_table_statistics stats() {
+        return internal_stats();
+    }
+
 private:
     class node {
     public:
         template <typename... Args>
-        node( Args&&... args ) : my_next(nullptr), my_value(std::forward<Args>(args)...) {}
+        node( Args&&... args ) : my_next(nullptr), my_hash(0), my_value(std::forward<Args>(args)...) {}
 
         const key_type& key() const { return my_value.first; }
+        // The hash code is computed once after the construction of the node
+        // and reused for the comparisons and moving the node between the buckets
+        size_type hash() const { return my_hash; }
+        void set_hash( size_type h ) { my_hash = h; }
         mapped_type& mapped() { return my_value.second; }
         value_type& value() { return my_value; }
 
-        void set_next( node* n ) { my_next = n; }
-        node* next() const { return my_next; }
+        // The list may be traversed without locks - next pointers are atomic
+        void set_next( node* n ) { my_next.store(n, std::memory_order_release); }
+        node* next() const { return my_next.load(std::memory_order_acquire); }
     private:
-        node* my_next;
+        std::atomic<node*> my_next;
+        size_type my_hash;
         value_type my_value;
     }; // class node
 
-    class bucket {
-    public:
-        bucket() noexcept : my_list(nullptr) {}
+    // A list of the bucket which elements are still stored in the parent bucket
+    static node* rehash_required() {
+        return reinterpret_cast<node*>(std::uintptr_t(1));
+    }
 
-        using read_lock_type = std::shared_lock<std::shared_mutex>;
-        using write_lock_type = std::unique_lock<std::shared_mutex>;
+    // The version of the lock is odd while it is locked for write, so the lock-free
+    // readers can validate that the bucket was not modified during the traversal
+    using lock_type = versioned_rw_lock;
+    using read_lock_type = std::shared_lock<lock_type>;
+    using write_lock_type = std::unique_lock<lock_type>;
 
-        std::shared_mutex& mutex() { return my_mutex; }
+    static constexpr bool is_striped = is_striped_locking<locking_policy>::value;
+
+    // With per-bucket locking, the lock and the list are packed into 16 bytes on 64-bit platforms
+    class bucket : public bucket_lock_storage<locking_policy> {
+    public:
+        bucket( node* list = nullptr ) noexcept : my_list(list) {}
 
         node* load_list() const {
             return my_list.load(std::memory_order_acquire);
@@ -168,10 +434,15 @@ private:
         // actual head may be changed between search and try_insert
         bool try_insert( node* head, node* new_node ) {
             new_node->set_next(head);
-            return my_list.compare_exchange_strong(head, new_node, std::memory_order_acquire,
+            // Release is required to publish the node for the lock-free readers
+            return my_list.compare_exchange_strong(head, new_node, std::memory_order_acq_rel,
                                                    std::memory_order_relaxed);
         }
 
+        bool is_rehash_required() const {
+            return load_list() == rehash_required();
+        }
+
         // Not thread-safe
         void relaxed_insert( node* new_node ) {
             node* head = load_list();
@@ -179,20 +450,20 @@ private:
             my_list.store(new_node, std::memory_order_relaxed);
         }
     private:
-        std::shared_mutex my_mutex;
         std::atomic<node*> my_list;
     }; // class bucket
 
     template <typename Derived>
     class accessor_base {
     public:
-        accessor_base() : my_node(nullptr) {}
+        accessor_base() : my_bucket(nullptr), my_node(nullptr) {}
 
         void release() {
             Derived* der_this = static_cast<Derived*>(this);
             auto& der_lock = der_this->lock();
             if (der_lock) {
                 der_lock.unlock();
+                my_bucket = nullptr;
                 my_node = nullptr;
             }
         }
@@ -200,8 +471,12 @@ private:
         const key_type& key() const { return my_node->key(); }
     protected:
         void assign( node* n ) { my_node = n; }
+        void assign_bucket( bucket* b ) { my_bucket = b; }
         node* get_node() const { return my_node; }
+        // The locked bucket which contains the node
+        bucket* get_bucket() const { return my_bucket; }
     private:
+        bucket* my_bucket;
         node* my_node;
     }; // class accessor_base
 
@@ -221,17 +496,21 @@ public:
         value_type& hazardous_value() { return get_node()->value(); }
 
     private:
-        typename bucket::read_lock_type& lock() { return my_lock; }
+        read_lock_type& lock() { return my_lock; }
 
         using accessor_base<read_accessor>::assign;
         using accessor_base<read_accessor>::get_node;
+        using accessor_base<read_accessor>::get_bucket;
 
-        void assign( std::shared_mutex& m, node* n ) {
-            my_lock = typename bucket::read_lock_type{m};
+        void assign( read_lock_type&& l, bucket* b, node* n ) {
+            my_lock = std::move(l);
+            this->assign_bucket(b);
             assign(n);
         }
 
-        typename bucket::read_lock_type my_lock;
+        using lock_holder_type = read_lock_type;
+
+        read_lock_type my_lock;
 
         friend class accessor_base<read_accessor>;
         friend class hash_table;
@@ -247,22 +526,69 @@ public:
         value_type& value() { return this->get_node()->value(); }
 
     private:
-        typename bucket::write_lock_type& lock() { return my_lock; }
+        write_lock_type& lock() { return my_lock; }
 
         using accessor_base<write_accessor>::assign;
         using accessor_base<write_accessor>::get_node;
+        using accessor_base<write_accessor>::get_bucket;
 
-        void assign( std::shared_mutex& m, node* n ) {
-            my_lock = typename bucket::write_lock_type{m};
+        void assign( write_lock_type&& l, bucket* b, node* n ) {
+            my_lock = std::move(l);
+            this->assign_bucket(b);
             this->assign(n);
         }
 
-        typename bucket::write_lock_type my_lock;
+        using lock_holder_type = write_lock_type;
+
+        write_lock_type my_lock;
 
         friend class accessor_base<write_accessor>;
         friend class hash_table;
     }; // class write_accessor
 
+    // Range of the groups of buckets [begin, end) at the level of the bucket count observed by range()
+    // The group contains the elements which hash code modulo the level is equal to the group index,
+    // so the elements are never moved between the groups while the table grows
+    // Elements, which are neither inserted nor erased during the traversal, are visited exactly once
+    class bucket_range {
+    public:
+        bool empty() const { return my_begin == my_end; }
+
+        bool is_divisible() const { return my_end - my_begin > 1; }
+
+        size_type size() const { return my_end - my_begin; }
+
+        // This range becomes the first half, the second half is returned
+        bucket_range split() {
+            __TOMKV_ASSERT(is_divisible());
+            size_type middle = my_begin + (my_end - my_begin) / 2;
+            bucket_range second(*my_table, middle, my_end, my_level);
+            my_end = middle;
+            return second;
+        }
+
+        // Each group is locked for write while pred is applied to its elements
+        // pred should not access the table
+        template <typename Predicate>
+        void for_each( const Predicate& pred ) const {
+            std::vector<lock_type*> locks;
+            for (size_type group_index = my_begin; group_index < my_end; ++group_index) {
+                my_table->traverse_group(group_index, my_level, locks, pred);
+            }
+        }
+
+    private:
+        bucket_range( hash_table& table, size_type begin, size_type end, size_type level )
+            : my_table(&table), my_begin(begin), my_end(end), my_level(level) {}
+
+        hash_table* my_table;
+        size_type my_begin;
+        size_type my_end;
+        size_type my_level;
+
+        friend class hash_table;
+    }; // class bucket_range
+
 private:
     using segment_type = std::atomic<bucket*>;
 
@@ -270,13 +596,29 @@ private:
     using bucket_allocator_type = typename allocator_traits_type::template rebind_alloc<bucket>;
     using table_allocator_type = typename allocator_traits_type::template rebind_alloc<segment_type>;
     using node_allocator_type = typename allocator_traits_type::template rebind_alloc<node>;
+    using stripe_allocator_type = typename allocator_traits_type::template rebind_alloc<lock_type>;
 
     // Allocator traits type
     using bucket_allocator_traits = std::allocator_traits<bucket_allocator_type>;
     using table_allocator_traits = std::allocator_traits<table_allocator_type>;
     using node_allocator_traits = std::allocator_traits<node_allocator_type>;
-
-    static constexpr float max_load_factor = 1.0;
+    using stripe_allocator_traits = std::allocator_traits<stripe_allocator_type>;
+
+    static constexpr float default_max_load_factor = 1.0;
+    static constexpr std::size_t optimistic_find_attempts = 4;
+    // Number of keys between the consecutive stages of find_many
+    static constexpr size_type find_prefetch_distance = 8;
+    // Bulk operations on fewer elements per thread are executed by the calling thread
+    static constexpr size_type min_parallel_chunk_size = 4096;
+    // More partitions than threads to balance the load if the hash codes are skewed
+    static constexpr size_type partitions_per_thread = 8;
+    // The load factor may exceed the maximum by 1 / size_check_ratio until the table grows
+    static constexpr size_type size_check_ratio = 8;
+    static constexpr size_type cache_line_size = 64;
+    // The elements are copied to the buffer under the locks, the buffer is written to the file without them
+    static constexpr size_type snapshot_buffer_size = size_type(1) << 20;
+    // Segments which span several huge pages are backed by the huge pages to reduce the TLB misses
+    static constexpr size_type min_huge_segment_size = 2 * utils::huge_page_size;
 
     // Returns an index of the segment in which the bucket with global_index is stored
     static constexpr size_type index_in_the_table( size_type global_index ) {
@@ -306,12 +648,66 @@ private:
         return my_segment_table[segment_index].load(std::memory_order_relaxed) + index_in_the_segment;
     }
 
-    bucket* get_bucket( size_type bucket_index ) {
-        size_type segment_index = index_in_the_table(bucket_index);
-        create_segment_if_necessary(segment_index);
-        size_type index_in_the_segment = bucket_index - first_index_in_segment(segment_index);
+    // Returns the lock which guards the bucket with bucket_index
+    lock_type& get_lock( bucket* b, size_type bucket_index ) {
+        if constexpr (is_striped) {
+            utils::suppress_unused(b);
+            return my_stripes[bucket_index & (my_stripe_count - 1)];
+        } else {
+            utils::suppress_unused(bucket_index);
+            return b->bucket_lock();
+        }
+    }
 
-        return my_segment_table[segment_index].load(std::memory_order_relaxed) + index_in_the_segment;
+    // Acquires the lock, the waiting time is recorded only if it is held by the other thread
+    template <typename LockHolder>
+    LockHolder acquire_lock( lock_type& l ) {
+        if constexpr (statistics_enabled) {
+            LockHolder holder{l, std::try_to_lock};
+            if (!holder.owns_lock()) {
+                auto start = this->start_timer();
+                holder.lock();
+                this->record_lock_wait(start);
+            }
+            return holder;
+        } else {
+            return LockHolder{l};
+        }
+    }
+
+    // The number of stripes does not depend on the bucket count
+    void create_stripes() {
+        if constexpr (is_striped) {
+            stripe_allocator_type stripe_allocator{my_allocator};
+            size_type stripe_count = default_number_of_stripes<locking_policy>();
+            my_stripes = stripe_allocator_traits::allocate(stripe_allocator, stripe_count);
+
+            for (size_type i = 0; i < stripe_count; ++i) {
+                // Constructor of the lock is noexcept - no extra care needed
+                stripe_allocator_traits::construct(stripe_allocator, my_stripes + i);
+            }
+            my_stripe_count = stripe_count;
+        }
+    }
+
+    void destroy_stripes() {
+        if (my_stripes != nullptr) {
+            stripe_allocator_type stripe_allocator{my_allocator};
+
+            for (size_type i = 0; i < my_stripe_count; ++i) {
+                stripe_allocator_traits::destroy(stripe_allocator, my_stripes + i);
+            }
+            stripe_allocator_traits::deallocate(stripe_allocator, my_stripes, my_stripe_count);
+        }
+    }
+
+    // Bucket count should be a power of 2 to split the buckets by the hash bits
+    static size_type round_up_bucket_count( size_type bc ) {
+        size_type result = size_of_the_segment(0);
+        while (result < bc) {
+            result <<= 1;
+        }
+        return result;
     }
 
     template <typename... Args>
@@ -334,6 +730,13 @@ private:
         node_allocator_traits::deallocate(node_allocator, n, 1);
     }
 
+    // The node excluded from the list can still be accessed by the lock-free readers
+    void retire_node( node* n ) {
+        my_epoch_domain.retire(n, []( void* table, void* object ) {
+            static_cast<hash_table*>(table)->destroy_node(static_cast<node*>(object));
+        }, this);
+    }
+
     // Not thread-safe
     segment_type* create_table() const {
         table_allocator_type table_allocator{my_allocator};
@@ -361,30 +764,67 @@ private:
         table_allocator_traits::deallocate(table_allocator, my_segment_table, size_of_the_table());
     }
 
-    void create_segment_if_necessary( size_type segment_index ) {
-        if (my_segment_table[segment_index].load(std::memory_order_relaxed) == nullptr) {
-            bucket_allocator_type bucket_allocator{my_allocator};
-            bucket* buckets_in_segment = bucket_allocator_traits::allocate(bucket_allocator, size_of_the_segment(segment_index));
+    // Returns true if the segment was created by the current thread
+    bool create_segment( size_type segment_index, node* initial_list ) {
+        bucket_allocator_type bucket_allocator{my_allocator};
+        bucket* buckets_in_segment = bucket_allocator_traits::allocate(bucket_allocator, size_of_the_segment(segment_index));
 
+        // The advice should precede the construction of the buckets, which touches the pages
+        if (size_of_the_segment(segment_index) * sizeof(bucket) >= min_huge_segment_size) {
+            utils::advise_huge_pages(buckets_in_segment, size_of_the_segment(segment_index) * sizeof(bucket));
+        }
+
+        for (size_type i = 0; i < size_of_the_segment(segment_index); ++i) {
+            // Constructor of the bucket is noexcept - no extra care needed
+            bucket_allocator_traits::construct(bucket_allocator, buckets_in_segment + i, initial_list);
+        }
+
+        bucket* expected = nullptr;
+        if (!my_segment_table[segment_index].compare_exchange_strong(expected, buckets_in_segment,
+                                                                     std::memory_order_release,
+                                                                     std::memory_order_relaxed))
+        {
+            // CAS failed => an other thread creates a segment
             for (size_type i = 0; i < size_of_the_segment(segment_index); ++i) {
-                // Default constructor of the bucket is noexcept - no extra care needed
-                bucket_allocator_traits::construct(bucket_allocator, buckets_in_segment + i);
-            }
-
-            bucket* expected = nullptr;
-            if (!my_segment_table[segment_index].compare_exchange_strong(expected, buckets_in_segment,
-                                                                         std::memory_order_relaxed,
-                                                                         std::memory_order_relaxed))
-            {
-                // CAS failed => an other thread creates a segment
-                for (size_type i = 0; i < size_of_the_segment(segment_index); ++i) {
-                    bucket_allocator_traits::destroy(bucket_allocator, buckets_in_segment + i);
-                }
-                bucket_allocator_traits::deallocate(bucket_allocator, buckets_in_segment, size_of_the_segment(segment_index));
+                bucket_allocator_traits::destroy(bucket_allocator, buckets_in_segment + i);
+            }
+            bucket_allocator_traits::deallocate(bucket_allocator, buckets_in_segment, size_of_the_segment(segment_index));
+            return false;
+        }
+        return true;
+    }
+
+    // Allocates the empty buckets from 0 to bc
+    // Not thread-safe
+    void allocate_segments( size_type bc ) {
+        for (size_type i = 0; first_index_in_segment(i) < bc; ++i) {
+            if (my_segment_table[i].load(std::memory_order_relaxed) == nullptr) {
+                create_segment(i, nullptr);
+            }
+        }
+    }
+
+    // Deallocates the segments above the bucket with index bc, the elements in them are destroyed
+    // Not thread-safe
+    void deallocate_segments( size_type bc ) {
+        for (size_type i = index_in_the_table(bc); i < size_of_the_table(); ++i) {
+            auto segment = my_segment_table[i].load(std::memory_order_relaxed);
+            if (segment) {
+                destroy_segment(segment, i);
+                my_segment_table[i].store(nullptr, std::memory_order_relaxed);
             }
         }
     }
 
+    // Sets the bucket count to bc and deallocates the segments above it
+    // Should be called only if the table is empty. Not thread-safe
+    void reset_bucket_count( size_type bc ) {
+        __TOMKV_ASSERT(empty());
+        deallocate_segments(bc);
+        allocate_segments(bc);
+        my_bucket_count.store(bc, std::memory_order_relaxed);
+    }
+
     // Not thread-safe
     void destroy_segment( bucket* bucket_ptr, size_type segment_index ) {
         bucket_allocator_type bucket_allocator{my_allocator};
@@ -397,8 +837,9 @@ private:
         bucket_allocator_traits::deallocate(bucket_allocator, bucket_ptr, size_of_the_segment(segment_index));
     }
 
+    // The bucket becomes rehashed and empty
     void clear_bucket( bucket* bucket_ptr ) {
-        node* curr = bucket_ptr->load_list();
+        node* curr = bucket_ptr->is_rehash_required() ? nullptr : bucket_ptr->load_list();
 
         while(curr) {
             node* n = curr;
@@ -409,12 +850,19 @@ private:
         bucket_ptr->store_list(nullptr);
     }
 
+    // The key equality predicate is called only for the nodes with the same hash code
+    template <typename K>
+    bool is_equal( const node* n, const K& key, size_type hashcode ) const {
+        return n->hash() == hashcode && my_equality(key, n->key());
+    }
+
     // Returns a pair where the first node is a node with equal key
     // the second node is the head of the bucket as a stop point in case we will need to search again
-    std::pair<node*, node*> search_again( const key_type& key, bucket* b, node* stop_point ) {
+    template <typename K>
+    std::pair<node*, node*> search_again( const K& key, size_type hashcode, bucket* b, node* stop_point ) {
         node* head = b->load_list();
         node* node = head;
-        while(node != stop_point && !my_equality(key, node->key())) {
+        while(node != stop_point && !is_equal(node, key, hashcode)) {
             node = node->next();
         }
         return node == stop_point ? std::pair{nullptr, head} : std::pair{node, head};
@@ -422,107 +870,227 @@ private:
 
     // Returns a pair where the first node is a node with equal key
     // the second node is the head of the bucket as a stop point in case we will need to search again
-    std::pair<node*, node*> search( const key_type& k, bucket* b ) {
+    template <typename K>
+    std::pair<node*, node*> search( const K& k, size_type hashcode, bucket* b ) {
         // Search with nullptr as a stop point
-        return search_again(k, b, nullptr);
+        return search_again(k, hashcode, b, nullptr);
     }
 
-    // Should be executed if all buckets from 0 to current_bucket_count are locked
-    void internal_rehash( size_type current_bucket_count ) {
-        size_type new_bucket_count = current_bucket_count * 2;
-        std::vector<node*> bucket_lists(current_bucket_count);
+    // Returns the bucket with bucket_index, moving its elements from the parent bucket if necessary
+    bucket* get_rehashed_bucket( size_type bucket_index ) {
+        bucket* b = get_bucket(bucket_index);
+        if (b->is_rehash_required()) {
+            rehash_bucket(bucket_index);
+        }
+        return b;
+    }
 
-        // Clear all of the buckets
-        for (size_type i = 0; i < current_bucket_count; ++i) {
-            bucket* b = get_bucket(i);
-            bucket_lists[i] = b->load_list();
-            b->store_list(nullptr);
+    // Moves the elements of the bucket with bucket_index from its parent bucket
+    // Should be executed without any locks held
+    void rehash_bucket( size_type bucket_index ) {
+        // The parent bucket index is the bucket index without the most significant bit
+        size_type parent_mask = (size_type(1) << utils::log2(bucket_index)) - 1;
+        size_type parent_index = bucket_index & parent_mask;
+        bucket* parent = get_rehashed_bucket(parent_index);
+        bucket* b = get_bucket(bucket_index);
+
+        lock_type& bucket_lock = get_lock(b, bucket_index);
+        lock_type& parent_lock = get_lock(parent, parent_index);
+
+        // Both buckets may be guarded by the same stripe
+        // Otherwise the locks are always acquired in the order of their addresses
+        lock_type* first = &bucket_lock;
+        lock_type* second = &parent_lock;
+        if (std::less<lock_type*>{}(second, first)) {
+            std::swap(first, second);
         }
 
-        // Calculate new bucket indices for all elements in old bucket lists
-        for (node* node_list : bucket_lists) {
-            node* n = node_list;
-            while(n != nullptr) {
-                node* next = n->next();
-                size_type new_bucket_index = my_hasher(n->key()) % new_bucket_count;
-                bucket* new_bucket = get_bucket(new_bucket_index);
-                bool inserted = new_bucket->try_insert(new_bucket->load_list(), n);
-                __TOMKV_ASSERT(inserted);
-                utils::suppress_unused(inserted);
-                n = next;
+        write_lock_type first_lock = acquire_lock<write_lock_type>(*first);
+        write_lock_type second_lock;
+        if (first != second) {
+            second_lock = acquire_lock<write_lock_type>(*second);
+        }
+
+        if (!b->is_rehash_required()) {
+            // An other thread rehashed the bucket
+            return;
+        }
+
+        auto start = this->start_timer();
+
+        size_type mask = (parent_mask << 1) | 1;
+        node* list = nullptr;
+        node* prev = nullptr;
+        node* curr = parent->load_list();
+
+        while(curr != nullptr) {
+            node* next = curr->next();
+            if ((curr->hash() & mask) == bucket_index) {
+                // Exclude the node from the parent list
+                if (prev) {
+                    prev->set_next(next);
+                } else {
+                    parent->store_list(next);
+                }
+                curr->set_next(list);
+                list = curr;
+            } else {
+                prev = curr;
             }
+            curr = next;
+        }
+        b->store_list(list);
+        this->record_split(start);
+    }
+
+    // Doubles the number of buckets, if it is still equal to current_bucket_count
+    // Elements are moved to the new buckets lazily, by the first access to each of them
+    // Returns the current number of buckets
+    size_type double_bucket_count( size_type current_bucket_count ) {
+        auto start = this->start_timer();
+        size_type segment_index = index_in_the_table(current_bucket_count);
+        // Acquire is required to publish the buckets created by the other thread
+        if (my_segment_table[segment_index].load(std::memory_order_acquire) == nullptr) {
+            create_segment(segment_index, rehash_required());
         }
 
-        // All buckets are filled
-        my_bucket_count.store(new_bucket_count, std::memory_order_release);
+        // The number of buckets is only increased, even if several threads grow the table at once
+        if (my_bucket_count.compare_exchange_strong(current_bucket_count, current_bucket_count * 2,
+                                                    std::memory_order_release, std::memory_order_acquire))
+        {
+            this->record_growth(start);
+            return current_bucket_count * 2;
+        }
+        return current_bucket_count;
     }
 
-    void rehash_if_necessary() {
-        size_type current_bucket_count = my_bucket_count.load(std::memory_order_relaxed);
+    // The per-thread counters are summed up only when the counter of the current thread
+    // reaches the multiple of the interval, which is proportional to the number of buckets
+    bool is_size_check_required( size_type slot_value, size_type current_bucket_count ) const {
+        size_type interval = std::max(current_bucket_count / (size_check_ratio * my_size.slot_count()), size_type(1));
+        return (slot_value & (interval - 1)) == 0;
+    }
 
-        if (my_rehash_required_flag.load(std::memory_order_acquire)) {
-            std::vector<typename bucket::write_lock_type> locks(current_bucket_count);
+    size_type refresh_approximate_size() {
+        size_type current_size = my_size.load();
+        my_approximate_size.store(current_size, std::memory_order_relaxed);
+        return current_size;
+    }
 
-            for (size_type i = 0; i < current_bucket_count; ++i) {
-                locks[i] = typename bucket::write_lock_type{get_bucket(i)->mutex()};
-            }
+    // Allocates the next levels of buckets if the load factor is exceeded
+    // slot_value is the value of the size counter of the current thread after the insertion
+    void grow_if_necessary( size_type slot_value ) {
+        size_type current_bucket_count = my_bucket_count.load(std::memory_order_acquire);
+        if (!is_size_check_required(slot_value, current_bucket_count)) {
+            return;
+        }
 
-            // All buckets are locked for write
-            // Test if rehashing is still required
-            if (my_rehash_required_flag.load(std::memory_order_acquire) &&
-                my_bucket_count.load(std::memory_order_relaxed) == current_bucket_count) {
-                // Rehash is still required
-                internal_rehash(current_bucket_count);
-                // Rehashing done
-                my_rehash_required_flag.store(false, std::memory_order_release);
-            }
+        size_type current_size = refresh_approximate_size();
+        while (double(current_size) / double(current_bucket_count) > double(max_load_factor())) {
+            current_bucket_count = double_bucket_count(current_bucket_count);
         }
     }
 
-    void mark_rehash_required_if_necessary( size_type current_size, size_type current_bucket_count ) {
-        if (float(current_size) / float(current_bucket_count) > max_load_factor) {
-            my_rehash_required_flag.store(true, std::memory_order_release);
+    // slot_value is the value of the size counter of the current thread after the erasure
+    void update_approximate_size( size_type slot_value ) {
+        if (is_size_check_required(slot_value, bucket_count())) {
+            refresh_approximate_size();
         }
     }
 
-    template <typename Accessor, typename... Args>
-    bool internal_emplace( Accessor& accessor, Args&&... args ) {
-        accessor.release();
-
-        rehash_if_necessary();
+    // Allocates the levels of buckets until there are at least bc buckets
+    void grow_bucket_count( size_type bc ) {
+        size_type current_bucket_count = my_bucket_count.load(std::memory_order_acquire);
 
-        node* new_node = create_node(std::forward<Args>(args)...);
-        size_type hashcode = my_hasher(new_node->key());
+        while (current_bucket_count < bc) {
+            current_bucket_count = double_bucket_count(current_bucket_count);
+        }
+    }
 
-        bucket* b = nullptr;
-        size_type bc = my_bucket_count.load(std::memory_order_relaxed);
+    // Locks the bucket which should contain the element with hashcode and assigns it to the accessor
+    template <typename Accessor>
+    bucket* acquire_bucket( Accessor& accessor, size_type hashcode, node* n ) {
+        size_type bc = my_bucket_count.load(std::memory_order_acquire);
 
         while(true) {
             size_type prev_bc = bc;
-            size_type bucket_index = hashcode % bc;
-            b = get_bucket(bucket_index);
-            accessor.assign(b->mutex(), new_node);
+            size_type bucket_index = hashcode & (bc - 1);
+            bucket* b = get_rehashed_bucket(bucket_index);
+            accessor.assign(acquire_lock<typename Accessor::lock_holder_type>(get_lock(b, bucket_index)), b, n);
             // Lock is acquired
-            bc = my_bucket_count.load(std::memory_order_relaxed);
-            if (bc == prev_bc || hashcode % bc == bucket_index) {
-                // Either no rehashing happened while acquiring the lock
-                // or rehashing happened, but our new bucket is the same as an old one
-                break;
-            } else {
-                // Rehashing happened while acquiring the lock
-                // And current thread need to acquire an other bucket
-                accessor.release(); // Release the lock
+            bc = my_bucket_count.load(std::memory_order_acquire);
+            if (bc == prev_bc || (hashcode & (bc - 1)) == bucket_index) {
+                // Either the table did not grow while acquiring the lock
+                // or it grew, but our new bucket is the same as an old one
+                return b;
             }
+            // The table grew while acquiring the lock
+            // And current thread need to acquire an other bucket
+            accessor.release(); // Release the lock
+        }
+    }
+
+    // Detects the arguments of emplace which contain the key, so the bucket can be searched before the construction
+    template <typename... Args>
+    struct is_key_and_mapped : std::false_type {};
+
+    template <typename K, typename M>
+    struct is_key_and_mapped<K, M> : std::is_same<std::remove_cv_t<std::remove_reference_t<K>>, key_type> {};
+
+    template <typename... Args>
+    struct is_pair_with_key : std::false_type {};
+
+    template <typename K, typename M>
+    struct is_pair_with_key<std::pair<K, M>> : std::is_same<std::remove_cv_t<K>, key_type> {};
+
+    template <typename Accessor, typename... Args>
+    bool internal_emplace( Accessor& accessor, Args&&... args ) {
+        if constexpr (is_key_and_mapped<Args...>::value) {
+            // emplace(key, mapped)
+            return internal_try_emplace(accessor, std::forward<Args>(args)...);
+        } else if constexpr (is_pair_with_key<std::remove_cv_t<std::remove_reference_t<Args>>...>::value) {
+            // emplace(pair)
+            return internal_emplace_pair(accessor, std::forward<Args>(args)...);
+        } else {
+            return internal_emplace_node(accessor, std::forward<Args>(args)...);
+        }
+    }
+
+    template <typename Accessor, typename Pair>
+    bool internal_emplace_pair( Accessor& accessor, Pair&& p ) {
+        return internal_try_emplace(accessor, std::get<0>(std::forward<Pair>(p)), std::get<1>(std::forward<Pair>(p)));
+    }
+
+    // The node is constructed before the search, since the key cannot be extracted from args
+    template <typename Accessor, typename... Args>
+    bool internal_emplace_node( Accessor& accessor, Args&&... args ) {
+        accessor.release();
+
+        node* new_node = create_node(std::forward<Args>(args)...);
+        new_node->set_hash(my_hasher(new_node->key()));
+
+        if (insert_node(accessor, new_node)) {
+            grow_if_necessary(my_size.add(1));
+            return true;
         }
+        return false;
+    }
+
+    // Inserts the node with the computed hash code or destroys it if an element with equal key exists
+    // The size of the table is updated by the caller
+    template <typename Accessor>
+    bool insert_node( Accessor& accessor, node* new_node ) {
+        size_type hashcode = new_node->hash();
+        bucket* b = acquire_bucket(accessor, hashcode, new_node);
 
         // Lock scope
 
         // Seach an element with equal key in the bucket
-        auto nodes = search(new_node->key(), b);
+        auto nodes = search(new_node->key(), hashcode, b);
 
         if (nodes.first) {
             // An element with equal key already exists
-            accessor.assign(nodes.second); // Re-assign the node in the accessor
+            accessor.assign(nodes.first); // Re-assign the node in the accessor
             destroy_node(new_node);
             return false;
         }
@@ -531,7 +1099,7 @@ private:
         while(!nodes.first && !b->try_insert(nodes.second, new_node)) {
             // If the insertion fails - check once again
             // It is possible that an other thread already inserted an element with equal key
-            nodes = search_again(new_node->key(), b, nodes.second);
+            nodes = search_again(new_node->key(), hashcode, b, nodes.second);
         }
 
         if (nodes.first) {
@@ -541,45 +1109,188 @@ private:
             return false;
         }
         // We have successfully inserted the node
-        size_type sz = my_size.fetch_add(1, std::memory_order_relaxed);
-
-        mark_rehash_required_if_necessary(sz + 1, bc);
         return true;
     }
 
-    template <typename Accessor>
-    bool internal_find( Accessor& accessor, const key_type& key ) {
+    template <typename Accessor, typename K, typename... Args>
+    bool internal_try_emplace( Accessor& accessor, K&& key, Args&&... args ) {
         accessor.release();
 
-        rehash_if_necessary();
-
         size_type hashcode = my_hasher(key);
-        bucket* b = nullptr;
+        bucket* b = acquire_bucket(accessor, hashcode, nullptr);
 
-        size_type bc = my_bucket_count.load(std::memory_order_relaxed);
+        // Lock scope
+        auto nodes = search(key, hashcode, b);
+        if (nodes.first) {
+            accessor.assign(nodes.first);
+            return false;
+        }
 
-        while(true) {
-            size_type prev_bc = bc;
-            size_type bucket_index = hashcode % bc;
-            b = get_bucket(bucket_index);
-            accessor.assign(b->mutex(), nullptr);
-            // Lock is acquired
-            bc = my_bucket_count.load(std::memory_order_relaxed);
-            if (bc == prev_bc || hashcode % bc == bucket_index) {
-                // Either no rehashing happened while acquiring the lock
-                // or rehashing happened, but our new bucket is the same as an old one
-                break;
-            } else {
-                // Rehashing happened while acquirng the lock
-                // And current thread need to acquire an other bucket
-                accessor.release(); // Release the lock
+        // The key is converted to key_type only for the insertion
+        node* new_node = create_node(std::piecewise_construct,
+                                     std::forward_as_tuple(std::forward<K>(key)),
+                                     std::forward_as_tuple(std::forward<Args>(args)...));
+        new_node->set_hash(hashcode);
+
+        while(!nodes.first && !b->try_insert(nodes.second, new_node)) {
+            // An other thread may insert an element with equal key under the read lock
+            nodes = search_again(new_node->key(), hashcode, b, nodes.second);
+        }
+
+        if (nodes.first) {
+            accessor.assign(nodes.first);
+            destroy_node(new_node);
+            return false;
+        }
+
+        accessor.assign(new_node);
+        grow_if_necessary(my_size.add(1));
+        return true;
+    }
+
+    template <typename K, typename M>
+    bool internal_insert_or_assign( K&& key, M&& obj ) {
+        write_accessor accessor;
+        if (internal_try_emplace(accessor, std::forward<K>(key), std::forward<M>(obj))) {
+            return true;
+        }
+        // obj is not moved from if the element exists
+        accessor.mapped() = std::forward<M>(obj);
+        return false;
+    }
+
+    template <typename K, typename Function>
+    bool internal_compute( K&& key, const Function& fn ) {
+        write_accessor accessor;
+        bool inserted = internal_try_emplace(accessor, std::forward<K>(key));
+        fn(accessor.mapped());
+        return inserted;
+    }
+
+    template <typename K, typename Predicate, typename Function>
+    bool internal_update_if( const K& key, const Predicate& pred, const Function& fn ) {
+        write_accessor accessor;
+        if (internal_find(accessor, key) && pred(std::as_const(accessor.mapped()))) {
+            fn(accessor.mapped());
+            return true;
+        }
+        return false;
+    }
+
+    template <typename InputIterator>
+    void internal_insert( InputIterator first, InputIterator last ) {
+        using category = typename std::iterator_traits<InputIterator>::iterator_category;
+        if constexpr (std::is_base_of_v<std::forward_iterator_tag, category>) {
+            reserve(size() + size_type(std::distance(first, last)));
+        }
+
+        for (; first != last; ++first) {
+            emplace(*first);
+        }
+    }
+
+    template <typename InputIterator>
+    void internal_parallel_insert( InputIterator first, InputIterator last, const parallel_policy& policy ) {
+        using category = typename std::iterator_traits<InputIterator>::iterator_category;
+        if constexpr (!std::is_base_of_v<std::random_access_iterator_tag, category>) {
+            utils::suppress_unused(policy);
+            internal_insert(first, last);
+        } else {
+            size_type n = size_type(last - first);
+            size_type num_chunks = std::min(policy.concurrency(), n / min_parallel_chunk_size);
+
+            if (num_chunks <= 1) {
+                internal_insert(first, last);
+                return;
+            }
+
+            // The table does not grow during the insertion
+            reserve(size() + n);
+
+            // Buckets of different partitions never share a lock, since the bucket index
+            // and the stripe index are both taken from the lower bits of the hash code
+            size_type num_partitions = std::min(round_up_bucket_count(partitions_per_thread * num_chunks), bucket_count());
+            if constexpr (is_striped) {
+                num_partitions = std::min(num_partitions, my_stripe_count);
             }
+
+            // Nodes of each chunk of the input are linked into the list per partition in the input order
+            std::vector<node*> heads(num_chunks * num_partitions, nullptr);
+
+            // Nodes which were not inserted are destroyed if an exception is thrown
+            utils::raii_guard guard([&] {
+                for (node* n : heads) {
+                    while (n != nullptr) {
+                        node* next = n->next();
+                        destroy_node(n);
+                        n = next;
+                    }
+                }
+            });
+
+            parallel_for(num_chunks, policy, [&]( size_type chunk_index ) {
+                node** chunk_heads = heads.data() + chunk_index * num_partitions;
+                std::vector<node*> tails(num_partitions, nullptr);
+
+                using difference_type = typename std::iterator_traits<InputIterator>::difference_type;
+                InputIterator it = first + difference_type(n * chunk_index / num_chunks);
+                InputIterator chunk_last = first + difference_type(n * (chunk_index + 1) / num_chunks);
+
+                for (; it != chunk_last; ++it) {
+                    node* new_node = create_node(*it);
+                    utils::raii_guard node_guard([&] { destroy_node(new_node); });
+                    size_type hashcode = my_hasher(new_node->key());
+                    node_guard.release();
+
+                    new_node->set_hash(hashcode);
+                    size_type partition_index = hashcode & (num_partitions - 1);
+                    if (tails[partition_index] == nullptr) {
+                        chunk_heads[partition_index] = new_node;
+                    } else {
+                        tails[partition_index]->set_next(new_node);
+                    }
+                    tails[partition_index] = new_node;
+                }
+            });
+
+            parallel_for(num_partitions, policy, [&]( size_type partition_index ) {
+                size_type inserted = 0;
+                // The size is updated once per partition
+                utils::raii_guard size_guard([&] { my_size.add(inserted); });
+
+                // Chunks are processed in the input order, so the first of the equal keys is inserted
+                for (size_type chunk_index = 0; chunk_index < num_chunks; ++chunk_index) {
+                    node*& head = heads[chunk_index * num_partitions + partition_index];
+                    while (head != nullptr) {
+                        node* next = head->next();
+                        write_accessor accessor;
+                        if (insert_node(accessor, head)) {
+                            ++inserted;
+                        }
+                        head = next;
+                    }
+                }
+            });
+            guard.release();
+            refresh_approximate_size();
         }
+    }
+
+    template <typename Accessor, typename K>
+    bool internal_find( Accessor& accessor, const K& key ) {
+        return internal_find(accessor, key, my_hasher(key));
+    }
+
+    template <typename Accessor, typename K>
+    bool internal_find( Accessor& accessor, const K& key, size_type hashcode ) {
+        accessor.release();
+
+        bucket* b = acquire_bucket(accessor, hashcode, nullptr);
 
         // Lock scope
 
         // Search the bucket to find an element with equal key
-        node* n = search(key, b).first;
+        node* n = search(key, hashcode, b).first;
         if (n) {
             // Element found
             accessor.assign(n);
@@ -591,11 +1302,137 @@ private:
         return false;
     }
 
-    void internal_erase( write_accessor& accessor ) {
-        size_type hashcode = my_hasher(accessor.key());
+    // Searches the element without locks and copies its mapped object
+    // Returns false if the bucket was modified during the search and the result is not valid
+    template <typename K>
+    bool optimistic_find_copy( const K& key, size_type hashcode, std::optional<mapped_type>& result ) {
+        static_assert(std::is_trivially_copyable_v<mapped_type>);
+        typename epoch_domain::guard guard{my_epoch_domain};
+
+        size_type bc = my_bucket_count.load(std::memory_order_acquire);
+        size_type bucket_index = hashcode & (bc - 1);
+        bucket* b = get_bucket(bucket_index);
+
+        lock_type& lock = get_lock(b, bucket_index);
+        typename lock_type::version_type version;
+        if (!lock.begin_read(version) || b->is_rehash_required()) {
+            return false;
+        }
+
+        // The mapped object may be modified concurrently, it is copied as bytes and validated after
+        alignas(mapped_type) unsigned char buffer[sizeof(mapped_type)];
+        bool found = false;
 
-        size_type bc = my_bucket_count.load(std::memory_order_relaxed);
-        bucket* b = get_bucket(hashcode % bc);
+        for (node* n = b->load_list(); n != nullptr; n = n->next()) {
+            if (is_equal(n, key, hashcode)) {
+                std::memcpy(buffer, &n->mapped(), sizeof(mapped_type));
+                found = true;
+                break;
+            }
+        }
+
+        if (!lock.validate_read(version)) {
+            return false;
+        }
+
+        size_type current_bc = my_bucket_count.load(std::memory_order_acquire);
+        if (current_bc != bc && (hashcode & (current_bc - 1)) != bucket_index) {
+            // The element may be moved to the other bucket
+            return false;
+        }
+
+        if (found) {
+            result.emplace(*std::launder(reinterpret_cast<mapped_type*>(buffer)));
+        }
+        return true;
+    }
+
+    template <typename K>
+    std::optional<mapped_type> internal_find_copy( const K& key ) {
+        return internal_find_copy(key, my_hasher(key));
+    }
+
+    template <typename K>
+    std::optional<mapped_type> internal_find_copy( const K& key, size_type hashcode ) {
+        std::optional<mapped_type> result;
+
+        if constexpr (std::is_trivially_copyable_v<mapped_type>) {
+            for (std::size_t attempt = 0; attempt < optimistic_find_attempts; ++attempt) {
+                if (optimistic_find_copy(key, hashcode, result)) {
+                    return result;
+                }
+            }
+        }
+
+        // Copying of the object cannot be validated or the bucket is modified too often
+        read_accessor racc;
+        if (internal_find(racc, key, hashcode)) {
+            result.emplace(racc.mapped());
+        }
+        return result;
+    }
+
+    // The lookups are pipelined: while the key i is resolved, the head node for the key i + find_prefetch_distance
+    // and the bucket for the key i + 2 * find_prefetch_distance are prefetched
+    // The elements are copied as by find_copy
+    template <typename KeyIterator, typename OutputIterator>
+    size_type internal_find_many( KeyIterator first, KeyIterator last, OutputIterator out ) {
+        struct find_request {
+            KeyIterator key;
+            size_type hashcode;
+            bucket* b;
+        }; // struct find_request
+
+        // The requests in flight are stored in the ring buffer
+        constexpr size_type ring_size = 4 * find_prefetch_distance;
+        static_assert(ring_size > 2 * find_prefetch_distance);
+        find_request requests[ring_size];
+
+        size_type found = 0;
+        size_type issued = 0;
+
+        // At the step i, the request i is issued, the request i - find_prefetch_distance
+        // and the request i - 2 * find_prefetch_distance are resolved
+        for (size_type i = 0; ; ++i) {
+            if (first != last) {
+                // Compute the hash code and prefetch the bucket
+                find_request& request = requests[i % ring_size];
+                request.key = first;
+                request.hashcode = my_hasher(*first);
+                size_type bc = my_bucket_count.load(std::memory_order_acquire);
+                request.b = get_bucket(request.hashcode & (bc - 1));
+                utils::prefetch(request.b);
+                ++first;
+                ++issued;
+            }
+
+            if (i >= find_prefetch_distance && i - find_prefetch_distance < issued) {
+                // The bucket is expected to be in the cache, prefetch its head node
+                node* head = requests[(i - find_prefetch_distance) % ring_size].b->load_list();
+                if (head != nullptr && head != rehash_required()) {
+                    utils::prefetch(head);
+                }
+            }
+
+            if (i >= 2 * find_prefetch_distance) {
+                if (i - 2 * find_prefetch_distance == issued) {
+                    // All of the requests are resolved
+                    break;
+                }
+                // The element may be moved to the other bucket since the prefetch, so the search is started from scratch
+                find_request& request = requests[(i - 2 * find_prefetch_distance) % ring_size];
+                std::optional<mapped_type> result = internal_find_copy(*request.key, request.hashcode);
+                found += result.has_value();
+                *out = std::move(result);
+                ++out;
+            }
+        }
+        return found;
+    }
+
+    void internal_erase( write_accessor& accessor ) {
+        // Elements are never moved out of the bucket locked for write
+        bucket* b = accessor.get_bucket();
 
         // Lock scope
         node* prev = nullptr;
@@ -614,38 +1451,17 @@ private:
             // Excluting node is the head of the list
             b->store_list(curr->next());
         }
-        my_size.fetch_sub(1, std::memory_order_relaxed);
-        destroy_node(curr);
+        update_approximate_size(my_size.sub(1));
+        retire_node(curr);
         accessor.release();
     }
 
-    bool internal_erase( const key_type& key ) {
-
-        rehash_if_necessary();
-
+    template <typename K>
+    bool internal_erase( const K& key ) {
         size_type hashcode = my_hasher(key);
         write_accessor accessor;
 
-        size_type bc = my_bucket_count.load(std::memory_order_relaxed);
-        bucket* b = nullptr;
-
-        while(true) {
-            size_type prev_bc = bc;
-            size_type bucket_index = hashcode % bc;
-            b = get_bucket(bucket_index);
-            accessor.assign(b->mutex(), nullptr);
-            // Lock is acquired
-            bc = my_bucket_count.load(std::memory_order_relaxed);
-            if (bc == prev_bc || hashcode % bc == bucket_index) {
-                // Either no rehashing happened while acquiring the lock
-                // or rehashing happened, but our new bucket is the same as an old one
-                break;
-            } else {
-                // Rehashing happened while acquirng the lock
-                // And current thread need to acquire an other bucket
-                accessor.release(); // Release the lock
-            }
-        }
+        bucket* b = acquire_bucket(accessor, hashcode, nullptr);
 
         // Lock scope
 
@@ -653,7 +1469,7 @@ private:
         node* curr = b->load_list(); // Head of the bucket
 
         // Find previous and current node in the list
-        while(curr != nullptr && !my_equality(key, curr->key())) {
+        while(curr != nullptr && !is_equal(curr, key, hashcode)) {
             prev = curr;
             curr = curr->next();
         }
@@ -667,29 +1483,211 @@ private:
                 // Excluting node is the head of the list
                 b->store_list(curr->next());
             }
-            my_size.fetch_sub(1, std::memory_order_relaxed);
-            destroy_node(curr);
+            update_approximate_size(my_size.sub(1));
+            retire_node(curr);
             return true;
         }
         return false;
     }
 
-    // Not thread-safe
+    // Applies pred to the elements of the group of buckets with group_index at the level
+    // All of the buckets of the group are locked at once, so the elements cannot be moved
+    // between them during the traversal
     template <typename Predicate>
-    void internal_for_each( const Predicate& pred ) {
-        __TOMKV_ASSERT(false);
-        size_type bc = my_bucket_count.load(std::memory_order_relaxed);
+    void traverse_group( size_type group_index, size_type level, std::vector<lock_type*>& locks, const Predicate& pred ) {
+        // Elements of the first bucket of the group may be still stored in the parent from the other group
+        get_rehashed_bucket(group_index);
 
-        for (size_type bucket_index = 0; bucket_index < bc; ++bucket_index) {
+        size_type bc = my_bucket_count.load(std::memory_order_acquire);
+        while(true) {
+            locks.clear();
+            for (size_type bucket_index = group_index; bucket_index < bc; bucket_index += level) {
+                locks.push_back(&get_lock(get_bucket(bucket_index), bucket_index));
+            }
+
+            // Locks are acquired in the order of their addresses, the stripes may be shared by the buckets
+            std::sort(locks.begin(), locks.end(), std::less<lock_type*>{});
+            locks.erase(std::unique(locks.begin(), locks.end()), locks.end());
+            for (lock_type* l : locks) {
+                // The ownership is released from the holder, the lock is unlocked below by hand
+                // acquire_lock records the waiting time as for the other operations
+                acquire_lock<write_lock_type>(*l).release();
+            }
+
+            size_type current_bc = my_bucket_count.load(std::memory_order_acquire);
+            if (current_bc == bc) {
+                break;
+            }
+            // The table grew while acquiring the locks, the new buckets of the group should be locked as well
+            for (lock_type* l : locks) {
+                l->unlock();
+            }
+            bc = current_bc;
+        }
+
+        // The locks are released even if pred throws
+        utils::raii_guard guard([&] {
+            for (lock_type* l : locks) {
+                l->unlock();
+            }
+        });
+
+        for (size_type bucket_index = group_index; bucket_index < bc; bucket_index += level) {
+            bucket* b = get_bucket(bucket_index);
+            // Elements of the bucket which is not rehashed are visited in the parent bucket
+            node* n = b->is_rehash_required() ? nullptr : b->load_list();
+
+            while(n != nullptr) {
+                // The first bucket of the group may contain the elements of the other groups
+                if ((n->hash() & (level - 1)) == group_index) {
+                    pred(n->value());
+                }
+                n = n->next();
+            }
+        }
+    }
+
+    hash_table_statistics internal_stats() {
+        hash_table_statistics result{};
+        result.size = size();
+        result.bucket_count = bucket_count();
+        result.load_factor = float(result.size) / float(result.bucket_count);
+        result.max_load_factor = max_load_factor();
+
+        // The buckets created by the concurrent growth are not visited
+        for (size_type bucket_index = 0; bucket_index < result.bucket_count; ++bucket_index) {
             bucket* b = get_bucket(bucket_index);
+            read_lock_type lock{get_lock(b, bucket_index)};
+            if (b->is_rehash_required()) {
+                ++result.unsplit_buckets;
+                continue;
+            }
+
+            size_type length = 0;
+            for (node* n = b->load_list(); n != nullptr; n = n->next()) {
+                ++length;
+            }
+            if (length >= result.chain_lengths.size()) {
+                result.chain_lengths.resize(length + 1);
+            }
+            ++result.chain_lengths[length];
+            result.max_chain_length = std::max(result.max_chain_length, length);
+        }
+
+        this->load_events(result);
+        return result;
+    }
+
+    void internal_save_snapshot( const std::string& path ) {
+        using key_traits = snapshot_traits<key_type>;
+        using mapped_traits = snapshot_traits<mapped_type>;
+        using record_iterator = snapshot_record_iterator<key_type, mapped_type>;
+
+        snapshot_header header{};
+        std::memcpy(header.magic, snapshot_header::expected_magic, sizeof(header.magic));
+        header.version = snapshot_header::current_version;
+        header.fixed_size = record_iterator::is_fixed_size;
+        header.key_size = sizeof(key_type);
+        header.mapped_size = sizeof(mapped_type);
+        header.element_count = 0;
+
+        std::string temporary_path = path + ".tmp";
+        // The incomplete snapshot is removed if an exception is thrown
+        utils::raii_guard remove_guard([&] { std::remove(temporary_path.c_str()); });
+        {
+            snapshot_writer writer(temporary_path);
+            writer.write(&header, sizeof(header));
+
+            std::string buffer;
+            std::vector<lock_type*> locks;
+            // Each group is copied under its locks, as by for_each
+            size_type level = bucket_count();
+            for (size_type group_index = 0; group_index < level; ++group_index) {
+                traverse_group(group_index, level, locks, [&]( const value_type& value ) {
+                    key_traits::save(buffer, value.first);
+                    mapped_traits::save(buffer, value.second);
+                    ++header.element_count;
+                });
+
+                if (buffer.size() >= snapshot_buffer_size) {
+                    writer.write(buffer.data(), buffer.size());
+                    buffer.clear();
+                }
+            }
+            writer.write(buffer.data(), buffer.size());
+
+            // The number of elements is known only after the traversal
+            writer.write_at(0, &header, sizeof(header));
+            writer.close();
+        }
+
+        if (std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+            throw snapshot_error("Cannot replace the snapshot file: " + path);
+        }
+        remove_guard.release();
+    }
+
+    void internal_load_snapshot( const std::string& path, const parallel_policy& policy ) {
+        using record_iterator = snapshot_record_iterator<key_type, mapped_type>;
+
+        snapshot_reader reader(path);
+        snapshot_header header;
+        if (reader.size() < sizeof(header)) {
+            throw snapshot_error("The snapshot file is truncated: " + path);
+        }
+        std::memcpy(&header, reader.data(), sizeof(header));
+
+        if (std::memcmp(header.magic, snapshot_header::expected_magic, sizeof(header.magic)) != 0 ||
+            header.version != snapshot_header::current_version)
+        {
+            throw snapshot_error("The file is not a snapshot of the supported version: " + path);
+        }
+        if (header.fixed_size != record_iterator::is_fixed_size || header.key_size != sizeof(key_type) ||
+            header.mapped_size != sizeof(mapped_type))
+        {
+            throw snapshot_error("The snapshot was saved for the other key or mapped type: " + path);
+        }
 
-            node* node = b->load_list();
+        const char* records = reader.data() + sizeof(header);
+        size_type count = size_type(header.element_count);
+        std::vector<std::size_t> offsets;
+        record_iterator::validate(records, reader.data() + reader.size(), count, offsets);
 
-            while(node != nullptr) {
-                pred(node->value());
-                node = node->next();
+        // The records are parsed directly from the mapped file by the inserting threads
+        internal_parallel_insert(record_iterator(records, offsets.data(), 0),
+                                 record_iterator(records, offsets.data(), count), policy);
+    }
+
+    // Not thread-safe
+    void internal_shrink_to_fit() {
+        size_type bc = bucket_count();
+        size_type new_bc = round_up_bucket_count(std::max(size_type(std::ceil(double(size()) / double(max_load_factor()))),
+                                                          init_bucket_count));
+        if (new_bc >= bc) {
+            return;
+        }
+
+        // The buckets which remain should not refer to the parent bucket
+        for (size_type i = 0; i < new_bc; ++i) {
+            get_rehashed_bucket(i);
+        }
+
+        // Elements which are not moved from the parent bucket are already stored in the remaining buckets
+        for (size_type i = new_bc; i < bc; ++i) {
+            bucket* b = get_bucket(i);
+            node* n = b->is_rehash_required() ? nullptr : b->load_list();
+
+            while(n != nullptr) {
+                node* next = n->next();
+                get_bucket(n->hash() & (new_bc - 1))->relaxed_insert(n);
+                n = next;
             }
+            b->store_list(nullptr);
         }
+
+        // Segments above new_bc are empty now
+        deallocate_segments(new_bc);
+        my_bucket_count.store(new_bc, std::memory_order_relaxed);
     }
 
     // Not thread-safe
@@ -698,29 +1696,48 @@ private:
             bucket* b = get_bucket(i);
             clear_bucket(b);
         }
-        my_size.store(0, std::memory_order_relaxed);
+        my_size.store(0);
+        my_approximate_size.store(0, std::memory_order_relaxed);
     }
 
 protected:
-    size_type bucket_count() const { return my_bucket_count.load(std::memory_order_relaxed); }
-
     template <bool Move, typename HashTable>
     void internal_move_or_copy( HashTable&& other ) {
         utils::raii_guard guard([&]{ clear(); });
 
-        // my_bucket_count should be copied
-        __TOMKV_ASSERT(bucket_count() == other.bucket_count());
-        my_size.store(other.my_size.load(std::memory_order_relaxed), std::memory_order_relaxed);
-        // TODO: add rehashing on copying/moving
-        my_rehash_required_flag.store(other.my_rehash_required_flag.load(std::memory_order_relaxed),
-                                      std::memory_order_relaxed);
+        my_max_load_factor.store(other.max_load_factor(), std::memory_order_relaxed);
+        reset_bucket_count(other.bucket_count());
 
-        for (size_type i = 0; i < bucket_count(); ++i) {
-            bucket* current_bucket = get_bucket(i);
-            bucket* other_bucket = other.get_bucket(i);
+        // Large tables are copied by several threads, each thread copies its own groups of buckets
+        parallel_policy policy;
+        size_type num_threads = std::min(policy.concurrency(), other.size() / min_parallel_chunk_size);
+        size_type num_groups = 1;
+        if (num_threads > 1) {
+            policy = parallel_policy(num_threads);
+            num_groups = std::min(round_up_bucket_count(partitions_per_thread * num_threads), bucket_count());
+        }
 
-            node* n = other_bucket->load_list();
-            while(n != nullptr) {
+        parallel_for(num_groups, policy, [&]( size_type group_index ) {
+            move_or_copy_group<Move>(other, group_index, num_groups);
+        });
+        guard.release();
+        refresh_approximate_size();
+    }
+
+    // Copies the elements of other which hash code modulo level is equal to group_index
+    // The elements are placed only into the buckets of the same group, so the groups can be copied in parallel
+    template <bool Move, typename HashTable>
+    void move_or_copy_group( HashTable& other, size_type group_index, size_type level ) {
+        size_type bc = bucket_count();
+        size_type count = 0;
+
+        auto move_or_copy_bucket = [&]( bucket* other_bucket ) {
+            for (node* n = other_bucket->load_list(); n != nullptr; n = n->next()) {
+                // The hasher of this table is a copy of the hasher of other
+                size_type hashcode = n->hash();
+                if ((hashcode & (level - 1)) != group_index) {
+                    continue;
+                }
                 // Create node by copying value
                 node* new_node = nullptr;
                 if constexpr (Move) {
@@ -728,11 +1745,28 @@ protected:
                 } else {
                     new_node = create_node(n->value());
                 }
-                current_bucket->relaxed_insert(new_node);
-                n = n->next();
+                new_node->set_hash(hashcode);
+                // Each element is placed directly into the rehashed bucket
+                get_bucket(hashcode & (bc - 1))->relaxed_insert(new_node);
+                ++count;
+            }
+        };
+
+        // Elements of the first bucket of the group may be still stored in one of its parents
+        size_type first_index = group_index;
+        while (other.get_bucket(first_index)->is_rehash_required()) {
+            first_index &= (size_type(1) << utils::log2(first_index)) - 1;
+        }
+        move_or_copy_bucket(other.get_bucket(first_index));
+
+        // Elements of the other buckets of the group which are not rehashed are stored in the parents from the same group
+        for (size_type i = group_index + level; i < bc; i += level) {
+            bucket* other_bucket = other.get_bucket(i);
+            if (!other_bucket->is_rehash_required()) {
+                move_or_copy_bucket(other_bucket);
             }
         }
-        guard.release();
+        my_size.add(count);
     }
 
     void internal_copy( const hash_table& other ) {
@@ -740,20 +1774,20 @@ protected:
     }
 
     // Stealing move
+    // The buckets of this table are exchanged with the buckets of other
     void internal_move( hash_table&& other ) {
-        // my_bucket_count should be copied
-
-        __TOMKV_ASSERT(bucket_count() == other.bucket_count());
-        my_size.store(other.my_size.load(std::memory_order_relaxed), std::memory_order_relaxed);
-        my_rehash_required_flag.store(other.my_size.load(std::memory_order_relaxed), std::memory_order_relaxed);
-
-        other.my_size.store(0, std::memory_order_relaxed);
-        other.my_rehash_required_flag.store(false, std::memory_order_relaxed);
-
-        for (size_type i = 0; i < bucket_count(); ++i) {
-            my_segment_table[i].store(other.my_segment_table[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
-            other.my_segment_table[i].store(nullptr, std::memory_order_relaxed);
-        }
+        __TOMKV_ASSERT(empty());
+        std::swap(my_segment_table, other.my_segment_table);
+
+        size_type bc = bucket_count();
+        my_bucket_count.store(other.bucket_count(), std::memory_order_relaxed);
+        other.my_bucket_count.store(bc, std::memory_order_relaxed);
+
+        my_size.store(other.my_size.load());
+        other.my_size.store(0);
+        my_approximate_size.store(size(), std::memory_order_relaxed);
+        other.my_approximate_size.store(0, std::memory_order_relaxed);
+        my_max_load_factor.store(other.max_load_factor(), std::memory_order_relaxed);
     }
 
     void internal_move_with_allocator( hash_table&& other, const allocator_type& alloc ) {
@@ -772,8 +1806,6 @@ protected:
     {
         __TOMKV_ASSERT(this != &other);
         clear();
-
-        my_bucket_count.store(other.my_bucket_count.load(std::memory_order_relaxed), std::memory_order_relaxed);
         internal_copy(other);
     }
 
@@ -781,7 +1813,6 @@ protected:
         __TOMKV_ASSERT(this != &other);
         clear();
 
-        my_bucket_count.store(other.my_bucket_count.load(std::memory_order_relaxed), std::memory_order_relaxed);
         if constexpr (allocator_traits_type::propagate_on_container_move_assignment::value ||
                       allocator_traits_type::is_always_equal::value)
         {
@@ -797,13 +1828,21 @@ protected:
     }
 
 private:
+    // Fields read by each operation, which are rarely modified
     allocator_type&        my_allocator;
     hasher&                my_hasher;
     key_equal&             my_equality;
-    std::atomic<size_type> my_bucket_count;
-    std::atomic<size_type> my_size;
-    std::atomic<bool>      my_rehash_required_flag;
+    // Each thread modifies its own counter, the counters are placed on the separate cache lines
+    sharded_counter<allocator_type> my_size;
     segment_type*          my_segment_table;
+    lock_type*             my_stripes;
+    size_type              my_stripe_count;
+    std::atomic<size_type> my_bucket_count;
+    std::atomic<float>     my_max_load_factor;
+
+    // Fields modified by the operations are placed on the separate cache lines
+    alignas(cache_line_size) std::atomic<size_type> my_approximate_size;
+    alignas(cache_line_size) epoch_domain           my_epoch_domain;
 
     friend struct hash_table_auxiliary_accessor;
 }; // class hash_table
@@ -0,0 +1,138 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Konstantin Boyarinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __TOMKV_INCLUDE_INTERNAL_LOCKING_POLICY_HPP
+#define __TOMKV_INCLUDE_INTERNAL_LOCKING_POLICY_HPP
+
+#include "compact_rw_mutex.hpp"
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <algorithm>
+#include <type_traits>
+
+namespace tomkv {
+namespace internal {
+
+// Reader-writer lock with the version which is odd while it is locked for write,
+// so the lock-free readers can validate that the guarded data was not modified during the read
+// Meets the SharedMutex requirements
+class versioned_rw_lock {
+public:
+    using version_type = std::uint32_t;
+
+    versioned_rw_lock() noexcept : my_version(0) {}
+
+    void lock() {
+        my_mutex.lock();
+        my_version.store(my_version.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        // Odd version should be visible before any modification
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    bool try_lock() {
+        if (!my_mutex.try_lock()) {
+            return false;
+        }
+        my_version.store(my_version.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        return true;
+    }
+
+    void unlock() {
+        my_version.store(my_version.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        my_mutex.unlock();
+    }
+
+    void lock_shared() { my_mutex.lock_shared(); }
+    bool try_lock_shared() { return my_mutex.try_lock_shared(); }
+    void unlock_shared() { my_mutex.unlock_shared(); }
+
+    // Returns false if the lock is acquired for write
+    bool begin_read( version_type& version ) const {
+        version = my_version.load(std::memory_order_acquire);
+        return version % 2 == 0;
+    }
+
+    // Returns true if the lock was not acquired for write since begin_read
+    bool validate_read( version_type version ) const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return my_version.load(std::memory_order_relaxed) == version;
+    }
+private:
+    compact_rw_mutex my_mutex;
+    std::atomic<version_type> my_version;
+}; // class versioned_rw_lock
+
+// Locking policies for hash_table
+
+// Each bucket is guarded by its own lock
+struct per_bucket_locking {};
+
+// Bucket i is guarded by the stripe i mod NumStripes
+// If NumStripes is 0, the number of stripes is scaled by the hardware concurrency
+// NumStripes is rounded up to the power of 2
+template <std::size_t NumStripes = 0>
+struct striped_locking {
+    static constexpr std::size_t num_stripes = NumStripes;
+};
+
+template <typename LockingPolicy>
+struct is_striped_locking : std::false_type {};
+
+template <std::size_t NumStripes>
+struct is_striped_locking<striped_locking<NumStripes>> : std::true_type {};
+
+// Lock embedded into each bucket
+template <typename LockingPolicy>
+class bucket_lock_storage {
+public:
+    versioned_rw_lock& bucket_lock() { return my_lock; }
+private:
+    versioned_rw_lock my_lock;
+}; // class bucket_lock_storage
+
+// No lock in the bucket if the buckets are guarded by the stripes
+template <std::size_t NumStripes>
+class bucket_lock_storage<striped_locking<NumStripes>> {}; // class bucket_lock_storage
+
+template <typename LockingPolicy>
+std::size_t default_number_of_stripes() {
+    std::size_t result = 1;
+    std::size_t requested = LockingPolicy::num_stripes;
+
+    if (requested == 0) {
+        // Enough stripes to make the collisions of the concurrent operations rare
+        requested = 16 * std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    while (result < requested) {
+        result <<= 1;
+    }
+    return result;
+}
+
+} // namespace internal
+} // namespace tomkv
+
+#endif // __TOMKV_INCLUDE_INTERNAL_LOCKING_POLICY_HPP
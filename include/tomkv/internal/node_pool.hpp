@@ -0,0 +1,255 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Konstantin Boyarinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __TOMKV_INCLUDE_INTERNAL_NODE_POOL_HPP
+#define __TOMKV_INCLUDE_INTERNAL_NODE_POOL_HPP
+
+#include "utils.hpp"
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <type_traits>
+
+namespace tomkv {
+namespace internal {
+
+// Pool of the memory blocks of BlockSize bytes
+// Each thread allocates and deallocates the blocks from its own cache
+// The blocks are moved between the thread caches and the central list in batches
+// Memory of the pool is never returned to the system
+template <std::size_t BlockSize>
+class node_pool {
+    struct free_block {
+        free_block* my_next;
+    }; // struct free_block
+
+    static_assert(BlockSize >= sizeof(free_block));
+    static_assert(BlockSize % alignof(std::max_align_t) == 0);
+
+    static constexpr std::size_t slab_size = 64 * 1024;
+    static constexpr std::size_t blocks_per_slab = slab_size / BlockSize > 0 ? slab_size / BlockSize : 1;
+    // Number of blocks moved between the thread cache and the central list at once
+    static constexpr std::size_t batch_size = 32;
+    static constexpr std::size_t max_cached_blocks = 2 * batch_size;
+
+    struct thread_cache {
+        free_block* my_list;
+        std::size_t my_size;
+    }; // struct thread_cache
+
+    // Returns the blocks of the thread cache to the central list on thread exit
+    class cache_flusher {
+    public:
+        cache_flusher( thread_cache* cache, bool* released ) : my_cache(cache), my_released(released) {}
+
+        ~cache_flusher() {
+            instance().release_blocks(my_cache->my_list, my_cache->my_size);
+            my_cache->my_list = nullptr;
+            my_cache->my_size = 0;
+            *my_released = true;
+        }
+    private:
+        thread_cache* my_cache;
+        bool* my_released;
+    }; // class cache_flusher
+
+public:
+    node_pool() : my_free_list(nullptr) {}
+
+    node_pool( const node_pool& ) = delete;
+    node_pool& operator=( const node_pool& ) = delete;
+
+    // The pool is never destroyed, so the blocks can be deallocated by the objects with static storage duration
+    static node_pool& instance() {
+        static node_pool* pool = new node_pool;
+        return *pool;
+    }
+
+    void* allocate() {
+        thread_cache* cache = local_cache();
+
+        if (cache == nullptr) {
+            // The thread cache was already released on thread exit
+            free_block* block = nullptr;
+            acquire_blocks(block, 1);
+            return block;
+        }
+
+        if (cache->my_list == nullptr) {
+            cache->my_size = acquire_blocks(cache->my_list, batch_size);
+        }
+
+        free_block* block = cache->my_list;
+        cache->my_list = block->my_next;
+        --cache->my_size;
+        return block;
+    }
+
+    void deallocate( void* ptr ) {
+        free_block* block = static_cast<free_block*>(ptr);
+        thread_cache* cache = local_cache();
+
+        if (cache == nullptr) {
+            block->my_next = nullptr;
+            release_blocks(block, 1);
+            return;
+        }
+
+        block->my_next = cache->my_list;
+        cache->my_list = block;
+
+        // The blocks deallocated by the other threads than allocated them are rebalanced here
+        if (++cache->my_size > max_cached_blocks) {
+            free_block* batch = cache->my_list;
+            free_block* last = batch;
+            for (std::size_t i = 1; i < batch_size; ++i) {
+                last = last->my_next;
+            }
+            cache->my_list = last->my_next;
+            cache->my_size -= batch_size;
+            last->my_next = nullptr;
+            release_blocks(batch, batch_size);
+        }
+    }
+
+private:
+    static thread_cache* local_cache() {
+        // Trivially destructible objects are accessible after the flusher is destroyed
+        static thread_local thread_cache cache{nullptr, 0};
+        static thread_local bool released = false;
+
+        if (released) {
+            return nullptr;
+        }
+        static thread_local cache_flusher flusher{&cache, &released};
+        utils::suppress_unused(flusher);
+        return &cache;
+    }
+
+    // Moves up to count blocks from the central list to the list
+    // Returns the number of moved blocks
+    std::size_t acquire_blocks( free_block*& list, std::size_t count ) {
+        std::lock_guard<std::mutex> lock(my_mutex);
+
+        if (my_free_list == nullptr) {
+            allocate_slab();
+        }
+
+        std::size_t acquired = 0;
+        while(acquired < count && my_free_list != nullptr) {
+            free_block* block = my_free_list;
+            my_free_list = block->my_next;
+            block->my_next = list;
+            list = block;
+            ++acquired;
+        }
+        return acquired;
+    }
+
+    // Moves the list of count blocks to the central list
+    void release_blocks( free_block* list, std::size_t count ) {
+        if (list == nullptr) {
+            return;
+        }
+
+        free_block* last = list;
+        for (std::size_t i = 1; i < count; ++i) {
+            last = last->my_next;
+        }
+
+        std::lock_guard<std::mutex> lock(my_mutex);
+        last->my_next = my_free_list;
+        my_free_list = list;
+    }
+
+    // Should be called when my_mutex is locked
+    void allocate_slab() {
+        char* slab = static_cast<char*>(::operator new(blocks_per_slab * BlockSize));
+
+        for (std::size_t i = 0; i < blocks_per_slab; ++i) {
+            free_block* block = reinterpret_cast<free_block*>(slab + i * BlockSize);
+            block->my_next = my_free_list;
+            my_free_list = block;
+        }
+    }
+
+    std::mutex my_mutex;
+    free_block* my_free_list;
+}; // class node_pool
+
+// Allocator which serves the single object allocations from the node_pool
+// Array allocations and overaligned types are served by the global operator new
+template <typename T>
+class node_pool_allocator {
+    static constexpr std::size_t block_size = (sizeof(T) + alignof(std::max_align_t) - 1) /
+                                              alignof(std::max_align_t) * alignof(std::max_align_t);
+    static constexpr bool is_pooled = alignof(T) <= alignof(std::max_align_t);
+
+    using pool_type = node_pool<block_size>;
+public:
+    using value_type = T;
+    using propagate_on_container_move_assignment = std::true_type;
+    using is_always_equal = std::true_type;
+
+    node_pool_allocator() noexcept = default;
+
+    template <typename U>
+    node_pool_allocator( const node_pool_allocator<U>& ) noexcept {}
+
+    T* allocate( std::size_t n ) {
+        if constexpr (is_pooled) {
+            if (n == 1) {
+                return static_cast<T*>(pool_type::instance().allocate());
+            }
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        } else {
+            return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(alignof(T))));
+        }
+    }
+
+    void deallocate( T* ptr, std::size_t n ) {
+        if constexpr (is_pooled) {
+            if (n == 1) {
+                pool_type::instance().deallocate(ptr);
+            } else {
+                ::operator delete(ptr);
+            }
+        } else {
+            utils::suppress_unused(n);
+            ::operator delete(ptr, std::align_val_t(alignof(T)));
+        }
+    }
+}; // class node_pool_allocator
+
+// All of the node pool allocators share the same pools
+template <typename T, typename U>
+bool operator==( const node_pool_allocator<T>&, const node_pool_allocator<U>& ) { return true; }
+
+template <typename T, typename U>
+bool operator!=( const node_pool_allocator<T>&, const node_pool_allocator<U>& ) { return false; }
+
+} // namespace internal
+} // namespace tomkv
+
+#endif // __TOMKV_INCLUDE_INTERNAL_NODE_POOL_HPP
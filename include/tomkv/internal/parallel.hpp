@@ -0,0 +1,115 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Konstantin Boyarinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __TOMKV_INCLUDE_INTERNAL_PARALLEL_HPP
+#define __TOMKV_INCLUDE_INTERNAL_PARALLEL_HPP
+
+#include "utils.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tomkv {
+namespace internal {
+
+// Requests the bulk operation to be executed by several threads
+class parallel_policy {
+public:
+    // By default all of the hardware threads are used
+    parallel_policy() : parallel_policy(std::max(std::thread::hardware_concurrency(), 1u)) {}
+
+    explicit parallel_policy( std::size_t concurrency ) : my_concurrency(std::max(concurrency, std::size_t(1))) {}
+
+    // The maximal number of threads including the calling thread
+    std::size_t concurrency() const { return my_concurrency; }
+private:
+    std::size_t my_concurrency;
+}; // class parallel_policy
+
+// Executes body(i) for each i in [0, n), the tasks are distributed dynamically between the threads
+// The calling thread participates in the execution
+// If any body throws, the remaining tasks are skipped and the first exception is rethrown
+template <typename Body>
+void parallel_for( std::size_t n, const parallel_policy& policy, const Body& body ) {
+    std::size_t num_threads = std::min(policy.concurrency(), n);
+
+    if (num_threads <= 1) {
+        for (std::size_t i = 0; i < n; ++i) {
+            body(i);
+        }
+        return;
+    }
+
+    std::atomic<std::size_t> next_task{0};
+    std::exception_ptr exception;
+    std::mutex exception_mutex;
+
+    auto worker = [&] {
+        try {
+            for (std::size_t i = next_task++; i < n; i = next_task++) {
+                body(i);
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(exception_mutex);
+            if (!exception) {
+                exception = std::current_exception();
+            }
+            next_task.store(n);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads - 1);
+
+    // The started threads are joined even if the creation of the next thread throws
+    utils::raii_guard guard([&] {
+        next_task.store(n);
+        for (auto& t : threads) {
+            t.join();
+        }
+    });
+
+    for (std::size_t i = 1; i < num_threads; ++i) {
+        threads.emplace_back(worker);
+    }
+    worker();
+
+    guard.release();
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    if (exception) {
+        std::rethrow_exception(exception);
+    }
+}
+
+} // namespace internal
+} // namespace tomkv
+
+#endif // __TOMKV_INCLUDE_INTERNAL_PARALLEL_HPP
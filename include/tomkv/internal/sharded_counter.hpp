@@ -0,0 +1,148 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Konstantin Boyarinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __TOMKV_INCLUDE_INTERNAL_SHARDED_COUNTER_HPP
+#define __TOMKV_INCLUDE_INTERNAL_SHARDED_COUNTER_HPP
+
+#include "utils.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <type_traits>
+
+namespace tomkv {
+namespace internal {
+
+// Returns the index assigned to the current thread, the indices are assigned in the order of the first call
+inline std::size_t this_thread_index() {
+    static std::atomic<std::size_t> next_index{0};
+    static thread_local std::size_t index = next_index.fetch_add(1, std::memory_order_relaxed);
+    return index;
+}
+
+// Counter, which is modified by each thread in its own slot to avoid the contention on a single cache line
+// The value of the counter is the sum of the slots. The slots may wrap around if the thread decrements
+// the value incremented by the other thread, but the sum is still correct
+template <typename Allocator>
+class sharded_counter {
+public:
+    using value_type = std::size_t;
+private:
+    static constexpr std::size_t cache_line_size = 64;
+
+    struct slot_state {
+        std::atomic<value_type> my_value;
+    }; // struct slot_state
+
+    // Slots are padded to the cache line size to prevent false sharing between the neighbours
+    // alignas is not used, since the user allocator may not support overaligned types
+    struct slot : slot_state {
+        slot() : slot_state{{0}} {}
+
+        char my_padding[cache_line_size - sizeof(slot_state) % cache_line_size];
+    }; // struct slot
+
+    using slot_allocator_type = typename std::allocator_traits<Allocator>::template rebind_alloc<slot>;
+    using slot_allocator_traits = std::allocator_traits<slot_allocator_type>;
+public:
+    sharded_counter( Allocator& allocator )
+        : my_allocator(allocator), my_slots(nullptr), my_slot_count(default_number_of_slots())
+    {
+        slot_allocator_type slot_allocator{my_allocator};
+        my_slots = slot_allocator_traits::allocate(slot_allocator, my_slot_count);
+
+        for (std::size_t i = 0; i < my_slot_count; ++i) {
+            // Constructor of the slot is noexcept - no extra care needed
+            slot_allocator_traits::construct(slot_allocator, my_slots + i);
+        }
+    }
+
+    sharded_counter( const sharded_counter& ) = delete;
+    sharded_counter& operator=( const sharded_counter& ) = delete;
+
+    ~sharded_counter() {
+        slot_allocator_type slot_allocator{my_allocator};
+
+        for (std::size_t i = 0; i < my_slot_count; ++i) {
+            slot_allocator_traits::destroy(slot_allocator, my_slots + i);
+        }
+        slot_allocator_traits::deallocate(slot_allocator, my_slots, my_slot_count);
+    }
+
+    // Returns the value of the slot of the current thread after the increment
+    value_type add( value_type delta ) {
+        return local_slot().my_value.fetch_add(delta, std::memory_order_relaxed) + delta;
+    }
+
+    // Returns the value of the slot of the current thread after the decrement
+    value_type sub( value_type delta ) {
+        return local_slot().my_value.fetch_sub(delta, std::memory_order_relaxed) - delta;
+    }
+
+    // The slots are read one by one, so the result is not a snapshot if the counter is modified concurrently
+    // A decrement may be observed before the corresponding increment, so the negative sum is reported as 0
+    value_type load() const {
+        value_type sum = 0;
+        for (std::size_t i = 0; i < my_slot_count; ++i) {
+            sum += my_slots[i].my_value.load(std::memory_order_relaxed);
+        }
+        return std::make_signed_t<value_type>(sum) < 0 ? 0 : sum;
+    }
+
+    // Not thread-safe
+    void store( value_type value ) {
+        my_slots[0].my_value.store(value, std::memory_order_relaxed);
+        for (std::size_t i = 1; i < my_slot_count; ++i) {
+            my_slots[i].my_value.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    std::size_t slot_count() const { return my_slot_count; }
+
+private:
+    slot& local_slot() {
+        return my_slots[this_thread_index() & (my_slot_count - 1)];
+    }
+
+    // A slot per hardware thread, the number of slots is a power of 2
+    static std::size_t default_number_of_slots() {
+        std::size_t result = 1;
+        std::size_t requested = std::max(std::thread::hardware_concurrency(), 1u);
+        while (result < requested) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    Allocator&  my_allocator;
+    slot*       my_slots;
+    std::size_t my_slot_count;
+}; // class sharded_counter
+
+} // namespace internal
+} // namespace tomkv
+
+#endif // __TOMKV_INCLUDE_INTERNAL_SHARDED_COUNTER_HPP
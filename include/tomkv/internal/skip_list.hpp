@@ -0,0 +1,698 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Konstantin Boyarinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __TOMKV_INCLUDE_INTERNAL_SKIP_LIST_HPP
+#define __TOMKV_INCLUDE_INTERNAL_SKIP_LIST_HPP
+
+#include "utils.hpp"
+#include "compact_rw_mutex.hpp"
+#include "epoch.hpp"
+#include "sharded_counter.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <utility>
+#include <type_traits>
+
+namespace tomkv {
+namespace internal {
+
+// Lazy skip list: the lookups traverse the links without locks, the insertions and erasures lock only
+// the predecessors of the node at each of its levels. The erased node is marked before it is unlinked,
+// so the concurrent operations can validate their predecessors, and reclaimed by the epoch domain
+template <typename Key, typename Mapped,
+          typename Compare, typename Allocator>
+class skip_list {
+public:
+    using key_type = Key;
+    using mapped_type = Mapped;
+    using value_type = std::pair<const key_type, mapped_type>;
+    using allocator_type = Allocator;
+    using key_compare = Compare;
+    using size_type = std::size_t;
+
+    class read_accessor;
+    class write_accessor;
+private:
+    using allocator_traits_type = std::allocator_traits<allocator_type>;
+
+    // Each level has 1/4 of the nodes of the previous level
+    static constexpr size_type max_height = 20;
+
+    class node;
+    using link_type = std::atomic<node*>;
+
+    // The node and its links are allocated as a single block of the units
+    using unit_type = std::max_align_t;
+    using unit_allocator_type = typename allocator_traits_type::template rebind_alloc<unit_type>;
+    using unit_allocator_traits = std::allocator_traits<unit_allocator_type>;
+
+    // The links are placed right after the node
+    class alignas(link_type) node {
+    public:
+        node( size_type height ) : my_marked(false), my_fully_linked(false), my_height(std::uint32_t(height)) {
+            for (size_type level = 0; level < height; ++level) {
+                new (links() + level) link_type(nullptr);
+            }
+        }
+
+        value_type* value_ptr() { return reinterpret_cast<value_type*>(&my_storage); }
+        value_type& value() { return *value_ptr(); }
+        const key_type& key() { return value().first; }
+        mapped_type& mapped() { return value().second; }
+
+        size_type height() const { return my_height; }
+
+        node* next( size_type level ) const { return links()[level].load(std::memory_order_acquire); }
+        void set_next( size_type level, node* n ) { links()[level].store(n, std::memory_order_release); }
+
+        bool is_marked() const { return my_marked.load(std::memory_order_acquire); }
+        void mark() { my_marked.store(true, std::memory_order_release); }
+
+        bool is_fully_linked() const { return my_fully_linked.load(std::memory_order_acquire); }
+        void set_fully_linked() { my_fully_linked.store(true, std::memory_order_release); }
+
+        // The node is in the list and is not being erased
+        bool is_live() const { return is_fully_linked() && !is_marked(); }
+
+        // Guards the links of the node
+        compact_rw_mutex& link_mutex() { return my_link_mutex; }
+        // Guards the value of the node, locked by the accessors
+        compact_rw_mutex& value_mutex() { return my_value_mutex; }
+
+        static size_type units_for_height( size_type height ) {
+            size_type bytes = sizeof(node) + height * sizeof(link_type);
+            return (bytes + sizeof(unit_type) - 1) / sizeof(unit_type);
+        }
+    private:
+        link_type* links() const {
+            return reinterpret_cast<link_type*>(const_cast<node*>(this) + 1);
+        }
+
+        std::aligned_storage_t<sizeof(value_type), alignof(value_type)> my_storage;
+        compact_rw_mutex my_link_mutex;
+        compact_rw_mutex my_value_mutex;
+        std::atomic<bool> my_marked;
+        std::atomic<bool> my_fully_linked;
+        std::uint32_t my_height;
+    }; // class node
+
+    static_assert(alignof(node) <= alignof(unit_type), "Overaligned value types are not supported");
+
+    template <typename Derived>
+    class accessor_base {
+    public:
+        accessor_base() : my_node(nullptr) {}
+
+        void release() {
+            Derived* der_this = static_cast<Derived*>(this);
+            auto& der_lock = der_this->lock();
+            if (der_lock) {
+                der_lock.unlock();
+                my_node = nullptr;
+            }
+        }
+
+        const key_type& key() const { return my_node->key(); }
+    protected:
+        node* get_node() const { return my_node; }
+        void assign( node* n ) { my_node = n; }
+    private:
+        node* my_node;
+    }; // class accessor_base
+
+    using read_lock_type = std::shared_lock<compact_rw_mutex>;
+    using write_lock_type = std::unique_lock<compact_rw_mutex>;
+
+public:
+    class read_accessor : public accessor_base<read_accessor> {
+    public:
+        read_accessor() = default;
+        read_accessor( read_accessor&& ) = default;
+
+        ~read_accessor() { this->release(); }
+
+        const mapped_type& mapped() const { return this->get_node()->mapped(); }
+        // hazardous prefix means that the data race may occur while writing to
+        // the non-const mapped or value object and some additional synchronization is required
+        mapped_type& hazardous_mapped() { return this->get_node()->mapped(); }
+        const value_type& value() const { return this->get_node()->value(); }
+        value_type& hazardous_value() { return this->get_node()->value(); }
+
+    private:
+        read_lock_type& lock() { return my_lock; }
+
+        using accessor_base<read_accessor>::get_node;
+
+        void assign( read_lock_type&& l, node* n ) {
+            my_lock = std::move(l);
+            accessor_base<read_accessor>::assign(n);
+        }
+
+        using lock_holder_type = read_lock_type;
+
+        read_lock_type my_lock;
+
+        friend class accessor_base<read_accessor>;
+        friend class skip_list;
+    }; // class read_accessor
+
+    class write_accessor : public accessor_base<write_accessor> {
+    public:
+        write_accessor() = default;
+        write_accessor( write_accessor&& ) = default;
+
+        ~write_accessor() { this->release(); }
+
+        mapped_type& mapped() { return this->get_node()->mapped(); }
+        value_type& value() { return this->get_node()->value(); }
+
+    private:
+        write_lock_type& lock() { return my_lock; }
+
+        using accessor_base<write_accessor>::get_node;
+
+        void assign( write_lock_type&& l, node* n ) {
+            my_lock = std::move(l);
+            accessor_base<write_accessor>::assign(n);
+        }
+
+        using lock_holder_type = write_lock_type;
+
+        write_lock_type my_lock;
+
+        friend class accessor_base<write_accessor>;
+        friend class skip_list;
+    }; // class write_accessor
+
+    skip_list( key_compare& comp, allocator_type& allocator )
+        : my_allocator(allocator), my_compare(comp), my_size(my_allocator), my_head(create_node(max_height)) {}
+
+    skip_list( const skip_list& ) = delete;
+    skip_list& operator=( const skip_list& ) = delete;
+
+    // The retired nodes are reclaimed by the destructor of the epoch domain
+    ~skip_list() {
+        internal_clear();
+        deallocate_node(my_head);
+    }
+
+    template <typename... Args>
+    bool emplace( read_accessor& acc, Args&&... args ) {
+        return internal_emplace(acc, std::forward<Args>(args)...);
+    }
+
+    template <typename... Args>
+    bool emplace( write_accessor& acc, Args&&... args ) {
+        return internal_emplace(acc, std::forward<Args>(args)...);
+    }
+
+    template <typename... Args>
+    bool emplace( Args&&... args ) {
+        read_accessor racc;
+        return internal_emplace(racc, std::forward<Args>(args)...);
+    }
+
+    bool find( read_accessor& acc, const key_type& key ) {
+        return internal_find(acc, key);
+    }
+
+    bool find( write_accessor& acc, const key_type& key ) {
+        return internal_find(acc, key);
+    }
+
+    // Returns a copy of the mapped object, copied under the read lock of the element
+    std::optional<mapped_type> find_copy( const key_type& key ) {
+        read_accessor racc;
+        if (internal_find(racc, key)) {
+            return racc.mapped();
+        }
+        return std::nullopt;
+    }
+
+    bool contains( const key_type& key ) {
+        typename epoch_domain::guard guard{my_epoch_domain};
+        node* n = search([&]( node* curr ) { return my_compare(curr->key(), key); });
+        for (; n != nullptr && !my_compare(key, n->key()); n = n->next(0)) {
+            if (n->is_live()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Assigns the accessor to the element with the smallest key
+    bool first( read_accessor& acc ) {
+        return internal_first(acc);
+    }
+
+    bool first( write_accessor& acc ) {
+        return internal_first(acc);
+    }
+
+    // Assigns the accessor to the first element which key is not less than key
+    bool lower_bound( read_accessor& acc, const key_type& key ) {
+        return internal_lower_bound(acc, key);
+    }
+
+    bool lower_bound( write_accessor& acc, const key_type& key ) {
+        return internal_lower_bound(acc, key);
+    }
+
+    // Assigns the accessor to the first element which key is greater than key
+    bool upper_bound( read_accessor& acc, const key_type& key ) {
+        return internal_upper_bound(acc, key);
+    }
+
+    bool upper_bound( write_accessor& acc, const key_type& key ) {
+        return internal_upper_bound(acc, key);
+    }
+
+    // Moves the accessor to the next element, the accessor is released if there is no next element
+    bool next( read_accessor& acc ) {
+        return internal_next(acc);
+    }
+
+    bool next( write_accessor& acc ) {
+        return internal_next(acc);
+    }
+
+    bool erase( const key_type& key ) {
+        return internal_erase(key);
+    }
+
+    // Erases the element and releases the accessor
+    void erase( write_accessor& acc ) {
+        internal_erase(acc);
+    }
+
+    // Applies pred to the elements in the ascending order of the keys, each element is visited under its read lock
+    // The traversal is weakly consistent: the elements inserted or erased concurrently may be skipped
+    template <typename Predicate>
+    void for_each( const Predicate& pred ) {
+        read_accessor racc;
+        for (bool found = first(racc); found; found = next(racc)) {
+            pred(racc.value());
+        }
+    }
+
+    // Applies pred to the elements with the keys in [first_key, last_key)
+    template <typename Predicate>
+    void for_each( const key_type& first_key, const key_type& last_key, const Predicate& pred ) {
+        read_accessor racc;
+        for (bool found = lower_bound(racc, first_key); found && my_compare(racc.key(), last_key); found = next(racc)) {
+            pred(racc.value());
+        }
+    }
+
+    // Sums up the per-thread counters
+    size_type size() const { return my_size.load(); }
+
+    bool empty() const { return size() == 0; }
+
+    // Not thread-safe
+    void clear() {
+        internal_clear();
+    }
+
+    allocator_type get_allocator() const { return my_allocator; }
+
+protected:
+    // The elements of other are appended in the order of the keys, without the searches
+    // Not thread-safe
+    void internal_copy( const skip_list& other ) {
+        __TOMKV_ASSERT(empty());
+        node* last[max_height];
+        std::fill(last, last + max_height, my_head);
+
+        size_type count = 0;
+        for (node* n = other.my_head->next(0); n != nullptr; n = n->next(0)) {
+            node* copy = create_value_node(n->value());
+            for (size_type level = 0; level < copy->height(); ++level) {
+                last[level]->set_next(level, copy);
+                last[level] = copy;
+            }
+            copy->set_fully_linked();
+            ++count;
+        }
+        my_size.store(count);
+    }
+
+    // The nodes are stolen from other, the empty head of this is left to other
+    // Not thread-safe
+    void internal_move( skip_list&& other ) {
+        __TOMKV_ASSERT(empty());
+        std::swap(my_head, other.my_head);
+        my_size.store(other.my_size.load());
+        other.my_size.store(0);
+    }
+
+private:
+    // The height is chosen by the pairs of the random bits, each pair is 0 with the probability 1/4
+    static size_type random_height() {
+        static thread_local std::uint64_t state = 0x9E3779B97F4A7C15ull * (this_thread_index() + 1);
+        // xorshift64
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+
+        size_type height = 1;
+        std::uint64_t bits = state;
+        while (height < max_height && (bits & 3) == 0) {
+            ++height;
+            bits >>= 2;
+        }
+        return height;
+    }
+
+    node* create_node( size_type height ) {
+        unit_allocator_type unit_allocator{my_allocator};
+        size_type units = node::units_for_height(height);
+        unit_type* storage = unit_allocator_traits::allocate(unit_allocator, units);
+        // Constructor of the node is noexcept - no extra care needed
+        return new (storage) node(height);
+    }
+
+    void deallocate_node( node* n ) {
+        unit_allocator_type unit_allocator{my_allocator};
+        size_type units = node::units_for_height(n->height());
+        n->~node();
+        unit_allocator_traits::deallocate(unit_allocator, reinterpret_cast<unit_type*>(n), units);
+    }
+
+    template <typename... Args>
+    node* create_value_node( Args&&... args ) {
+        node* n = create_node(random_height());
+        // Deallocate the node if the value constructor throws
+        utils::raii_guard guard{[&] { deallocate_node(n); }};
+        allocator_traits_type::construct(my_allocator, n->value_ptr(), std::forward<Args>(args)...);
+        guard.release();
+        return n;
+    }
+
+    void destroy_node( node* n ) {
+        allocator_traits_type::destroy(my_allocator, n->value_ptr());
+        deallocate_node(n);
+    }
+
+    // The node excluded from the list can still be accessed by the lock-free readers
+    void retire_node( node* n ) {
+        my_epoch_domain.retire(n, []( void* list, void* object ) {
+            static_cast<skip_list*>(list)->destroy_node(static_cast<node*>(object));
+        }, this);
+    }
+
+    // Returns the first node at the level 0 for which is_before returns false
+    // Should be called inside of the epoch guard
+    template <typename Predicate>
+    node* search( const Predicate& is_before ) const {
+        node* pred = my_head;
+        for (size_type level = max_height; level-- > 0;) {
+            node* curr = pred->next(level);
+            while (curr != nullptr && is_before(curr)) {
+                pred = curr;
+                curr = pred->next(level);
+            }
+            if (level == 0) {
+                return curr;
+            }
+        }
+        return nullptr;
+    }
+
+    // Fills the predecessors and the successors of key at each level
+    // Returns the highest level at which the node with equal key was found or max_height if it was not found
+    size_type find_position( const key_type& key, node** preds, node** succs ) const {
+        size_type found_level = max_height;
+        node* pred = my_head;
+        for (size_type level = max_height; level-- > 0;) {
+            node* curr = pred->next(level);
+            while (curr != nullptr && my_compare(curr->key(), key)) {
+                pred = curr;
+                curr = pred->next(level);
+            }
+            if (found_level == max_height && curr != nullptr && !my_compare(key, curr->key())) {
+                found_level = level;
+            }
+            preds[level] = pred;
+            succs[level] = curr;
+        }
+        return found_level;
+    }
+
+    // Locks the links of the predecessors at the levels [0, height), the same predecessor is locked once
+    // The predecessors at the higher levels have the smaller keys, so the locks are acquired in the descending order of the keys
+    static void lock_predecessors( node** preds, size_type height ) {
+        for (size_type level = 0; level < height; ++level) {
+            if (level == 0 || preds[level] != preds[level - 1]) {
+                preds[level]->link_mutex().lock();
+            }
+        }
+    }
+
+    static void unlock_predecessors( node** preds, size_type height ) {
+        for (size_type level = 0; level < height; ++level) {
+            if (level == 0 || preds[level] != preds[level - 1]) {
+                preds[level]->link_mutex().unlock();
+            }
+        }
+    }
+
+    // Locks the value of the first live node starting from n, for which is_past returns false
+    // The node is skipped if it was erased while the lock was acquired
+    // Should be called inside of the epoch guard
+    template <typename Accessor, typename Predicate>
+    bool acquire_node( Accessor& acc, node* n, const Predicate& is_past ) {
+        for (; n != nullptr && !is_past(n); n = n->next(0)) {
+            if (!n->is_live()) {
+                continue;
+            }
+            typename Accessor::lock_holder_type lock{n->value_mutex()};
+            if (!n->is_marked()) {
+                acc.assign(std::move(lock), n);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    template <typename Accessor, typename... Args>
+    bool internal_emplace( Accessor& acc, Args&&... args ) {
+        acc.release();
+        node* new_node = create_value_node(std::forward<Args>(args)...);
+        // The node is destroyed if it was not inserted
+        utils::raii_guard node_guard([&] { destroy_node(new_node); });
+
+        const key_type& key = new_node->key();
+        size_type height = new_node->height();
+        node* preds[max_height];
+        node* succs[max_height];
+
+        typename epoch_domain::guard guard{my_epoch_domain};
+        while (true) {
+            size_type found_level = find_position(key, preds, succs);
+            if (found_level != max_height) {
+                node* found = succs[found_level];
+                if (!found->is_marked()) {
+                    // The node is being inserted by the other thread
+                    while (!found->is_fully_linked()) {
+                        utils::cpu_pause();
+                    }
+                    typename Accessor::lock_holder_type lock{found->value_mutex()};
+                    if (!found->is_marked()) {
+                        acc.assign(std::move(lock), found);
+                        return false;
+                    }
+                }
+                // The node is being erased, wait until it is unlinked
+                utils::cpu_pause();
+                continue;
+            }
+
+            lock_predecessors(preds, height);
+            bool valid = true;
+            for (size_type level = 0; valid && level < height; ++level) {
+                valid = !preds[level]->is_marked() && (succs[level] == nullptr || !succs[level]->is_marked()) &&
+                        preds[level]->next(level) == succs[level];
+            }
+            if (!valid) {
+                unlock_predecessors(preds, height);
+                continue;
+            }
+
+            // Nobody can access the node before it is linked
+            acc.assign(typename Accessor::lock_holder_type{new_node->value_mutex()}, new_node);
+            for (size_type level = 0; level < height; ++level) {
+                new_node->set_next(level, succs[level]);
+            }
+            for (size_type level = 0; level < height; ++level) {
+                preds[level]->set_next(level, new_node);
+            }
+            new_node->set_fully_linked();
+            unlock_predecessors(preds, height);
+
+            node_guard.release();
+            my_size.add(1);
+            return true;
+        }
+    }
+
+    template <typename Accessor>
+    bool internal_find( Accessor& acc, const key_type& key ) {
+        acc.release();
+        typename epoch_domain::guard guard{my_epoch_domain};
+        node* n = search([&]( node* curr ) { return my_compare(curr->key(), key); });
+        return acquire_node(acc, n, [&]( node* curr ) { return my_compare(key, curr->key()); });
+    }
+
+    template <typename Accessor>
+    bool internal_first( Accessor& acc ) {
+        acc.release();
+        typename epoch_domain::guard guard{my_epoch_domain};
+        return acquire_node(acc, my_head->next(0), []( node* ) { return false; });
+    }
+
+    template <typename Accessor>
+    bool internal_lower_bound( Accessor& acc, const key_type& key ) {
+        acc.release();
+        typename epoch_domain::guard guard{my_epoch_domain};
+        node* n = search([&]( node* curr ) { return my_compare(curr->key(), key); });
+        return acquire_node(acc, n, []( node* ) { return false; });
+    }
+
+    template <typename Accessor>
+    bool internal_upper_bound( Accessor& acc, const key_type& key ) {
+        acc.release();
+        typename epoch_domain::guard guard{my_epoch_domain};
+        node* n = search([&]( node* curr ) { return !my_compare(key, curr->key()); });
+        return acquire_node(acc, n, []( node* ) { return false; });
+    }
+
+    template <typename Accessor>
+    bool internal_next( Accessor& acc ) {
+        node* current = acc.get_node();
+        __TOMKV_ASSERT(current != nullptr);
+        // The current node is locked, so it is not unlinked before the guard is entered and
+        // all of the nodes reachable from it are not reclaimed until the guard is left
+        typename epoch_domain::guard guard{my_epoch_domain};
+        acc.release();
+        return acquire_node(acc, current->next(0), []( node* ) { return false; });
+    }
+
+    bool internal_erase( const key_type& key ) {
+        typename epoch_domain::guard guard{my_epoch_domain};
+        while (true) {
+            node* n = search([&]( node* curr ) { return my_compare(curr->key(), key); });
+            // Only the fully linked node can be erased, so the erasure does not overtake the insertion
+            while (n != nullptr && !my_compare(key, n->key()) && !n->is_live()) {
+                n = n->next(0);
+            }
+            if (n == nullptr || my_compare(key, n->key())) {
+                return false;
+            }
+
+            // The accessors to the node are waited before it is marked
+            write_lock_type value_lock{n->value_mutex()};
+            if (n->is_marked()) {
+                // The node was erased by the other thread, search for the node which may be inserted after it
+                continue;
+            }
+            unlink_node(n);
+            value_lock.unlock();
+            retire_node(n);
+            return true;
+        }
+    }
+
+    void internal_erase( write_accessor& acc ) {
+        node* n = acc.get_node();
+        __TOMKV_ASSERT(n != nullptr);
+        typename epoch_domain::guard guard{my_epoch_domain};
+        unlink_node(n);
+        acc.release();
+        retire_node(n);
+    }
+
+    // Marks the node and excludes it from all of the levels
+    // The value of the node should be locked for write, so the node cannot be erased by the other thread
+    void unlink_node( node* victim ) {
+        size_type height = victim->height();
+        node* preds[max_height];
+        node* succs[max_height];
+
+        victim->link_mutex().lock();
+        victim->mark();
+        while (true) {
+            find_position(victim->key(), preds, succs);
+            lock_predecessors(preds, height);
+            bool valid = true;
+            for (size_type level = 0; valid && level < height; ++level) {
+                valid = !preds[level]->is_marked() && preds[level]->next(level) == victim;
+            }
+            if (valid) {
+                break;
+            }
+            unlock_predecessors(preds, height);
+        }
+
+        for (size_type level = height; level-- > 0;) {
+            preds[level]->set_next(level, victim->next(level));
+        }
+        unlock_predecessors(preds, height);
+        victim->link_mutex().unlock();
+        my_size.sub(1);
+    }
+
+    void internal_clear() {
+        node* n = my_head->next(0);
+        while (n != nullptr) {
+            node* next = n->next(0);
+            destroy_node(n);
+            n = next;
+        }
+        for (size_type level = 0; level < max_height; ++level) {
+            my_head->set_next(level, nullptr);
+        }
+        my_size.store(0);
+    }
+
+    // Fields read by each operation, which are rarely modified
+    allocator_type&                 my_allocator;
+    key_compare&                    my_compare;
+    // Each thread modifies its own counter, the counters are placed on the separate cache lines
+    sharded_counter<allocator_type> my_size;
+    node*                           my_head;
+
+    alignas(64) epoch_domain        my_epoch_domain;
+}; // class skip_list
+
+} // namespace internal
+} // namespace tomkv
+
+#endif // __TOMKV_INCLUDE_INTERNAL_SKIP_LIST_HPP
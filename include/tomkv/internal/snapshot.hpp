@@ -0,0 +1,360 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Konstantin Boyarinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __TOMKV_INCLUDE_INTERNAL_SNAPSHOT_HPP
+#define __TOMKV_INCLUDE_INTERNAL_SNAPSHOT_HPP
+
+#include "utils.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define __TOMKV_SNAPSHOT_MMAP 1
+#else
+#define __TOMKV_SNAPSHOT_MMAP 0
+#endif
+
+namespace tomkv {
+namespace internal {
+
+// The type of the exception which is thrown if the snapshot cannot be written or read
+struct snapshot_error : std::runtime_error {
+    using std::runtime_error::runtime_error;
+}; // struct snapshot_error
+
+// Buffered output to the snapshot file
+class snapshot_writer {
+    static constexpr std::size_t buffer_size = std::size_t(1) << 20;
+public:
+    explicit snapshot_writer( const std::string& path )
+        : my_file(std::fopen(path.c_str(), "wb"))
+    {
+        if (my_file == nullptr) {
+            throw snapshot_error("Cannot open the snapshot file for writing: " + path);
+        }
+        std::setvbuf(my_file, nullptr, _IOFBF, buffer_size);
+    }
+
+    snapshot_writer( const snapshot_writer& ) = delete;
+    snapshot_writer& operator=( const snapshot_writer& ) = delete;
+
+    ~snapshot_writer() {
+        if (my_file != nullptr) {
+            std::fclose(my_file);
+        }
+    }
+
+    void write( const void* data, std::size_t size ) {
+        if (std::fwrite(data, 1, size, my_file) != size) {
+            throw snapshot_error("Cannot write the snapshot file");
+        }
+    }
+
+    // Overwrites the data at offset from the beginning of the file and returns to the end of the file
+    void write_at( std::size_t offset, const void* data, std::size_t size ) {
+        if (std::fseek(my_file, long(offset), SEEK_SET) != 0) {
+            throw snapshot_error("Cannot write the snapshot file");
+        }
+        write(data, size);
+        if (std::fseek(my_file, 0, SEEK_END) != 0) {
+            throw snapshot_error("Cannot write the snapshot file");
+        }
+    }
+
+    // Flushes the buffered data, the errors of the delayed writes are reported here
+    void close() {
+        std::FILE* file = my_file;
+        my_file = nullptr;
+        if (std::fclose(file) != 0) {
+            throw snapshot_error("Cannot write the snapshot file");
+        }
+    }
+private:
+    std::FILE* my_file;
+}; // class snapshot_writer
+
+// Read-only view of the whole snapshot file
+// The file is mapped into the memory if possible, otherwise it is read into the buffer
+class snapshot_reader {
+public:
+    explicit snapshot_reader( const std::string& path ) : my_data(nullptr), my_size(0) {
+#if __TOMKV_SNAPSHOT_MMAP
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw snapshot_error("Cannot open the snapshot file for reading: " + path);
+        }
+        utils::raii_guard guard([fd] { ::close(fd); });
+
+        struct stat file_stat;
+        if (::fstat(fd, &file_stat) != 0) {
+            throw snapshot_error("Cannot read the snapshot file: " + path);
+        }
+        my_size = std::size_t(file_stat.st_size);
+
+        if (my_size != 0) {
+            void* address = ::mmap(nullptr, my_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (address == MAP_FAILED) {
+                throw snapshot_error("Cannot map the snapshot file: " + path);
+            }
+            // The records are parsed by several threads at once, the pages are read ahead in the background
+            ::madvise(address, my_size, MADV_WILLNEED);
+            my_data = static_cast<const char*>(address);
+        }
+#else
+        std::FILE* file = std::fopen(path.c_str(), "rb");
+        if (file == nullptr) {
+            throw snapshot_error("Cannot open the snapshot file for reading: " + path);
+        }
+        utils::raii_guard guard([file] { std::fclose(file); });
+
+        char buffer[4096];
+        std::size_t n = 0;
+        while ((n = std::fread(buffer, 1, sizeof(buffer), file)) != 0) {
+            my_buffer.insert(my_buffer.end(), buffer, buffer + n);
+        }
+        if (std::ferror(file)) {
+            throw snapshot_error("Cannot read the snapshot file: " + path);
+        }
+        my_data = my_buffer.data();
+        my_size = my_buffer.size();
+#endif
+    }
+
+    snapshot_reader( const snapshot_reader& ) = delete;
+    snapshot_reader& operator=( const snapshot_reader& ) = delete;
+
+    ~snapshot_reader() {
+#if __TOMKV_SNAPSHOT_MMAP
+        if (my_data != nullptr) {
+            ::munmap(const_cast<char*>(my_data), my_size);
+        }
+#endif
+    }
+
+    const char* data() const { return my_data; }
+    std::size_t size() const { return my_size; }
+private:
+    const char* my_data;
+    std::size_t my_size;
+#if !__TOMKV_SNAPSHOT_MMAP
+    std::vector<char> my_buffer;
+#endif
+}; // class snapshot_reader
+
+// Describes how the objects of type T are stored in the snapshot
+// Specializations provide:
+//   is_fixed_size - true if each object occupies sizeof(T) bytes
+//   min_size - the number of bytes occupied by the smallest representation
+//   save(buffer, object) - appends the representation of the object to the std::string buffer
+//   skip(cursor, end) - moves the cursor past the representation, returns false if it exceeds end
+//   load(cursor) - constructs the object from the representation and moves the cursor past it
+template <typename T, typename = void>
+struct snapshot_traits {
+    static_assert(!std::is_same_v<T, T>, "The type is not supported by the snapshots, specialize tomkv::internal::snapshot_traits for it");
+}; // struct snapshot_traits
+
+// Trivially copyable objects are stored as is
+template <typename T>
+struct snapshot_traits<T, std::enable_if_t<std::is_trivially_copyable_v<T>>> {
+    static constexpr bool is_fixed_size = true;
+    static constexpr std::size_t min_size = sizeof(T);
+
+    static void save( std::string& buffer, const T& object ) {
+        buffer.append(reinterpret_cast<const char*>(&object), sizeof(T));
+    }
+
+    static bool skip( const char*& cursor, const char* end ) {
+        if (std::size_t(end - cursor) < sizeof(T)) {
+            return false;
+        }
+        cursor += sizeof(T);
+        return true;
+    }
+
+    static T load( const char*& cursor ) {
+        // The records are not aligned in the snapshot
+        alignas(T) unsigned char object[sizeof(T)];
+        std::memcpy(object, cursor, sizeof(T));
+        cursor += sizeof(T);
+        return *std::launder(reinterpret_cast<T*>(object));
+    }
+}; // struct snapshot_traits
+
+// Strings are stored as the number of characters followed by the characters
+template <typename CharT, typename Traits, typename Allocator>
+struct snapshot_traits<std::basic_string<CharT, Traits, Allocator>, std::enable_if_t<std::is_trivially_copyable_v<CharT>>> {
+    using string_type = std::basic_string<CharT, Traits, Allocator>;
+
+    static constexpr bool is_fixed_size = false;
+    static constexpr std::size_t min_size = sizeof(std::uint64_t);
+
+    static void save( std::string& buffer, const string_type& str ) {
+        std::uint64_t length = str.size();
+        buffer.append(reinterpret_cast<const char*>(&length), sizeof(length));
+        buffer.append(reinterpret_cast<const char*>(str.data()), str.size() * sizeof(CharT));
+    }
+
+    static bool skip( const char*& cursor, const char* end ) {
+        std::uint64_t length = 0;
+        if (std::size_t(end - cursor) < sizeof(length)) {
+            return false;
+        }
+        std::memcpy(&length, cursor, sizeof(length));
+        cursor += sizeof(length);
+        if (std::size_t(end - cursor) / sizeof(CharT) < length) {
+            return false;
+        }
+        cursor += length * sizeof(CharT);
+        return true;
+    }
+
+    static string_type load( const char*& cursor ) {
+        std::uint64_t length = 0;
+        std::memcpy(&length, cursor, sizeof(length));
+        cursor += sizeof(length);
+        string_type str(static_cast<std::size_t>(length), CharT{});
+        std::memcpy(str.data(), cursor, std::size_t(length) * sizeof(CharT));
+        cursor += length * sizeof(CharT);
+        return str;
+    }
+}; // struct snapshot_traits
+
+// The snapshot file starts with the header followed by the records
+// Each record is the key followed by the mapped object
+struct snapshot_header {
+    static constexpr char expected_magic[8] = {'T', 'O', 'M', 'K', 'V', 'S', 'N', 'P'};
+    static constexpr std::uint32_t current_version = 1;
+
+    char          magic[8];
+    std::uint32_t version;
+    // 1 if all of the records have the same size
+    std::uint32_t fixed_size;
+    // Sizes of the key and the mapped types, to detect the type mismatch on loading
+    std::uint64_t key_size;
+    std::uint64_t mapped_size;
+    std::uint64_t element_count;
+}; // struct snapshot_header
+
+// Random access iterator over the records of the loaded snapshot, the records are parsed on dereference
+// The fixed size records are addressed directly, the others - by the offsets found while validating the snapshot
+template <typename Key, typename Mapped>
+class snapshot_record_iterator {
+    using key_traits = snapshot_traits<Key>;
+    using mapped_traits = snapshot_traits<Mapped>;
+public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = std::pair<Key, Mapped>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = value_type;
+
+    snapshot_record_iterator( const char* records, const std::size_t* offsets, std::size_t index )
+        : my_records(records), my_offsets(offsets), my_index(index) {}
+
+    value_type operator*() const {
+        const char* cursor = my_records + record_offset();
+        Key key = key_traits::load(cursor);
+        return value_type(std::move(key), mapped_traits::load(cursor));
+    }
+
+    snapshot_record_iterator& operator++() { ++my_index; return *this; }
+
+    snapshot_record_iterator operator++(int) {
+        snapshot_record_iterator tmp = *this;
+        ++my_index;
+        return tmp;
+    }
+
+    snapshot_record_iterator& operator+=( difference_type n ) { my_index += n; return *this; }
+
+    friend snapshot_record_iterator operator+( snapshot_record_iterator it, difference_type n ) { return it += n; }
+
+    friend difference_type operator-( const snapshot_record_iterator& lhs, const snapshot_record_iterator& rhs ) {
+        return difference_type(lhs.my_index) - difference_type(rhs.my_index);
+    }
+
+    friend bool operator==( const snapshot_record_iterator& lhs, const snapshot_record_iterator& rhs ) {
+        return lhs.my_index == rhs.my_index;
+    }
+
+    friend bool operator!=( const snapshot_record_iterator& lhs, const snapshot_record_iterator& rhs ) {
+        return !(lhs == rhs);
+    }
+
+    static constexpr bool is_fixed_size = key_traits::is_fixed_size && mapped_traits::is_fixed_size;
+    static constexpr std::size_t fixed_record_size = sizeof(Key) + sizeof(Mapped);
+    static constexpr std::size_t min_record_size = std::max(key_traits::min_size + mapped_traits::min_size, std::size_t(1));
+
+    // Checks that the records do not exceed the snapshot, fills the offsets of the variable size records
+    static void validate( const char* records, const char* end, std::size_t count, std::vector<std::size_t>& offsets ) {
+        // The count is read from the header - it is checked before allocating the offsets for it
+        if (std::size_t(end - records) / min_record_size < count) {
+            throw snapshot_error("The snapshot file is truncated");
+        }
+
+        if constexpr (is_fixed_size) {
+            utils::suppress_unused(offsets);
+        } else {
+            offsets.reserve(count);
+            const char* cursor = records;
+            for (std::size_t i = 0; i < count; ++i) {
+                offsets.push_back(std::size_t(cursor - records));
+                if (!key_traits::skip(cursor, end) || !mapped_traits::skip(cursor, end)) {
+                    throw snapshot_error("The snapshot file is truncated");
+                }
+            }
+        }
+    }
+private:
+    std::size_t record_offset() const {
+        if constexpr (is_fixed_size) {
+            return my_index * fixed_record_size;
+        } else {
+            return my_offsets[my_index];
+        }
+    }
+
+    const char* my_records;
+    const std::size_t* my_offsets;
+    std::size_t my_index;
+}; // class snapshot_record_iterator
+
+} // namespace internal
+} // namespace tomkv
+
+#endif // __TOMKV_INCLUDE_INTERNAL_SNAPSHOT_HPP
@@ -0,0 +1,184 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Konstantin Boyarinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __TOMKV_INCLUDE_INTERNAL_STATISTICS_HPP
+#define __TOMKV_INCLUDE_INTERNAL_STATISTICS_HPP
+
+#include "utils.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tomkv {
+namespace internal {
+
+// The events of the containers are recorded only if TOMKV_ENABLE_STATISTICS is defined
+// The macro changes the layout of the containers, so it should be defined for all of the translation units or for none
+#if defined(TOMKV_ENABLE_STATISTICS)
+inline constexpr bool statistics_enabled = true;
+#else
+inline constexpr bool statistics_enabled = false;
+#endif
+
+// Bin i counts the durations in [2^(i-1), 2^i) nanoseconds, bin 0 counts the durations below 1 nanosecond
+// The last bin counts all of the longer durations
+constexpr std::size_t duration_histogram_size = 40;
+using duration_histogram = std::array<std::uint64_t, duration_histogram_size>;
+
+struct hash_table_statistics {
+    std::size_t size;
+    std::size_t bucket_count;
+    float load_factor;
+    float max_load_factor;
+
+    // chain_lengths[i] is the number of the buckets with i elements
+    std::vector<std::size_t> chain_lengths;
+    std::size_t max_chain_length;
+    // Buckets which elements are still stored in the parent buckets, they are not counted in chain_lengths
+    std::size_t unsplit_buckets;
+
+    // The fields below are recorded only if statistics_enabled is true, otherwise they are zero
+    bool events_recorded;
+
+    // Doublings of the number of buckets, including the allocation of the new segment
+    std::uint64_t growth_count;
+    duration_histogram growth_durations;
+
+    // Moves of the elements from the parent buckets to the new ones, under the locks of both buckets
+    std::uint64_t split_count;
+    duration_histogram split_durations;
+
+    // Acquisitions of the bucket locks which were held by the other threads
+    std::uint64_t contended_lock_count;
+    std::uint64_t total_lock_wait_ns;
+    duration_histogram lock_waits;
+}; // struct hash_table_statistics
+
+// Histogram of the durations which can be updated concurrently
+class concurrent_duration_histogram {
+public:
+    concurrent_duration_histogram() {
+        for (auto& bin : my_bins) {
+            bin.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void add( std::uint64_t ns ) {
+        std::size_t bin = ns == 0 ? 0 : std::min(utils::log2(std::size_t(ns)) + 1, duration_histogram_size - 1);
+        my_bins[bin].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    duration_histogram load() const {
+        duration_histogram result;
+        for (std::size_t i = 0; i < duration_histogram_size; ++i) {
+            result[i] = my_bins[i].load(std::memory_order_relaxed);
+        }
+        return result;
+    }
+private:
+    std::array<std::atomic<std::uint64_t>, duration_histogram_size> my_bins;
+}; // class concurrent_duration_histogram
+
+// The events are recorded only on the slow paths: growth, splitting of the buckets and the contended locking
+// The recorder without statistics is empty and is used as a base class to occupy no space
+template <bool Enabled = statistics_enabled>
+class hash_table_statistics_recorder {
+protected:
+    using clock_type = std::chrono::steady_clock;
+
+    static clock_type::time_point start_timer() { return clock_type::now(); }
+
+    static std::uint64_t elapsed_ns( clock_type::time_point start ) {
+        return std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - start).count());
+    }
+
+    void record_growth( clock_type::time_point start ) {
+        my_growth_count.fetch_add(1, std::memory_order_relaxed);
+        my_growth_durations.add(elapsed_ns(start));
+    }
+
+    void record_split( clock_type::time_point start ) {
+        my_split_count.fetch_add(1, std::memory_order_relaxed);
+        my_split_durations.add(elapsed_ns(start));
+    }
+
+    void record_lock_wait( clock_type::time_point start ) {
+        std::uint64_t ns = elapsed_ns(start);
+        my_contended_lock_count.fetch_add(1, std::memory_order_relaxed);
+        my_total_lock_wait_ns.fetch_add(ns, std::memory_order_relaxed);
+        my_lock_waits.add(ns);
+    }
+
+    void load_events( hash_table_statistics& stats ) const {
+        stats.events_recorded = true;
+        stats.growth_count = my_growth_count.load(std::memory_order_relaxed);
+        stats.growth_durations = my_growth_durations.load();
+        stats.split_count = my_split_count.load(std::memory_order_relaxed);
+        stats.split_durations = my_split_durations.load();
+        stats.contended_lock_count = my_contended_lock_count.load(std::memory_order_relaxed);
+        stats.total_lock_wait_ns = my_total_lock_wait_ns.load(std::memory_order_relaxed);
+        stats.lock_waits = my_lock_waits.load();
+    }
+private:
+    // Placed apart from the fields of the table, which are read by each operation
+    alignas(64) std::atomic<std::uint64_t> my_growth_count{0};
+    std::atomic<std::uint64_t> my_split_count{0};
+    std::atomic<std::uint64_t> my_contended_lock_count{0};
+    std::atomic<std::uint64_t> my_total_lock_wait_ns{0};
+    concurrent_duration_histogram my_growth_durations;
+    concurrent_duration_histogram my_split_durations;
+    concurrent_duration_histogram my_lock_waits;
+}; // class hash_table_statistics_recorder
+
+template <>
+class hash_table_statistics_recorder<false> {
+protected:
+    struct clock_type {
+        struct time_point {};
+    };
+
+    static clock_type::time_point start_timer() { return {}; }
+    void record_growth( clock_type::time_point ) {}
+    void record_split( clock_type::time_point ) {}
+    void record_lock_wait( clock_type::time_point ) {}
+
+    void load_events( hash_table_statistics& stats ) const {
+        stats.events_recorded = false;
+        stats.growth_count = 0;
+        stats.growth_durations = {};
+        stats.split_count = 0;
+        stats.split_durations = {};
+        stats.contended_lock_count = 0;
+        stats.total_lock_wait_ns = 0;
+        stats.lock_waits = {};
+    }
+}; // class hash_table_statistics_recorder
+
+} // namespace internal
+} // namespace tomkv
+
+#endif // __TOMKV_INCLUDE_INTERNAL_STATISTICS_HPP
@@ -25,16 +25,30 @@
 #ifndef __TOMKV_INCLUDE_INTERNAL_UTILS_HPP
 #define __TOMKV_INCLUDE_INTERNAL_UTILS_HPP
 
+#include <algorithm>
 #include <cmath>
 #include <cassert>
 #include <chrono>
 #include <thread>
 #include <climits>
+#include <atomic>
+#include <cstdint>
 
 #if defined(_MSC_VER)
 #include <intrin.h>
 #endif
 
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
 namespace tomkv {
 namespace utils {
 
@@ -64,7 +78,25 @@ inline std::uintptr_t bsr( std::uintptr_t input ) {
 }
 #endif
 
-std::size_t log2(std::size_t input) {
+// Returns the number of trailing zero bits, input should not be 0
+inline std::size_t ctz( std::uint32_t input ) {
+#if defined(__GNUC__) || defined(__clang__)
+    return std::size_t(__builtin_ctz(input));
+#elif defined(_MSC_VER)
+    unsigned long result;
+    _BitScanForward(&result, input);
+    return result;
+#else
+    std::size_t result = 0;
+    while ((input & 1) == 0) {
+        input >>= 1;
+        ++result;
+    }
+    return result;
+#endif
+}
+
+inline std::size_t log2(std::size_t input) {
 #if defined(__GNUC__) || defined(__clang__)
     // If N is a power of 2 and input<N => (N-1)-x == (N-1)^input
     std::uintptr_t n_bits = sizeof(input) * CHAR_BIT;
@@ -97,37 +129,129 @@ private:
     Body my_body;
 }; // class raii_guard
 
-class exponential_backoff {
-    static constexpr std::size_t loops_before_pause = 4;
-    static constexpr std::size_t loops_before_yield = 16;
-    std::size_t counter;
 
+template <typename... Args>
+void suppress_unused( Args&&... ) {}
+
+// Hints the processor to load the cache line with the address for reading, never faults
+inline void prefetch( const void* address ) {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(address, 0, 3);
+#elif defined(_M_X64) || defined(_M_IX86)
+    _mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#else
+    suppress_unused(address);
+#endif
+}
+
+// Size of the transparent huge page on x86-64 and on the most of aarch64 configurations
+inline constexpr std::size_t huge_page_size = std::size_t(2) << 20;
+
+// Hints the kernel to back the memory with the transparent huge pages on the first access
+// Only the huge-page-aligned parts of the region can be backed, the rest keeps the regular pages
+inline void advise_huge_pages( void* address, std::size_t size ) {
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    std::uintptr_t begin = reinterpret_cast<std::uintptr_t>(address);
+    std::uintptr_t aligned_begin = (begin + huge_page_size - 1) & ~(huge_page_size - 1);
+    std::uintptr_t aligned_end = (begin + size) & ~(huge_page_size - 1);
+    if (aligned_begin < aligned_end) {
+        // The advice is only a hint, the failure is not an error
+        madvise(reinterpret_cast<void*>(aligned_begin), aligned_end - aligned_begin, MADV_HUGEPAGE);
+    }
+#else
+    suppress_unused(address, size);
+#endif
+}
+
+// Hints the processor that the current thread is spinning
+inline void cpu_pause() {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// Backoff for the retry loops of the lock-free operations
+// The failed CAS means the progress of the other thread, so there is nothing to wait for: the thread pauses
+// for the exponentially growing number of iterations to reduce the contention on the cache line
+// and yields only if the contention persists
+class spin_backoff {
+    static constexpr std::uint32_t max_pause_count = 64;
 public:
-    exponential_backoff() : counter(0) {}
+    spin_backoff() : my_count(1) {}
 
-    exponential_backoff(const exponential_backoff&) = delete;
-    exponential_backoff& operator=(const exponential_backoff&) = delete;
+    spin_backoff( const spin_backoff& ) = delete;
+    spin_backoff& operator=( const spin_backoff& ) = delete;
 
     void pause() {
-        if (counter < loops_before_pause) {
-            ++counter;
-            return;
-        }
-        if (counter < loops_before_yield) {
-            ++counter;
-            std::this_thread::sleep_for(std::chrono::nanoseconds(1));
-            return;
+        if (my_count <= max_pause_count) {
+            for (std::uint32_t i = 0; i < my_count; ++i) {
+                cpu_pause();
+            }
+            my_count *= 2;
+        } else {
+            std::this_thread::yield();
         }
-        std::this_thread::yield();
     }
 
-    void reset() {
-        counter = 0;
+    void reset() { my_count = 1; }
+private:
+    std::uint32_t my_count;
+}; // class spin_backoff
+
+// Number of the spinning iterations before the waiting thread parks, adapted to the observed waiting times:
+// the limit follows the twice of the waits which ended while spinning and decays if the thread had to park,
+// so the short critical sections are waited by spinning and the long ones by parking at once
+// The state is kept per thread, so the adaptation requires no synchronization
+class adaptive_spin {
+public:
+    static constexpr std::uint32_t min_spins = 16;
+    static constexpr std::uint32_t max_spins = 1024;
+
+    constexpr adaptive_spin() : my_limit(64) {}
+
+    std::uint32_t limit() const { return my_limit; }
+
+    // The wait ended after spins iterations without parking
+    void spun( std::uint32_t spins ) {
+        std::int64_t target = std::int64_t(std::min(2 * spins, max_spins));
+        my_limit = clamp(std::int64_t(my_limit) + (target - std::int64_t(my_limit)) / 8);
     }
-}; // class exponential_backoff
 
-template <typename... Args>
-void suppress_unused( Args&&... ) {}
+    // Spinning did not help
+    void parked() {
+        my_limit = clamp(std::int64_t(my_limit) - std::int64_t(my_limit) / 8);
+    }
+private:
+    static std::uint32_t clamp( std::int64_t limit ) {
+        return std::uint32_t(std::min(std::max(limit, std::int64_t(min_spins)), std::int64_t(max_spins)));
+    }
+
+    std::uint32_t my_limit;
+}; // class adaptive_spin
+
+// Blocks the current thread while *address == expected or until futex_wake_all(address)
+// Spurious wakeups are possible
+inline void futex_wait( std::atomic<std::uint32_t>& address, std::uint32_t expected ) {
+#if defined(__linux__)
+    static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t));
+    syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&address), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+#else
+    // No native support - the waiting thread polls the address
+    if (address.load(std::memory_order_relaxed) == expected) {
+        std::this_thread::yield();
+    }
+#endif
+}
+
+inline void futex_wake_all( std::atomic<std::uint32_t>& address ) {
+#if defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&address), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#else
+    suppress_unused(address);
+#endif
+}
 
 } // namespace utils
 } // namespace tomkv
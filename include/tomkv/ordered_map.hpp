@@ -0,0 +1,93 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Konstantin Boyarinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef __TOMKV_INCLUDE_ORDERED_MAP_HPP
+#define __TOMKV_INCLUDE_ORDERED_MAP_HPP
+
+#include "internal/skip_list.hpp"
+#include <functional>
+#include <iterator>
+
+namespace tomkv {
+namespace internal {
+
+template <typename Compare, typename Allocator>
+struct ordered_map_base {
+    Compare my_key_compare;
+    Allocator my_value_allocator;
+}; // struct ordered_map_base
+
+template <typename Key, typename Mapped,
+          typename Compare = std::less<Key>,
+          typename Allocator = std::allocator<std::pair<const Key, Mapped>>>
+class ordered_map : public ordered_map_base<Compare, Allocator>,
+                    public skip_list<Key, Mapped, Compare, Allocator> {
+    using ordered_base_type = ordered_map_base<Compare, Allocator>;
+    using skip_list_base_type = skip_list<Key, Mapped, Compare, Allocator>;
+public:
+    ordered_map( const Compare& comp = Compare(), const Allocator& alloc = Allocator() )
+        : ordered_base_type{comp, alloc},
+          skip_list_base_type(this->my_key_compare, this->my_value_allocator) {}
+
+    ordered_map( const Allocator& alloc )
+        : ordered_map(Compare(), alloc) {}
+
+    template <typename InputIterator,
+              typename = std::enable_if_t<std::is_base_of_v<std::input_iterator_tag,
+                                                            typename std::iterator_traits<InputIterator>::iterator_category>>>
+    ordered_map( InputIterator first, InputIterator last, const Compare& comp = Compare(), const Allocator& alloc = Allocator() )
+        : ordered_map(comp, alloc)
+    {
+        for (; first != last; ++first) {
+            this->emplace(*first);
+        }
+    }
+
+    ordered_map( const ordered_map& other )
+        : ordered_map(other, std::allocator_traits<Allocator>::select_on_container_copy_construction(other.my_value_allocator)) {}
+
+    ordered_map( const ordered_map& other, const Allocator& alloc )
+        : ordered_map(other.my_key_compare, alloc)
+    {
+        skip_list_base_type::internal_copy(other);
+    }
+
+    ordered_map( ordered_map&& other )
+        : ordered_base_type{std::move(other.my_key_compare), std::move(other.my_value_allocator)},
+          skip_list_base_type(this->my_key_compare, this->my_value_allocator)
+    {
+        skip_list_base_type::internal_move(std::move(other));
+    }
+
+    ordered_map& operator=( const ordered_map& ) = delete;
+    ordered_map& operator=( ordered_map&& ) = delete;
+}; // class ordered_map
+
+} // namespace internal
+
+using internal::ordered_map;
+
+} // namespace tomkv
+
+#endif // __TOMKV_INCLUDE_ORDERED_MAP_HPP
@@ -26,10 +26,12 @@
 #define __TOMKV_INCLUDE_STORAGE_HPP
 
 #include "internal/hash_table.hpp"
+#include "internal/clock.hpp"
 #include "boost/property_tree/ptree.hpp"
 #include "boost/property_tree/xml_parser.hpp"
 #include "boost/property_tree/exceptions.hpp"
 #include <string>
+#include <string_view>
 #include <list>
 #include <functional>
 #include <utility>
@@ -42,6 +44,12 @@
 #include <unordered_set>
 #include <optional>
 #include <chrono>
+#include <vector>
+#include <queue>
+#include <thread>
+#include <condition_variable>
+#include <filesystem>
+#include <system_error>
 
 namespace tomkv {
 namespace internal {
@@ -56,7 +64,8 @@ struct unmounted_path : std::exception {
 }; // struct unmounted_path
 
 template <typename Key, typename Mapped,
-          typename Allocator = std::allocator<std::pair<const Key, Mapped>>>
+          typename Allocator = std::allocator<std::pair<const Key, Mapped>>,
+          typename Clock = coarse_clock>
 class storage {
 public:
     using key_type = Key;
@@ -67,28 +76,49 @@ public:
     using tom_id = std::string;
     using path_type = std::string;
     using priority_type = std::size_t;
+    using clock_type = Clock;
 private:
     static_assert(std::is_same_v<mount_id, tom_id>);
-    using id_hasher = std::hash<mount_id>;
-    using id_equality = std::equal_to<mount_id>;
+
+    // Transparent hasher and equality allow to find the mount points by the parts of the path without copying them
+    struct id_hasher {
+        using is_transparent = void;
+
+        std::size_t operator()( std::string_view id ) const {
+            return std::hash<std::string_view>{}(id);
+        }
+    }; // struct id_hasher
+
+    using id_equality = std::equal_to<>;
 
     using allocator_type = Allocator; // TODO: change allocator template
     using allocator_traits_type = std::allocator_traits<allocator_type>;
+
+    using time_point = typename clock_type::time_point;
 public:
     storage( const allocator_type& alloc = allocator_type() )
+        : storage(clock_type(), alloc) {}
+
+    storage( const clock_type& clock, const allocator_type& alloc = allocator_type() )
         : my_allocator(alloc),
+          my_clock(clock),
           my_mount_table(my_hasher, my_id_equality, my_allocator),
-          my_tom_table(my_hasher, my_id_equality, my_allocator) {}
+          my_tom_table(my_hasher, my_id_equality, my_allocator),
+          my_reaped_count(0),
+          my_reaper_stop_flag(false) {}
 
     storage( const storage& ) = delete;
     storage& operator=( const storage& ) = delete;
 
     ~storage() {
+        internal_stop_reaper();
         internal_destroy();
     }
 
     allocator_type get_allocator() const { return my_allocator; }
 
+    clock_type get_clock() const { return my_clock; }
+
     void mount( const mount_id& m_id, const tom_id& t_id,
                 const path_type& path, priority_type priority = priority_type(0) ) {
         internal_mount(m_id, t_id, path, priority);
@@ -182,6 +212,26 @@ public:
         return internal_remove(path);
     }
 
+    std::size_t reap_outdated() {
+        return internal_reap_outdated();
+    }
+
+    void start_reaper( const std::chrono::milliseconds& period = std::chrono::milliseconds(1000) ) {
+        internal_start_reaper(period);
+    }
+
+    void stop_reaper() {
+        internal_stop_reaper();
+    }
+
+    std::size_t reaped_count() const {
+        return my_reaped_count.load(std::memory_order_relaxed);
+    }
+
+    std::size_t expiration_index_size() {
+        return internal_expiration_index_size();
+    }
+
 private:
     class mount_info {
     public:
@@ -198,12 +248,36 @@ private:
         priority_type my_priority;
     };
 
+    using ptree_path_type = typename ptree::ptree::path_type;
+
+    using date_type = std::chrono::seconds::rep;
+
     class tom_info {
         using tree_allocator_type = typename allocator_traits_type::template rebind_alloc<ptree::ptree>;
         using tree_allocator_traits = std::allocator_traits<tree_allocator_type>;
+
+        // Node of the tom which becomes outdated after the deadline
+        // deadline is date_created + lifetime (in seconds since std::chrono::system_clock epoch)
+        struct expiration_entry {
+            date_type deadline;
+            path_type node_path;
+        }; // struct expiration_entry
+
+        struct later_expiration {
+            bool operator()( const expiration_entry& lhs, const expiration_entry& rhs ) const {
+                return lhs.deadline > rhs.deadline;
+            }
+        }; // struct later_expiration
+
+        using expiration_allocator_type = typename allocator_traits_type::template rebind_alloc<expiration_entry>;
+        // Min-heap by deadline
+        using expiration_index_type = std::priority_queue<expiration_entry,
+                                                          std::vector<expiration_entry, expiration_allocator_type>,
+                                                          later_expiration>;
     public:
         tom_info( const tom_id& t_id )
-            : my_tree(nullptr), my_tom_id(t_id), my_pending_readers(0), my_pending_writers(0) {}
+            : my_tree(nullptr), my_tom_id(t_id), my_pending_readers(0), my_pending_writers(0),
+              my_expiration_index_built(false), my_has_lifetimes(false) {}
 
         using lock_type = std::unique_lock<std::mutex>;
 
@@ -226,6 +300,13 @@ private:
             my_tree = tree_allocator_traits::allocate(alloc, 1);
             tree_allocator_traits::construct(alloc, my_tree);
             ptree::read_xml(my_tom_id, *my_tree);
+
+            // The index is kept up to date by the operations, it is rebuilt only if the file was modified externally
+            auto write_time = file_write_time();
+            if (!my_expiration_index_built || write_time != my_index_write_time) {
+                build_expiration_index();
+            }
+            my_index_write_time = write_time;
         }
 
         // Should be called when my_mutex is locked
@@ -240,14 +321,147 @@ private:
         void dump_tree() {
             __TOMKV_ASSERT(my_tree != nullptr);
             ptree::write_xml(my_tom_id, *my_tree);
+            my_index_write_time = file_write_time();
+        }
+
+        // Should be called when my_mutex is locked
+        void track_expiration( const path_type& node_path, date_type date_created, date_type lifetime ) {
+            my_expiration_index.push(expiration_entry{date_created + lifetime, node_path});
+            my_has_lifetimes = true;
+        }
+
+        // Should be called when my_mutex is locked
+        std::size_t expiration_index_size() const { return my_expiration_index.size(); }
+
+        // Should be called when my_mutex is locked
+        // Returns false if no node in the tree has a lifetime - lifetime checks can be skipped
+        // Set by track_expiration, reset only when the index is rebuilt after the external modification of the file
+        bool has_lifetimes() const { return my_has_lifetimes; }
+
+        // Should be called when my_mutex is locked
+        // Returns true if the index was never built or if the earliest tracked node is outdated
+        bool reaping_required( time_point now ) const {
+            return !my_expiration_index_built ||
+                   (!my_expiration_index.empty() && is_expired(my_expiration_index.top().deadline, now));
+        }
+
+        // Should be called when my_mutex is locked and the tree is created
+        // Physically removes all tracked outdated nodes from the tree
+        // Returns the number of removed nodes
+        std::size_t reap_outdated( time_point now ) {
+            __TOMKV_ASSERT(my_tree != nullptr);
+            std::size_t reaped = 0;
+
+            while (!my_expiration_index.empty() && is_expired(my_expiration_index.top().deadline, now)) {
+                path_type node_path = my_expiration_index.top().node_path;
+                my_expiration_index.pop();
+
+                auto node = my_tree->get_child_optional(ptree_path_type{node_path, '/'});
+                if (!node) {
+                    // Node was removed after it was tracked
+                    continue;
+                }
+
+                auto date_created = node->template get_optional<date_type>("date_created");
+                auto lifetime = node->template get_optional<date_type>("lifetime");
+
+                if (!date_created || !lifetime) {
+                    // Node was inserted without lifetime after it was tracked
+                    continue;
+                }
+
+                if (!is_expired(date_created.value() + lifetime.value(), now)) {
+                    // Node was modified as new after it was tracked
+                    // The renewal already tracked the current deadline
+                    continue;
+                }
+
+                if (has_child_nodes(*node)) {
+                    // Child nodes are still observable - remove only the key-value pair
+                    node->erase("key");
+                    node->erase("mapped");
+                    node->erase("date_created");
+                    node->erase("lifetime");
+                } else {
+                    auto delimiter = node_path.rfind('/');
+                    path_type path_to_prev_node(node_path, 0, delimiter);
+                    path_type curr_node_name(node_path, delimiter + 1);
+
+                    my_tree->get_child(ptree_path_type{path_to_prev_node, '/'}).erase(curr_node_name);
+                }
+                ++reaped;
+            }
+
+            return reaped;
         }
 
     private:
+        static bool is_expired( date_type deadline, time_point now ) {
+            return now > time_point(std::chrono::seconds(deadline));
+        }
+
+        static bool is_node_field( const std::string& name ) {
+            // Fields of the node and XML attributes/comments are not nodes
+            return name == "key" || name == "mapped" || name == "date_created" ||
+                   name == "lifetime" || (!name.empty() && name.front() == '<');
+        }
+
+        static bool has_child_nodes( const ptree::ptree& node ) {
+            return std::any_of(node.begin(), node.end(), []( const typename ptree::ptree::value_type& child ) {
+                return !is_node_field(child.first);
+            });
+        }
+
+        std::filesystem::file_time_type file_write_time() const {
+            std::error_code ec;
+            auto write_time = std::filesystem::last_write_time(my_tom_id, ec);
+            return ec ? std::filesystem::file_time_type::min() : write_time;
+        }
+
+        void build_expiration_index() {
+            my_expiration_index = expiration_index_type{};
+            my_has_lifetimes = false;
+
+            auto root = my_tree->get_child_optional(ptree_path_type{"tom/root", '/'});
+            if (root) {
+                path_type path = "tom/root";
+                index_subtree(*root, path);
+            }
+            my_expiration_index_built = true;
+        }
+
+        // The path of the subtree is extended in place for the child nodes and restored on return
+        void index_subtree( const ptree::ptree& subtree, path_type& subtree_path ) {
+            std::size_t subtree_path_size = subtree_path.size();
+            for (auto& child : subtree) {
+                if (is_node_field(child.first)) continue;
+
+                subtree_path.append(1, '/').append(child.first);
+
+                // Most of the nodes have no lifetime - date_created is not looked up for them
+                auto lifetime = child.second.find("lifetime");
+                if (lifetime != child.second.not_found()) {
+                    auto date_created = child.second.template get_optional<date_type>("date_created");
+                    auto lifetime_value = lifetime->second.template get_value_optional<date_type>();
+                    if (date_created && lifetime_value) {
+                        track_expiration(subtree_path, date_created.value(), lifetime_value.value());
+                    }
+                }
+                index_subtree(child.second, subtree_path);
+                subtree_path.resize(subtree_path_size);
+            }
+        }
+
         std::mutex my_mutex;
         ptree::ptree* my_tree; // Protected by my_mutex
-        const tom_id& my_tom_id;
+        const tom_id my_tom_id;
         std::atomic<std::size_t> my_pending_readers;
         std::atomic<std::size_t> my_pending_writers;
+        expiration_index_type my_expiration_index; // Protected by my_mutex
+        bool my_expiration_index_built; // Protected by my_mutex
+        // Modification time of the file when the index was last synchronized with it
+        std::filesystem::file_time_type my_index_write_time; // Protected by my_mutex
+        bool my_has_lifetimes; // Protected by my_mutex
     };
 
     class mount_node {
@@ -281,10 +495,6 @@ private:
     using mount_node_allocator_type = typename allocator_traits_type::template rebind_alloc<mount_node>;
     using mount_node_allocator_traits = std::allocator_traits<mount_node_allocator_type>;
 
-    using ptree_path_type = typename ptree::ptree::path_type;
-
-    using date_type = std::chrono::seconds::rep;
-
     mount_node* create_mount_node( const tom_id& t_id, const path_type& path,
                                    priority_type priority ) {
         mount_node_allocator_type mount_allocator(my_allocator);
@@ -309,9 +519,14 @@ private:
         mount_node* new_mount_node = create_mount_node(t_id, path, priority);
 
         // Add tom into tom table
-        my_tom_table.emplace(std::piecewise_construct,
-                             std::forward_as_tuple(t_id), // Args for key
-                             std::forward_as_tuple(t_id)); // Args for mapped
+        bool tom_inserted = my_tom_table.emplace(std::piecewise_construct,
+                                                 std::forward_as_tuple(t_id), // Args for key
+                                                 std::forward_as_tuple(t_id)); // Args for mapped
+        if (tom_inserted) {
+            // Register the tom to be visited by the reaper
+            std::lock_guard<std::mutex> lock(my_tom_ids_mutex);
+            my_tom_ids.push_back(t_id);
+        }
 
         mount_read_accessor mracc;
         bool inserted = my_mount_table.emplace(mracc, m_id, new_mount_node);
@@ -326,7 +541,7 @@ private:
         mount_node* expected = list.load(std::memory_order_acquire);
         new_mount_node->set_next(expected);
 
-        utils::exponential_backoff backoff;
+        utils::spin_backoff backoff;
 
         while(!list.compare_exchange_weak(expected, new_mount_node,
                                           std::memory_order_relaxed,
@@ -375,45 +590,26 @@ private:
         return mounts;
     }
 
-    mount_read_accessor split_and_find_impl( path_type& mount_path, path_type& path ) {
-        if (path.empty()) {
-            throw unmounted_path{};
-        }
-
-        path_type additional_path;
-        additional_path.reserve(path.size());
+    // Searches the mount points for the prefixes of the path, which end before each delimiter (/), and for the whole path
+    // The found mount point and the following delimiter are cut from the beginning of the path
+    mount_read_accessor split_and_find( path_type& path ) {
+        std::string_view full_path = path;
+        mount_read_accessor mracc;
 
-        path_type::const_iterator it;
-        for (it = path.cbegin(); it != path.cend(); ++it) {
-            if (*it == '/') {
-                break;
+        for (auto pos = full_path.find('/'); pos != std::string_view::npos; pos = full_path.find('/', pos + 1)) {
+            if (my_mount_table.find(mracc, full_path.substr(0, pos))) {
+                // Mounting successfully found
+                path.erase(0, pos + 1);
+                return mracc;
             }
         }
 
-        // Split path into something before the first delimiter (/)
-        // and other characters
-        mount_path.append(path.cbegin(), it);
-        if (it != path.cend()) {
-            additional_path.append(std::next(it), path.cend());
-        }
-
-        path = std::move(additional_path);
-
-        mount_read_accessor mracc;
-
-        if (my_mount_table.find(mracc, mount_path)) {
-            // Mounting successfully found
+        // The path which ends with the delimiter has no additional part
+        if (!full_path.empty() && full_path.back() != '/' && my_mount_table.find(mracc, full_path)) {
+            path.clear();
             return mracc;
         }
-        // Mounting was not found
-        mount_path.append("/"); // Add a delimiter
-        return split_and_find_impl(mount_path, path);
-    }
-
-    mount_read_accessor split_and_find( path_type& path ) {
-        path_type mount_path;
-        mount_path.reserve(path.size());
-        return split_and_find_impl(mount_path, path);
+        throw unmounted_path{};
     }
 
     template <bool IsWriteOperation, typename Body, typename... AdditionalArgs>
@@ -470,7 +666,14 @@ private:
                 node_path.append(additional_path);
             }
 
-            body(node_path, t_info.tree(), curr_mount_node->priority(), std::forward<AdditionalArgs>(additional_args)...);
+            // Lifetime checks are compiled out for the toms without lifetimes
+            if (t_info.has_lifetimes()) {
+                body(node_path, t_info, curr_mount_node->priority(), my_clock.now(), std::true_type{},
+                     std::forward<AdditionalArgs>(additional_args)...);
+            } else {
+                body(node_path, t_info, curr_mount_node->priority(), my_clock.now(), std::false_type{},
+                     std::forward<AdditionalArgs>(additional_args)...);
+            }
 
             // Operation completed
             if constexpr (IsWriteOperation) {
@@ -488,24 +691,36 @@ private:
         }
     }
 
+    // Returns true if the node on the node_path has the lifetime which is over at the moment now
+    // Does not access the tree if no node in the tom has a lifetime
+    template <bool HasLifetimes>
+    static bool is_outdated( ptree::ptree* tree, const path_type& node_path, time_point now,
+                             std::bool_constant<HasLifetimes> )
+    {
+        if constexpr (HasLifetimes) {
+            auto date_created = tree->template get_optional<date_type>(ptree_path_type{node_path + "/date_created", '/'});
+            auto lifetime = tree->template get_optional<date_type>(ptree_path_type{node_path + "/lifetime", '/'});
+
+            return date_created && lifetime &&
+                   (now - std::chrono::seconds(lifetime.value())) > time_point(std::chrono::seconds(date_created.value()));
+        } else {
+            utils::suppress_unused(tree, node_path, now);
+            return false;
+        }
+    }
+
+    static date_type to_date( time_point now ) {
+        return std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch()).count();
+    }
+
     std::unordered_multiset<key_type> internal_key( const path_type& path ) {
         std::unordered_multimap<key_type, priority_type> keys_with_priority;
 
-        auto body = []( const path_type& node_path, ptree::ptree* tree, priority_type current_priority,
+        auto body = []( const path_type& node_path, tom_info& t_info, priority_type current_priority, time_point now, auto has_lifetimes,
                         std::unordered_multimap<key_type, priority_type>& key_priority_map ) {
+            ptree::ptree* tree = t_info.tree();
             try {
-                auto date_created = tree->template get_optional<date_type>(ptree_path_type{node_path + "/date_created", '/'});
-                auto lifetime = tree->template get_optional<date_type>(ptree_path_type{node_path + "/lifetime", '/'});
-
-                bool is_outdated = false;
-
-                // If the lifetime for the key is presented
-                if (date_created && lifetime) {
-                    is_outdated = (std::chrono::system_clock::now() - std::chrono::seconds(lifetime.value())) >
-                                  std::chrono::system_clock::time_point(std::chrono::seconds(date_created.value()));
-                }
-
-                if (!is_outdated) {
+                if (!is_outdated(tree, node_path, now, has_lifetimes)) {
                     key_type key_from_tom = tree->template get<key_type>(ptree_path_type{node_path + "/key", '/'});
 
                     auto eq_range = key_priority_map.equal_range(key_from_tom);
@@ -542,22 +757,12 @@ private:
     std::unordered_multimap<key_type, std::pair<mapped_type, priority_type>> internal_value_read( const path_type& path ) {
         std::unordered_multimap<key_type, std::pair<mapped_type, priority_type>> keys_with_priority;
 
-        auto body = []( const path_type& node_path, ptree::ptree* tree,
-                        priority_type current_priority,
+        auto body = []( const path_type& node_path, tom_info& t_info,
+                        priority_type current_priority, time_point now, auto has_lifetimes,
                         std::unordered_multimap<key_type, std::pair<mapped_type, priority_type>>& key_priority_map ) {
+            ptree::ptree* tree = t_info.tree();
             try {
-                auto date_created = tree->template get_optional<date_type>(ptree_path_type{node_path + "/date_created", '/'});
-                auto lifetime = tree->template get_optional<date_type>(ptree_path_type{node_path + "/lifetime", '/'});
-
-                bool is_outdated = false;
-
-                // If the lifetime for the key is presented
-                if (date_created && lifetime) {
-                    is_outdated = (std::chrono::system_clock::now() - std::chrono::seconds(lifetime.value())) >
-                                  std::chrono::system_clock::time_point(std::chrono::seconds(date_created.value()));
-                }
-
-                if (!is_outdated) {
+                if (!is_outdated(tree, node_path, now, has_lifetimes)) {
                     key_type key_from_tom = tree->template get<key_type>(ptree_path_type{node_path + "/key", '/'});
                     mapped_type mapped_from_tom = tree->template get<mapped_type>(ptree_path_type{node_path + "/mapped", '/'});
 
@@ -613,33 +818,40 @@ private:
         return umap;
     }
 
+    // If the node is considered as new - modify the time created as current time
+    template <bool HasLifetimes>
+    static void renew_node( tom_info& t_info, const path_type& node_path, time_point now,
+                            std::bool_constant<HasLifetimes> )
+    {
+        ptree::ptree* tree = t_info.tree();
+        date_type date_created = to_date(now);
+        tree->put(ptree_path_type{node_path + "/date_created", '/'}, date_created);
+
+        if constexpr (HasLifetimes) {
+            auto lifetime = tree->template get_optional<date_type>(ptree_path_type{node_path + "/lifetime", '/'});
+            if (lifetime) {
+                // The node becomes outdated later than it was tracked before
+                t_info.track_expiration(node_path, date_created, lifetime.value());
+            }
+        }
+    }
+
     template <bool AsNew, typename Predicate>
     std::size_t basic_modify_key( const path_type& path, const Predicate& pred ) {
         std::size_t modified_keys_counter = 0;
 
-        auto body = [&modified_keys_counter, &pred]( const path_type& node_path, ptree::ptree* tree,
-                                                     priority_type ) {
+        auto body = [&modified_keys_counter, &pred]( const path_type& node_path, tom_info& t_info,
+                                                     priority_type, time_point now, auto has_lifetimes ) {
+            ptree::ptree* tree = t_info.tree();
             try {
-                bool modification_allowed = true;
-                if constexpr (!AsNew) {
-                    auto date_created = tree->template get_optional<date_type>(ptree_path_type{node_path + "/date_created", '/'});
-                    auto lifetime = tree->template get_optional<date_type>(ptree_path_type{node_path + "/lifetime", '/'});
-
-                    if (date_created && lifetime) {
-                        modification_allowed = (std::chrono::system_clock::now() - std::chrono::seconds(lifetime.value())) <=
-                                               std::chrono::system_clock::time_point(std::chrono::seconds(date_created.value()));
-                    }
-                }
-
-                if (modification_allowed) {
+                // Outdated nodes can be modified only as new
+                if (AsNew || !is_outdated(tree, node_path, now, has_lifetimes)) {
                     auto path_to_key = ptree_path_type{node_path + "/key", '/'};
                     key_type key_from_tom = tree->template get<key_type>(path_to_key); // Throws in case of invalid path
                     tree->put(path_to_key, pred(key_from_tom));
 
                     if constexpr (AsNew) {
-                        // If the key is considered as new - modify the time created as current time
-                        tree->put(ptree_path_type{node_path + "/date_created", '/'},
-                                std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+                        renew_node(t_info, node_path, now, has_lifetimes);
                     }
 
                     ++modified_keys_counter;
@@ -666,30 +878,18 @@ private:
     std::size_t basic_modify_mapped( const path_type& path, const Predicate& pred ) {
         std::size_t modified_mapped_counter = 0;
 
-        auto body = [&modified_mapped_counter, &pred]( const path_type& node_path, ptree::ptree* tree,
-                                                       priority_type ) {
+        auto body = [&modified_mapped_counter, &pred]( const path_type& node_path, tom_info& t_info,
+                                                       priority_type, time_point now, auto has_lifetimes ) {
+            ptree::ptree* tree = t_info.tree();
             try {
-                bool modification_allowed = true;
-
-                if constexpr (!AsNew) {
-                    auto date_created = tree->template get_optional<date_type>(ptree_path_type{node_path + "/date_created", '/'});
-                    auto lifetime = tree->template get_optional<date_type>(ptree_path_type{node_path + "/lifetime", '/'});
-
-                    if (date_created && lifetime) {
-                        modification_allowed = (std::chrono::system_clock::now() - std::chrono::seconds(lifetime.value())) <=
-                                               std::chrono::system_clock::time_point(std::chrono::seconds(date_created.value()));
-                    }
-                }
-
-                if (modification_allowed) {
+                // Outdated nodes can be modified only as new
+                if (AsNew || !is_outdated(tree, node_path, now, has_lifetimes)) {
                     auto path_to_mapped = ptree_path_type{node_path + "/mapped", '/'};
                     mapped_type mapped_from_tom = tree->template get<mapped_type>(path_to_mapped); // Throws in case of invalid path
                     tree->put(path_to_mapped, pred(mapped_from_tom));
 
                     if constexpr (AsNew) {
-                        // If the key is considered as new - modify the time created as current time
-                        tree->put(ptree_path_type{node_path + "/date_created", '/'},
-                                std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+                        renew_node(t_info, node_path, now, has_lifetimes);
                     }
 
                     ++modified_mapped_counter;
@@ -716,21 +916,12 @@ private:
     std::size_t basic_modify_value( const path_type& path, const Predicate& pred ) {
         std::size_t modified_value_counter = 0;
 
-        auto body = [&modified_value_counter, &pred]( const path_type& node_path, ptree::ptree* tree,
-                                                      priority_type ) {
+        auto body = [&modified_value_counter, &pred]( const path_type& node_path, tom_info& t_info,
+                                                      priority_type, time_point now, auto has_lifetimes ) {
+            ptree::ptree* tree = t_info.tree();
             try {
-                bool modification_allowed = true;
-                if constexpr (!AsNew) {
-                    auto date_created = tree->template get_optional<date_type>(ptree_path_type{node_path + "/date_created", '/'});
-                    auto lifetime = tree->template get_optional<date_type>(ptree_path_type{node_path + "/lifetime", '/'});
-
-                    if (date_created && lifetime) {
-                        modification_allowed = (std::chrono::system_clock::now() - std::chrono::seconds(lifetime.value())) <=
-                                               std::chrono::system_clock::time_point(std::chrono::seconds(date_created.value()));
-                    }
-                }
-
-                if (modification_allowed) {
+                // Outdated nodes can be modified only as new
+                if (AsNew || !is_outdated(tree, node_path, now, has_lifetimes)) {
                     auto path_to_key = ptree_path_type{node_path + "/key", '/'};
                     // We can only check the path validity for key path
                     key_type key_from_tom = tree->template get<key_type>(path_to_key);
@@ -740,9 +931,7 @@ private:
                     tree->put(ptree_path_type{node_path + "/mapped", '/'}, modified_value.second);
 
                     if constexpr (AsNew) {
-                        // If the key is considered as new - modify the time created as current time
-                        tree->put(ptree_path_type{node_path + "/date_created", '/'},
-                                std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+                        renew_node(t_info, node_path, now, has_lifetimes);
                     }
 
                     ++modified_value_counter;
@@ -770,38 +959,26 @@ private:
     {
         bool inserted = false;
 
-        auto body = [&]( const path_type& node_path, ptree::ptree* tree,
-                         priority_type, const value_type& value ) {
+        auto body = [&]( const path_type& node_path, tom_info& t_info,
+                         priority_type, time_point now, auto has_lifetimes, const value_type& value ) {
+            ptree::ptree* tree = t_info.tree();
             auto path_to_key = ptree_path_type{node_path + "/key", '/'};
             // Check if the path is already in a tree
             auto key = tree->template get_optional<key_type>(path_to_key);
 
-            bool insertion_allowed = true;
-            if (key) {
-                // Key exists
-                // But may be outdated
-                auto date_created = tree->template get_optional<date_type>(ptree_path_type{node_path + "/date_created", '/'});
-                auto lifetime = tree->template get_optional<date_type>(ptree_path_type{node_path + "/lifetime", '/'});
-
-                if (date_created && lifetime) {
-                    // If the key is outdated - insertion is allowed
-                    insertion_allowed = (std::chrono::system_clock::now() - std::chrono::seconds(lifetime.value())) >
-                                         std::chrono::system_clock::time_point(std::chrono::seconds(date_created.value()));
-                } else {
-                    // Key exists and not outdated - insertion is not allowed
-                    insertion_allowed = false;
-                }
-            }
+            // If the key exists, but outdated - insertion is allowed
+            bool insertion_allowed = !key || is_outdated(tree, node_path, now, has_lifetimes);
 
             if (insertion_allowed) {
                 tree->put(path_to_key, value.first);
                 tree->put(ptree_path_type{node_path + "/mapped", '/'}, value.second);
                 if (lifetime_ptr != nullptr) {
-                    tree->put(ptree_path_type{node_path + "/date_created", '/'},
-                              std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+                    date_type date_created = to_date(now);
+                    tree->put(ptree_path_type{node_path + "/date_created", '/'}, date_created);
                     tree->put(ptree_path_type{node_path + "/lifetime", '/'},
                               lifetime_ptr->count());
-                } else {
+                    t_info.track_expiration(node_path, date_created, lifetime_ptr->count());
+                } else if constexpr (decltype(has_lifetimes)::value) {
                     // Remove lifetime if any
                     tree->get_child(ptree_path_type{node_path, '/'}).erase("lifetime");
                 }
@@ -825,29 +1002,15 @@ private:
 
     bool internal_remove( const path_type& path ) {
         bool erased = false;
-        auto body = [&]( const path_type& node_path, ptree::ptree* tree, priority_type ) {
+        auto body = [&]( const path_type& node_path, tom_info& t_info, priority_type, time_point now, auto has_lifetimes ) {
+            ptree::ptree* tree = t_info.tree();
             auto path_to_key = ptree_path_type{node_path + "/key", '/'};
             // Check if the path exists
 
             auto key = tree->template get_optional<key_type>(path_to_key);
 
-            bool erasure_allowed = false;
-
-            if (key) {
-                // Key exists
-                // But may be outdated
-                auto date_created = tree->template get_optional<date_type>(ptree_path_type{node_path + "/date_created", '/'});
-                auto lifetime = tree->template get_optional<date_type>(ptree_path_type{node_path + "/lifetime", '/'});
-
-                if (date_created && lifetime) {
-                    // If the key is outdated - erasure is not allowed
-                    erasure_allowed = (std::chrono::system_clock::now() - std::chrono::seconds(lifetime.value())) <=
-                                      std::chrono::system_clock::time_point(std::chrono::seconds(date_created.value()));
-                } else {
-                    // Key exists and not outdated - insertion is allowed
-                    erasure_allowed = true;
-                }
-            }
+            // If the key is outdated - erasure is not allowed
+            bool erasure_allowed = key && !is_outdated(tree, node_path, now, has_lifetimes);
 
             if (erasure_allowed) {
                 // Cutting the last element after the delimiter
@@ -869,6 +1032,117 @@ private:
         return erased;
     }
 
+    std::size_t reap_tom( const tom_id& t_id ) {
+        tom_read_accessor tracc;
+        bool found = my_tom_table.find(tracc, t_id);
+        __TOMKV_ASSERT(found);
+        utils::suppress_unused(found);
+
+        tom_info& t_info = tracc.hazardous_mapped();
+
+        // Reaping modifies the tree - act as a write operation
+        t_info.add_pending_writer();
+        auto lock = t_info.lock();
+        t_info.remove_pending_writer();
+
+        time_point now = my_clock.now();
+
+        if (!t_info.reaping_required(now)) {
+            // No outdated nodes are tracked - the tree should not be read
+            return 0;
+        }
+
+        // Read a tree from XML if it was not done already by an other thread
+        // The expiration index is built while reading
+        if (t_info.tree() == nullptr) {
+            t_info.create_tree(my_allocator);
+        }
+
+        std::size_t reaped = t_info.reap_outdated(now);
+
+        // If there are pending write operations - the tom would be dumped by the last of them
+        if (reaped != 0 && t_info.pending_writers() == 0) {
+            t_info.dump_tree();
+        }
+
+        if (t_info.pending_readers() == 0 && t_info.pending_writers() == 0) {
+            // If no pending read/write operations - destroy the tree
+            t_info.destroy_tree(my_allocator);
+        }
+        return reaped;
+    }
+
+    std::size_t internal_reap_outdated() {
+        std::vector<tom_id> tom_ids;
+        {
+            std::lock_guard<std::mutex> lock(my_tom_ids_mutex);
+            tom_ids = my_tom_ids;
+        }
+
+        std::size_t reaped = 0;
+        for (auto& t_id : tom_ids) {
+            reaped += reap_tom(t_id);
+        }
+
+        my_reaped_count.fetch_add(reaped, std::memory_order_relaxed);
+        return reaped;
+    }
+
+    std::size_t internal_expiration_index_size() {
+        std::vector<tom_id> tom_ids;
+        {
+            std::lock_guard<std::mutex> lock(my_tom_ids_mutex);
+            tom_ids = my_tom_ids;
+        }
+
+        std::size_t size = 0;
+        for (auto& t_id : tom_ids) {
+            tom_read_accessor tracc;
+            if (my_tom_table.find(tracc, t_id)) {
+                tom_info& t_info = tracc.hazardous_mapped();
+                auto lock = t_info.lock();
+                size += t_info.expiration_index_size();
+            }
+        }
+        return size;
+    }
+
+    void internal_start_reaper( const std::chrono::milliseconds& period ) {
+        std::lock_guard<std::mutex> lock(my_reaper_mutex);
+
+        if (my_reaper_thread.joinable()) {
+            // Reaper is already running
+            return;
+        }
+
+        my_reaper_stop_flag = false;
+        my_reaper_thread = std::thread([this, period] {
+            std::unique_lock<std::mutex> reaper_lock(my_reaper_mutex);
+
+            while (!my_reaper_cv.wait_for(reaper_lock, period, [this] { return my_reaper_stop_flag; })) {
+                reaper_lock.unlock();
+                try {
+                    internal_reap_outdated();
+                } catch( ptree::ptree_error& ) {} // Tom is unavailable - try again on the next period
+                reaper_lock.lock();
+            }
+        });
+    }
+
+    void internal_stop_reaper() {
+        std::thread reaper;
+        {
+            std::lock_guard<std::mutex> lock(my_reaper_mutex);
+            my_reaper_stop_flag = true;
+            reaper = std::move(my_reaper_thread);
+        }
+        my_reaper_cv.notify_all();
+
+        if (reaper.joinable()) {
+            reaper.join();
+        }
+    }
+
     void internal_destroy() {
         my_mount_table.for_each([&]( typename mount_hash_table::value_type& value ) {
             mount_node* node = value.second.load(std::memory_order_relaxed);
@@ -882,15 +1156,28 @@ private:
     }
 
     allocator_type                      my_allocator;
+    clock_type                          my_clock;
     id_hasher                           my_hasher;
     id_equality                         my_id_equality;
     mount_hash_table                    my_mount_table;
     tom_hash_table                      my_tom_table;
+
+    std::mutex                          my_tom_ids_mutex;
+    std::vector<tom_id>                 my_tom_ids; // Protected by my_tom_ids_mutex
+    std::atomic<std::size_t>            my_reaped_count;
+
+    std::mutex                          my_reaper_mutex;
+    std::condition_variable             my_reaper_cv;
+    bool                                my_reaper_stop_flag; // Protected by my_reaper_mutex
+    std::thread                         my_reaper_thread;
 }; // class storage
 } // namespace internal
 
 using internal::storage;
 using internal::unmounted_path;
+using internal::precise_clock;
+using internal::coarse_clock;
+using internal::manual_clock;
 
 } // namespace tomkv
 
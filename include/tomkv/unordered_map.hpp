@@ -26,6 +26,7 @@
 #define __TOMKV_INCLUDE_HASH_TABLE_HPP
 
 #include "internal/hash_table.hpp"
+#include <iterator>
 
 namespace tomkv {
 namespace internal {
@@ -37,14 +38,28 @@ struct unordered_map_base {
     Allocator my_value_allocator;
 }; // class unordered_map_base
 
+// Excludes the range constructors from the overload resolution for the non-iterator types
+template <typename Iterator>
+using require_input_iterator = std::enable_if_t<std::is_base_of_v<std::input_iterator_tag,
+                                                                  typename std::iterator_traits<Iterator>::iterator_category>>;
+
 template <typename Key, typename Mapped,
           typename Hash = std::hash<Key>,
           typename KeyEqual = std::equal_to<Key>,
-          typename Allocator = std::allocator<std::pair<const Key, Mapped>>>
-class unordered_map : public unordered_map_base<Hash, KeyEqual, Allocator>, public hash_table<Key, Mapped, Hash, KeyEqual, Allocator> {
+          typename Allocator = std::allocator<std::pair<const Key, Mapped>>,
+          typename LockingPolicy = per_bucket_locking>
+class unordered_map : public unordered_map_base<Hash, KeyEqual, Allocator>,
+                      public hash_table<Key, Mapped, Hash, KeyEqual, Allocator, LockingPolicy> {
     using unordered_base_type = unordered_map_base<Hash, KeyEqual, Allocator>;
-    using hash_table_base_type = hash_table<Key, Mapped, Hash, KeyEqual, Allocator>;
+    using hash_table_base_type = hash_table<Key, Mapped, Hash, KeyEqual, Allocator, LockingPolicy>;
 public:
+    using size_type = typename hash_table_base_type::size_type;
+
+    // Buckets are allocated at once, so the table does not grow until the number of elements exceeds bc
+    unordered_map( size_type bc, const Hash& hash = Hash(), const KeyEqual& equal = KeyEqual(), const Allocator& alloc = Allocator() )
+        : unordered_base_type{hash, equal, alloc},
+          hash_table_base_type(bc, this->my_key_hasher, this->my_key_equality, this->my_value_allocator) {}
+
     unordered_map( const Hash& hash = Hash(), const KeyEqual& equal = KeyEqual(), const Allocator& alloc = Allocator() )
         : unordered_base_type{hash, equal, alloc},
           hash_table_base_type(this->my_key_hasher, this->my_key_equality, this->my_value_allocator) {}
@@ -55,6 +70,23 @@ public:
     unordered_map( const Allocator& alloc )
         : unordered_map(Hash(), alloc) {}
 
+    template <typename InputIterator, typename = require_input_iterator<InputIterator>>
+    unordered_map( InputIterator first, InputIterator last,
+                   const Hash& hash = Hash(), const KeyEqual& equal = KeyEqual(), const Allocator& alloc = Allocator() )
+        : unordered_map(hash, equal, alloc)
+    {
+        this->insert(first, last);
+    }
+
+    // The elements are inserted by several threads
+    template <typename InputIterator, typename = require_input_iterator<InputIterator>>
+    unordered_map( InputIterator first, InputIterator last, const parallel_policy& policy,
+                   const Hash& hash = Hash(), const KeyEqual& equal = KeyEqual(), const Allocator& alloc = Allocator() )
+        : unordered_map(hash, equal, alloc)
+    {
+        this->insert(first, last, policy);
+    }
+
     unordered_map( const unordered_map& other )
         : unordered_map(other, std::allocator_traits<Allocator>::select_on_container_copy_construction(other.my_value_allocator)) {}
 
@@ -68,7 +100,8 @@ public:
     unordered_map( unordered_map&& other )
         : unordered_base_type{std::move(other.my_key_hasher), std::move(other.my_key_equality),
                               std::move(other.my_value_allocator)},
-          hash_table_base_type(other.bucket_count(), this->my_key_hasher, this->my_key_equality, this->my_value_allocator)
+          // The buckets are stolen from other - allocate only the initial ones to leave to other
+          hash_table_base_type(this->my_key_hasher, this->my_key_equality, this->my_value_allocator)
     {
         hash_table_base_type::internal_move(std::move(other));
     }
@@ -110,6 +143,13 @@ public:
 } // namespace internal
 
 using internal::unordered_map;
+using internal::per_bucket_locking;
+using internal::striped_locking;
+using internal::parallel_policy;
+using internal::snapshot_error;
+using internal::snapshot_traits;
+using internal::hash_table_statistics;
+using internal::duration_histogram;
 
 } // namespace tomkv
 
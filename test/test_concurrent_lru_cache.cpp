@@ -0,0 +1,170 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Konstantin Boyarinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include "doctest.h"
+#include "utils.hpp"
+#include "tomkv/concurrent_lru_cache.hpp"
+#include <vector>
+#include <thread>
+#include <string>
+#include <atomic>
+#include <stdexcept>
+
+TEST_CASE("test serial operations") {
+    tomkv::concurrent_lru_cache<int, std::string> cache(100);
+    REQUIRE_MESSAGE(cache.capacity() == 100, "Incorrect capacity");
+    REQUIRE_MESSAGE(cache.empty(), "Cache should be empty after construction");
+
+    REQUIRE_MESSAGE(cache.try_emplace(1, "1"), "Element should be inserted");
+    REQUIRE_MESSAGE(!cache.try_emplace(1, "one"), "Duplicate should not be inserted");
+    REQUIRE_MESSAGE(cache.find(1) == std::string("1"), "Duplicate should not change the element");
+
+    REQUIRE_MESSAGE(!cache.insert_or_assign(1, std::string("one")), "Existing element should be assigned");
+    REQUIRE_MESSAGE(cache.find(1) == std::string("one"), "Incorrect assigned value");
+    REQUIRE_MESSAGE(cache.insert_or_assign(2, std::string("2")), "Element should be inserted");
+    REQUIRE_MESSAGE(cache.size() == 2, "Incorrect size");
+
+    REQUIRE_MESSAGE(!cache.find(3), "Missing element should not be found");
+    REQUIRE_MESSAGE(cache.hit_count() == 2, "Incorrect number of hits");
+    REQUIRE_MESSAGE(cache.miss_count() == 1, "Incorrect number of misses");
+    REQUIRE_MESSAGE(cache.contains(2), "Element should be contained");
+    REQUIRE_MESSAGE(!cache.contains(3), "Missing element should not be contained");
+    REQUIRE_MESSAGE(cache.hit_count() + cache.miss_count() == 3, "contains should not change the counters");
+
+    REQUIRE_MESSAGE(cache.erase(1), "Element should be erased");
+    REQUIRE_MESSAGE(!cache.erase(1), "Element should be erased once");
+    REQUIRE_MESSAGE(!cache.contains(1), "Erased element should not be found");
+    REQUIRE_MESSAGE(cache.eviction_count() == 0, "Erasure is not an eviction");
+
+    cache.clear();
+    REQUIRE_MESSAGE(cache.empty(), "Cache should be empty after clear");
+    REQUIRE_MESSAGE(cache.try_emplace(1, "1"), "Element should be inserted after clear");
+
+    using cache_type = tomkv::concurrent_lru_cache<int, std::string>;
+    REQUIRE_THROWS_AS(cache_type(0), std::invalid_argument);
+}
+
+TEST_CASE("test eviction") {
+    constexpr int capacity = 10;
+    std::vector<std::pair<int, std::string>> evicted;
+    tomkv::concurrent_lru_cache<int, std::string> cache(capacity, [&evicted]( const int& key, std::string&& value ) {
+        evicted.emplace_back(key, std::move(value));
+    });
+    REQUIRE_MESSAGE(cache.shard_count() == 1, "Small cache should not be sharded");
+
+    for (int i = 0; i < capacity; ++i) {
+        cache.try_emplace(i, std::to_string(i));
+    }
+    REQUIRE_MESSAGE(evicted.empty(), "Nothing should be evicted before the cache is full");
+
+    // Recently used elements survive the eviction
+    for (int i = 0; i < capacity / 2; ++i) {
+        REQUIRE(cache.find(i).has_value());
+    }
+    for (int i = capacity; i < capacity + capacity / 2; ++i) {
+        cache.try_emplace(i, std::to_string(i));
+        REQUIRE_MESSAGE(cache.size() == std::size_t(capacity), "Size should not exceed the capacity");
+    }
+
+    REQUIRE_MESSAGE(evicted.size() == std::size_t(capacity / 2), "Incorrect number of evictions");
+    REQUIRE_MESSAGE(cache.eviction_count() == std::size_t(capacity / 2), "Incorrect eviction counter");
+    for (auto& e : evicted) {
+        REQUIRE_MESSAGE(e.first >= capacity / 2, "Recently used element should not be evicted");
+        REQUIRE_MESSAGE(e.second == std::to_string(e.first), "Evicted value should be passed to the callback");
+        REQUIRE_MESSAGE(!cache.contains(e.first), "Evicted element should not be found");
+    }
+    for (int i = 0; i < capacity / 2; ++i) {
+        REQUIRE_MESSAGE(cache.contains(i), "Recently used element should be in the cache");
+    }
+
+    // Erased slots are reused without the eviction
+    cache.erase(0);
+    cache.try_emplace(100, "100");
+    REQUIRE_MESSAGE(evicted.size() == std::size_t(capacity / 2), "Free slot should be reused");
+}
+
+TEST_CASE("test parallel operations") {
+    constexpr std::size_t capacity = 10000;
+    constexpr std::size_t n_threads = 8;
+    constexpr int n_keys = 40000;
+
+    std::atomic<std::size_t> evicted{0};
+    std::atomic<std::size_t> erased{0};
+    tomkv::concurrent_lru_cache<int, int> cache(capacity, [&evicted]( const int& key, int&& value ) {
+        if (key == value) {
+            evicted.fetch_add(1);
+        }
+    });
+
+    std::vector<std::thread> thread_pool;
+    for (std::size_t t = 0; t < n_threads; ++t) {
+        thread_pool.emplace_back([&cache, &erased, t] {
+            for (int i = int(t); i < n_keys; i += int(n_threads)) {
+                // Hot keys are looked up by all of the threads
+                cache.find(i % 100);
+                if (!cache.find(i)) {
+                    cache.try_emplace(i, i);
+                }
+                // The element may be already evicted by the other thread
+                if (i % 7 == 0 && cache.erase(i)) {
+                    erased.fetch_add(1);
+                }
+            }
+        });
+    }
+    for (auto& thr : thread_pool) {
+        thr.join();
+    }
+
+    REQUIRE_MESSAGE(cache.size() <= capacity, "Size should not exceed the capacity");
+    REQUIRE_MESSAGE(evicted.load() == cache.eviction_count(), "Callback should be called for each eviction");
+    REQUIRE_MESSAGE(cache.hit_count() + cache.miss_count() == 2 * std::size_t(n_keys), "Each lookup should be counted");
+    REQUIRE_MESSAGE(cache.size() + cache.eviction_count() + erased.load() == std::size_t(n_keys), "Each element should be either cached, evicted or erased");
+}
+
+TEST_CASE("test memory leaks") {
+    using cache_type = tomkv::concurrent_lru_cache<int, std::string, std::hash<int>, std::equal_to<int>,
+                                                   utils::counting_allocator<std::pair<const int, std::string>>>;
+
+    utils::counting_allocator<std::pair<const int, std::string>> count_alloc;
+
+    {
+    cache_type cache(1000, cache_type::eviction_callback(), std::hash<int>(), std::equal_to<int>(), count_alloc);
+
+    for (int i = 0; i < 10000; ++i) {
+        cache.try_emplace(i, std::to_string(i));
+    }
+    for (int i = 9000; i < 9500; ++i) {
+        cache.erase(i);
+    }
+    } // cache is destroyed here
+
+    REQUIRE_MESSAGE(count_alloc.elements_allocated != 0, "Incorrect test setup");
+    REQUIRE_MESSAGE(count_alloc.allocations == count_alloc.deallocations, "Memory leak: number of allocate and deallocate calls should be equal");
+    REQUIRE_MESSAGE(count_alloc.elements_constructed == count_alloc.elements_destroyed,
+                    "Memory leak: number of elements constructed and the number of elements destroyed should be equal");
+    count_alloc.reset();
+}
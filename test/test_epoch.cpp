@@ -0,0 +1,219 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Konstantin Boyarinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include "tomkv/internal/epoch.hpp"
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+using epoch_domain = tomkv::internal::epoch_domain;
+
+struct tracked_object {
+    static constexpr std::uint64_t alive = 0xA11CE;
+    static std::atomic<std::size_t> destroyed;
+
+    tracked_object( std::uint64_t v ) : value(v), canary(alive) {}
+
+    ~tracked_object() {
+        canary = 0;
+        ++destroyed;
+    }
+
+    std::uint64_t value;
+    std::uint64_t canary;
+};
+
+std::atomic<std::size_t> tracked_object::destroyed{0};
+
+// Each collection advances the epoch at most once, the object is reclaimed two epochs after the retirement
+void collect_all( epoch_domain& domain ) {
+    for (int i = 0; i < 3; ++i) {
+        domain.collect();
+    }
+}
+
+TEST_CASE("test retire and collect") {
+    epoch_domain domain;
+    tracked_object::destroyed = 0;
+
+    for (std::uint64_t i = 0; i < 10; ++i) {
+        domain.retire(new tracked_object(i));
+    }
+    REQUIRE_MESSAGE(domain.retired_count() == 10, "Objects should not be reclaimed before the collection");
+
+    collect_all(domain);
+    REQUIRE_MESSAGE(tracked_object::destroyed == 10, "Objects should be reclaimed if no thread is pinned");
+    REQUIRE_MESSAGE(domain.retired_count() == 0, "Limbo list should be empty after the reclamation");
+
+    // The collection is amortized over the retirements
+    for (std::uint64_t i = 0; i < 1000; ++i) {
+        domain.retire(new tracked_object(i));
+    }
+    REQUIRE_MESSAGE(domain.retired_count() < 1000, "Objects should be reclaimed periodically");
+
+    // Deleter with the context
+    std::size_t deleted = 0;
+    std::uint64_t object = 0;
+    domain.retire(&object, []( void* context, void* ) { ++*static_cast<std::size_t*>(context); }, &deleted);
+    collect_all(domain);
+    REQUIRE_MESSAGE(deleted == 1, "Deleter should be called once");
+
+    // Deleter may retire other objects
+    domain.retire(&domain, []( void*, void* d ) { static_cast<epoch_domain*>(d)->retire(new tracked_object(0)); }, nullptr);
+    tracked_object::destroyed = 0;
+    collect_all(domain);
+    collect_all(domain);
+    REQUIRE_MESSAGE(tracked_object::destroyed == 1, "Object retired by the deleter should be reclaimed");
+}
+
+TEST_CASE("test pinned threads") {
+    epoch_domain domain;
+    tracked_object::destroyed = 0;
+
+    std::atomic<int> stage{0};
+    std::thread reader([&] {
+        epoch_domain::guard outer{domain};
+        {
+            // The nested guard does not unpin the thread
+            epoch_domain::guard inner{domain};
+        }
+        stage.store(1);
+        while (stage.load() != 2) {
+            std::this_thread::yield();
+        }
+    });
+
+    while (stage.load() != 1) {
+        std::this_thread::yield();
+    }
+    domain.retire(new tracked_object(0));
+    collect_all(domain);
+    REQUIRE_MESSAGE(tracked_object::destroyed == 0, "Object should not be reclaimed while the other thread is pinned");
+
+    stage.store(2);
+    reader.join();
+    collect_all(domain);
+    REQUIRE_MESSAGE(tracked_object::destroyed == 1, "Object should be reclaimed after the other thread is unpinned");
+}
+
+TEST_CASE("test thread exit") {
+    epoch_domain domain;
+    tracked_object::destroyed = 0;
+
+    // The objects retired by the exited thread are adopted with its record by the next thread
+    std::thread retiring_thread([&] {
+        for (std::uint64_t i = 0; i < 10; ++i) {
+            domain.retire(new tracked_object(i));
+        }
+    });
+    retiring_thread.join();
+
+    std::size_t adopted = 0;
+    std::thread adopting_thread([&] {
+        adopted = domain.retired_count();
+        collect_all(domain);
+    });
+    adopting_thread.join();
+    REQUIRE_MESSAGE(adopted == 10, "Record of the exited thread should be reused");
+    REQUIRE_MESSAGE(tracked_object::destroyed == 10, "Objects retired by the exited thread should be reclaimed");
+
+    // The remaining objects are reclaimed by the destruction of the domain
+    {
+        epoch_domain local_domain;
+        std::thread t([&] { local_domain.retire(new tracked_object(0)); });
+        t.join();
+    }
+    REQUIRE_MESSAGE(tracked_object::destroyed == 11, "Objects should be reclaimed by the destruction of the domain");
+
+    // The thread may exit after the destruction of the domain
+    auto short_domain = std::make_unique<epoch_domain>();
+    std::atomic<int> stage{0};
+    std::thread long_thread([&] {
+        short_domain->retire(new tracked_object(0));
+        stage.store(1);
+        while (stage.load() != 2) {
+            std::this_thread::yield();
+        }
+    });
+    while (stage.load() != 1) {
+        std::this_thread::yield();
+    }
+    short_domain.reset();
+    stage.store(2);
+    long_thread.join();
+    REQUIRE_MESSAGE(tracked_object::destroyed == 12, "Objects should be reclaimed by the destruction of the domain");
+
+    // The thread forgets the destroyed domains
+    for (std::uint64_t i = 0; i < 1000; ++i) {
+        epoch_domain temporary_domain;
+        epoch_domain::guard guard{temporary_domain};
+        temporary_domain.retire(new tracked_object(i));
+    }
+    REQUIRE_MESSAGE(tracked_object::destroyed == 1012, "Objects should be reclaimed by the destruction of the domain");
+}
+
+TEST_CASE("test concurrent reclamation") {
+    epoch_domain domain;
+    constexpr std::size_t n_readers = 4;
+    constexpr std::size_t n_writers = 2;
+    constexpr std::uint64_t n_updates = 20000;
+
+    std::atomic<tracked_object*> shared{new tracked_object(0)};
+    std::atomic<std::size_t> finished_writers{0};
+    std::atomic<bool> correct{true};
+    std::vector<std::thread> thread_pool;
+
+    for (std::size_t t = 0; t < n_readers; ++t) {
+        thread_pool.emplace_back([&] {
+            while (finished_writers.load() != n_writers) {
+                epoch_domain::guard guard{domain};
+                tracked_object* object = shared.load(std::memory_order_acquire);
+                // The object cannot be reclaimed while the thread is pinned
+                if (object->canary != tracked_object::alive) {
+                    correct.store(false);
+                }
+            }
+        });
+    }
+
+    for (std::size_t t = 0; t < n_writers; ++t) {
+        thread_pool.emplace_back([&] {
+            for (std::uint64_t i = 0; i < n_updates; ++i) {
+                tracked_object* old_object = shared.exchange(new tracked_object(i), std::memory_order_acq_rel);
+                domain.retire(old_object);
+            }
+            ++finished_writers;
+        });
+    }
+
+    for (auto& thr : thread_pool) {
+        thr.join();
+    }
+    REQUIRE_MESSAGE(correct.load(), "Pinned thread should not observe the reclaimed object");
+    delete shared.load();
+}
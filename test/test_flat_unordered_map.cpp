@@ -0,0 +1,247 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Konstantin Boyarinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include "utils.hpp"
+#include "tomkv/flat_unordered_map.hpp"
+#include <vector>
+#include <thread>
+#include <string>
+
+TEST_CASE("test serial operations") {
+    using umap_type = tomkv::flat_unordered_map<int, int>;
+    using read_accessor = typename umap_type::read_accessor;
+    using write_accessor = typename umap_type::write_accessor;
+
+    umap_type umap;
+
+    REQUIRE_MESSAGE(umap.empty(), "Newly constructed umap should be empty");
+
+    read_accessor racc;
+    REQUIRE_MESSAGE(umap.emplace(racc, 1, 1), "Failed to insert into the empty umap");
+    REQUIRE_MESSAGE((racc.key() == 1 && racc.mapped() == 1), "Incorrect value of read accessor after insertion");
+    racc.release();
+
+    write_accessor wacc;
+    REQUIRE_MESSAGE(umap.emplace(wacc, 2, 2), "Failed to insert a key which is not presented in the table");
+    wacc.mapped() = 4;
+    wacc.release();
+
+    REQUIRE_MESSAGE(!umap.emplace(racc, 1, 100), "Duplicated key was successfully inserted");
+    REQUIRE_MESSAGE(racc.mapped() == 1, "Incorrect value of read accessor after duplicated key insertion");
+    racc.release();
+
+    REQUIRE_MESSAGE(umap.emplace(3, 3), "Failed to insert a key which is not in the table");
+    REQUIRE_MESSAGE(!umap.emplace(3, 300), "Duplicated key was successfully inserted");
+    REQUIRE_MESSAGE(umap.size() == 3, "Incorrect table size");
+
+    REQUIRE_MESSAGE(umap.find(racc, 2), "Failed to find a key which is presented in the table");
+    REQUIRE_MESSAGE(racc.mapped() == 4, "Incorrect value of read accessor after changing and re-finding");
+    racc.release();
+    REQUIRE_MESSAGE(!umap.find(racc, 100), "Key which is not presented was successfully found");
+
+    REQUIRE_MESSAGE(umap.find_copy(3) == 3, "Incorrect copy of the mapped object");
+    REQUIRE_MESSAGE(!umap.find_copy(100).has_value(), "Key which is not presented was successfully found");
+
+    REQUIRE_MESSAGE(umap.erase(1), "Failed to erase the key which is presented in the table");
+    REQUIRE_MESSAGE(!umap.erase(1), "Erased key was erased again");
+    REQUIRE_MESSAGE(!umap.find(racc, 1), "Erased element was successfully found");
+
+    REQUIRE_MESSAGE(umap.find(wacc, 2), "Failed to find a key which is presented in the table");
+    umap.erase(wacc);
+    REQUIRE_MESSAGE(!umap.find(racc, 2), "Erased element was successfully found");
+    REQUIRE_MESSAGE(umap.size() == 1, "Incorrect table size");
+}
+
+TEST_CASE("test growth and tombstones") {
+    tomkv::flat_unordered_map<std::size_t, std::string> umap;
+
+    // Each round leaves the tombstones which should be cleaned up by the rehashing
+    for (std::size_t round = 0; round < 10; ++round) {
+        for (std::size_t i = 0; i < 10000; ++i) {
+            REQUIRE_MESSAGE(umap.emplace(round * 10000 + i, std::to_string(i)), "Emplace should be successful");
+        }
+        for (std::size_t i = 0; i < 10000; ++i) {
+            if (i % 10 != 0) {
+                REQUIRE_MESSAGE(umap.erase(round * 10000 + i), "Erase should be successful");
+            }
+        }
+    }
+
+    REQUIRE_MESSAGE(umap.size() == 10000, "Incorrect size of the map");
+
+    for (std::size_t key = 0; key < 100000; ++key) {
+        typename decltype(umap)::read_accessor racc;
+        bool expected = key % 10 == 0;
+        REQUIRE_MESSAGE(umap.find(racc, key) == expected, "Incorrect element presence");
+        if (expected) {
+            REQUIRE_MESSAGE(racc.mapped() == std::to_string(key % 10000), "Incorrect mapped");
+        }
+    }
+
+    std::size_t visited = 0;
+    umap.for_each([&visited]( std::pair<const std::size_t, std::string>& ) { ++visited; });
+    REQUIRE_MESSAGE(visited == 10000, "Each element should be visited once");
+}
+
+TEST_CASE("test parallel operations") {
+    using umap_type = tomkv::flat_unordered_map<int, int>;
+    umap_type umap;
+    constexpr int num_threads = 4;
+    constexpr int num_elements = 20000;
+
+    std::vector<std::thread> thread_pool;
+
+    for (int t = 0; t < num_threads; ++t) {
+        thread_pool.emplace_back([t, &umap] {
+            for (int i = 0; i < num_elements; ++i) {
+                int key = i * num_threads + t;
+                typename umap_type::write_accessor wacc;
+                REQUIRE_MESSAGE(umap.emplace(wacc, key, 0), "Emplace should be successful");
+                ++wacc.mapped();
+                wacc.release();
+
+                // All threads try to insert the shared keys
+                typename umap_type::read_accessor racc;
+                umap.emplace(racc, -1 - i % 100, i);
+                racc.release();
+
+                if (i % 2 == 0) {
+                    REQUIRE_MESSAGE(umap.erase(key), "Erase should be successful");
+                }
+            }
+        });
+    }
+
+    for (auto& thr : thread_pool) {
+        thr.join();
+    }
+
+    REQUIRE_MESSAGE(umap.size() == num_threads * num_elements / 2 + 100, "Incorrect umap size");
+
+    for (int key = 0; key < num_threads * num_elements; ++key) {
+        std::optional<int> mapped = umap.find_copy(key);
+        bool expected = (key / num_threads) % 2 != 0;
+        REQUIRE_MESSAGE(mapped.has_value() == expected, "Incorrect element presence");
+        if (expected) {
+            REQUIRE_MESSAGE(*mapped == 1, "Incorrect mapped");
+        }
+    }
+}
+
+TEST_CASE("test parallel insertion and erasure with read accessors") {
+    using umap_type = tomkv::flat_unordered_map<int, int>;
+    umap_type umap;
+    constexpr int num_threads = 4;
+    constexpr int num_iterations = 50000;
+    constexpr int num_keys = 8;
+
+    std::vector<std::thread> thread_pool;
+
+    for (int t = 0; t < num_threads; ++t) {
+        thread_pool.emplace_back([t, &umap] {
+            for (int i = 0; i < num_iterations; ++i) {
+                int key = i % num_keys;
+                if (t % 2 == 0) {
+                    // The accessor should point to the element even if it is erased right after the insertion
+                    typename umap_type::read_accessor racc;
+                    umap.emplace(racc, key, key * 10);
+                    REQUIRE_MESSAGE(racc.key() == key, "Incorrect key");
+                    REQUIRE_MESSAGE(racc.mapped() == key * 10, "Incorrect mapped");
+                } else {
+                    umap.erase(key);
+                }
+            }
+        });
+    }
+
+    for (auto& thr : thread_pool) {
+        thr.join();
+    }
+
+    REQUIRE_MESSAGE(umap.size() <= num_keys, "Incorrect umap size");
+}
+
+TEST_CASE("test memory leaks") {
+    using map_type = tomkv::flat_unordered_map<int, std::string, std::hash<int>, std::equal_to<int>,
+                                               utils::counting_allocator<std::pair<const int, std::string>>>;
+
+    utils::counting_allocator<std::pair<const int, std::string>> count_alloc;
+
+    {
+    map_type umap(count_alloc);
+
+    for (int i = 0; i < 10000; ++i) {
+        typename map_type::read_accessor racc;
+        umap.emplace(racc, i, std::to_string(i));
+        umap.emplace(i, std::to_string(i)); // Emplace duplicated
+    }
+
+    for (int i = 0; i < 1000; ++i) {
+        umap.erase(i);
+    }
+
+    map_type umap_copy(umap);
+    map_type umap_moved(std::move(umap_copy));
+    umap_moved.clear();
+    } // maps are destroyed here
+
+    REQUIRE_MESSAGE(count_alloc.elements_allocated != 0, "Incorrect test setup");
+    REQUIRE_MESSAGE(count_alloc.allocations == count_alloc.deallocations, "Memory leak: number of allocate and deallocate calls should be equal");
+    REQUIRE_MESSAGE(count_alloc.elements_allocated == count_alloc.elements_deallocated,
+                    "Memory leak: number of elements allocated and the number of elements deallocated should be equal");
+    REQUIRE_MESSAGE(count_alloc.elements_constructed == count_alloc.elements_destroyed,
+                    "Memory leak: number of elements constructed and the number of elements destroyed should be equal");
+    count_alloc.reset();
+}
+
+TEST_CASE("test copy and move") {
+    using umap_type = tomkv::flat_unordered_map<int, int>;
+    umap_type umap1;
+
+    for (int i = 0; i < 1000; ++i) {
+        umap1.emplace(i, i);
+    }
+
+    umap_type umap2(umap1);
+    REQUIRE_MESSAGE(umap2.size() == umap1.size(), "Incorrect size of the copy");
+
+    umap_type umap3(std::move(umap1));
+    REQUIRE_MESSAGE(umap1.empty(), "Moved-from umap should be empty");
+    REQUIRE_MESSAGE(umap3.size() == 1000, "Incorrect size of the move-constructed umap");
+
+    umap_type umap4;
+    umap4.emplace(5000, 5000);
+    umap4 = umap2;
+    umap1 = std::move(umap2);
+
+    for (int i = 0; i < 1000; ++i) {
+        REQUIRE_MESSAGE(umap1.find_copy(i) == i, "Element should be found in the move-assigned umap");
+        REQUIRE_MESSAGE(umap3.find_copy(i) == i, "Element should be found in the move-constructed umap");
+        REQUIRE_MESSAGE(umap4.find_copy(i) == i, "Element should be found in the copy-assigned umap");
+        REQUIRE_MESSAGE(!umap2.find_copy(i).has_value(), "Element should not be found in the moved-from umap");
+    }
+    REQUIRE_MESSAGE(!umap4.find_copy(5000).has_value(), "Old element should not be found in the copy-assigned umap");
+}
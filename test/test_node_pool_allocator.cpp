@@ -0,0 +1,129 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Konstantin Boyarinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "doctest.h"
+#include "tomkv/node_pool_allocator.hpp"
+#include "tomkv/unordered_map.hpp"
+#include <vector>
+#include <thread>
+#include <string>
+#include <cstdint>
+
+TEST_CASE("test single object allocations") {
+    tomkv::node_pool_allocator<std::uint64_t> alloc;
+    std::vector<std::uint64_t*> pointers;
+
+    // More than a single slab
+    for (std::uint64_t i = 0; i < 10000; ++i) {
+        std::uint64_t* ptr = alloc.allocate(1);
+        REQUIRE_MESSAGE(reinterpret_cast<std::uintptr_t>(ptr) % alignof(std::max_align_t) == 0, "Incorrect alignment");
+        *ptr = i;
+        pointers.push_back(ptr);
+    }
+
+    for (std::uint64_t i = 0; i < pointers.size(); ++i) {
+        REQUIRE_MESSAGE(*pointers[i] == i, "Allocated blocks should not overlap");
+    }
+
+    for (auto ptr : pointers) {
+        alloc.deallocate(ptr, 1);
+    }
+
+    // Arrays are allocated by the global operator new
+    std::uint64_t* array = alloc.allocate(100);
+    for (std::uint64_t i = 0; i < 100; ++i) {
+        array[i] = i;
+    }
+    alloc.deallocate(array, 100);
+
+    tomkv::node_pool_allocator<std::string> other_alloc{alloc};
+    REQUIRE_MESSAGE(alloc == other_alloc, "Node pool allocators should be always equal");
+}
+
+TEST_CASE("test cross-thread deallocation") {
+    tomkv::node_pool_allocator<std::uint64_t> alloc;
+    constexpr std::size_t n_blocks = 10000;
+    std::vector<std::uint64_t*> pointers(n_blocks);
+
+    // Blocks are allocated by one thread and deallocated by the other
+    std::thread producer([&] {
+        for (std::size_t i = 0; i < n_blocks; ++i) {
+            pointers[i] = alloc.allocate(1);
+            *pointers[i] = i;
+        }
+    });
+    producer.join();
+
+    std::thread consumer([&] {
+        for (std::size_t i = 0; i < n_blocks; ++i) {
+            REQUIRE_MESSAGE(*pointers[i] == i, "Incorrect value in the block");
+            alloc.deallocate(pointers[i], 1);
+        }
+    });
+    consumer.join();
+
+    // Blocks returned on the thread exit are reused
+    for (std::size_t i = 0; i < n_blocks; ++i) {
+        pointers[i] = alloc.allocate(1);
+    }
+    for (std::size_t i = 0; i < n_blocks; ++i) {
+        alloc.deallocate(pointers[i], 1);
+    }
+}
+
+TEST_CASE("test unordered_map with node pool allocator") {
+    using allocator_type = tomkv::node_pool_allocator<std::pair<const int, std::string>>;
+    using umap_type = tomkv::unordered_map<int, std::string, std::hash<int>, std::equal_to<int>, allocator_type>;
+
+    umap_type umap;
+    std::vector<std::thread> thread_pool;
+
+    for (int t = 0; t < 4; ++t) {
+        thread_pool.emplace_back([t, &umap] {
+            for (int i = 0; i < 10000; ++i) {
+                int key = i * 4 + t;
+                umap.emplace(key, std::to_string(key));
+                if (i % 2 == 0) {
+                    umap.erase(key);
+                }
+            }
+        });
+    }
+
+    for (auto& thr : thread_pool) {
+        thr.join();
+    }
+
+    REQUIRE_MESSAGE(umap.size() == 20000, "Incorrect umap size");
+
+    for (int key = 0; key < 40000; ++key) {
+        typename umap_type::read_accessor racc;
+        bool expected = (key / 4) % 2 != 0;
+        REQUIRE_MESSAGE(umap.find(racc, key) == expected, "Incorrect element presence");
+        if (expected) {
+            REQUIRE_MESSAGE(racc.mapped() == std::to_string(key), "Incorrect mapped");
+        }
+    }
+}
@@ -0,0 +1,244 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Konstantin Boyarinov
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include "doctest.h"
+#include "utils.hpp"
+#include "tomkv/ordered_map.hpp"
+#include <vector>
+#include <thread>
+#include <string>
+#include <map>
+#include <atomic>
+
+TEST_CASE("test serial operations") {
+    using omap_type = tomkv::ordered_map<int, std::string>;
+    omap_type omap;
+    REQUIRE_MESSAGE(omap.empty(), "Map should be empty after construction");
+
+    // Inserted in the pseudo-random order
+    for (int i = 0; i < 1000; ++i) {
+        int key = (i * 7919) % 1000;
+        REQUIRE_MESSAGE(omap.emplace(key, std::to_string(key)), "Element should be inserted");
+    }
+    REQUIRE_MESSAGE(!omap.emplace(5, "five"), "Duplicate should not be inserted");
+    REQUIRE_MESSAGE(omap.size() == 1000, "Incorrect size");
+
+    {
+        omap_type::read_accessor racc;
+        REQUIRE_MESSAGE(omap.find(racc, 5), "Element should be found");
+        REQUIRE_MESSAGE(racc.mapped() == "5", "Duplicate should not change the element");
+    }
+    {
+        omap_type::write_accessor wacc;
+        REQUIRE(omap.find(wacc, 5));
+        wacc.mapped() = "five";
+    }
+    REQUIRE_MESSAGE(omap.find_copy(5) == std::string("five"), "Element should be modified by the write accessor");
+    REQUIRE_MESSAGE(!omap.find_copy(1000), "Missing element should not be found");
+    REQUIRE_MESSAGE(omap.contains(999), "Element should be contained");
+    REQUIRE_MESSAGE(!omap.contains(-1), "Missing element should not be contained");
+
+    // The elements are visited in the order of the keys
+    int expected = 0;
+    omap.for_each([&expected]( const std::pair<const int, std::string>& value ) {
+        REQUIRE_MESSAGE(value.first == expected, "Elements should be ordered");
+        ++expected;
+    });
+    REQUIRE_MESSAGE(expected == 1000, "Each element should be visited");
+
+    for (int i = 0; i < 1000; i += 2) {
+        REQUIRE_MESSAGE(omap.erase(i), "Element should be erased");
+    }
+    REQUIRE_MESSAGE(!omap.erase(0), "Element should be erased once");
+    REQUIRE_MESSAGE(omap.size() == 500, "Incorrect size after erasure");
+
+    {
+        omap_type::write_accessor wacc;
+        REQUIRE(omap.find(wacc, 1));
+        omap.erase(wacc);
+        REQUIRE_MESSAGE(!omap.contains(1), "Element should be erased by the accessor");
+    }
+
+    omap_type omap_copy(omap);
+    REQUIRE_MESSAGE(omap_copy.size() == 499, "Incorrect size of the copy");
+    REQUIRE_MESSAGE(omap_copy.find_copy(999) == std::string("999"), "Incorrect element of the copy");
+
+    omap.clear();
+    REQUIRE_MESSAGE(omap.empty(), "Map should be empty after clear");
+    REQUIRE_MESSAGE(omap_copy.size() == 499, "Copy should not be affected by clear");
+
+    omap_type omap_moved(std::move(omap_copy));
+    REQUIRE_MESSAGE(omap_moved.size() == 499, "Incorrect size after move");
+    REQUIRE_MESSAGE(omap_moved.find_copy(999) == std::string("999"), "Incorrect element after move");
+    REQUIRE_MESSAGE(omap_copy.empty(), "Moved-from map should be empty");
+    REQUIRE_MESSAGE(omap_copy.emplace(1, "1"), "Moved-from map should be usable");
+    REQUIRE_MESSAGE(!omap_moved.contains(1), "Moved-from map should not share the elements");
+}
+
+TEST_CASE("test range queries") {
+    tomkv::ordered_map<int, int> omap;
+    for (int i = 0; i < 100; i += 10) {
+        omap.emplace(i, i);
+    }
+
+    tomkv::ordered_map<int, int>::read_accessor racc;
+    REQUIRE(omap.lower_bound(racc, 20));
+    REQUIRE_MESSAGE(racc.key() == 20, "lower_bound should find the equal key");
+    REQUIRE(omap.lower_bound(racc, 21));
+    REQUIRE_MESSAGE(racc.key() == 30, "lower_bound should find the next key");
+    REQUIRE(omap.upper_bound(racc, 20));
+    REQUIRE_MESSAGE(racc.key() == 30, "upper_bound should skip the equal key");
+    REQUIRE(omap.next(racc));
+    REQUIRE_MESSAGE(racc.key() == 40, "next should move to the next key");
+    REQUIRE_MESSAGE(!omap.upper_bound(racc, 90), "There is no key after the last one");
+    REQUIRE_MESSAGE(!omap.lower_bound(racc, 91), "There is no key after the last one");
+    REQUIRE(omap.first(racc));
+    REQUIRE_MESSAGE(racc.key() == 0, "first should find the smallest key");
+    racc.release();
+
+    std::vector<int> keys;
+    omap.for_each(15, 55, [&keys]( const std::pair<const int, int>& value ) {
+        keys.push_back(value.first);
+    });
+    REQUIRE_MESSAGE(keys == std::vector<int>({20, 30, 40, 50}), "Incorrect range [15, 55)");
+
+    keys.clear();
+    omap.for_each(50, 50, [&keys]( const std::pair<const int, int>& value ) {
+        keys.push_back(value.first);
+    });
+    REQUIRE_MESSAGE(keys.empty(), "Empty range should not be visited");
+}
+
+TEST_CASE("test parallel operations") {
+    constexpr int n_threads = 8;
+    constexpr int n_keys = 20000;
+    tomkv::ordered_map<int, int> omap;
+
+    // Each thread inserts and erases its own keys, and scans the ranges of all keys
+    std::atomic<bool> ordered{true};
+    std::vector<std::thread> thread_pool;
+    for (int t = 0; t < n_threads; ++t) {
+        thread_pool.emplace_back([&omap, &ordered, t] {
+            for (int i = t; i < n_keys; i += n_threads) {
+                omap.emplace(i, i);
+                if (i % 3 == 0) {
+                    omap.erase(i);
+                }
+                if (i % 100 == t) {
+                    tomkv::ordered_map<int, int>::read_accessor racc;
+                    int prev = -1;
+                    for (bool found = omap.lower_bound(racc, i / 2); found && racc.key() < i / 2 + 200; found = omap.next(racc)) {
+                        if (racc.key() <= prev || racc.mapped() != racc.key()) {
+                            ordered.store(false);
+                        }
+                        prev = racc.key();
+                    }
+                }
+            }
+        });
+    }
+    for (auto& thr : thread_pool) {
+        thr.join();
+    }
+
+    REQUIRE_MESSAGE(ordered.load(), "Scans should visit the elements in the order of the keys");
+    REQUIRE_MESSAGE(omap.size() == std::size_t(n_keys - (n_keys + 2) / 3), "Incorrect size");
+    int expected = 0;
+    omap.for_each([&expected]( const std::pair<const int, int>& value ) {
+        if (expected % 3 == 0) {
+            ++expected;
+        }
+        REQUIRE_MESSAGE(value.first == expected, "Incorrect element after the parallel operations");
+        ++expected;
+    });
+}
+
+TEST_CASE("test concurrent updates of the same keys") {
+    constexpr int n_threads = 8;
+    constexpr int n_keys = 64;
+    constexpr int n_iterations = 20000;
+    tomkv::ordered_map<int, std::size_t> omap;
+
+    // The same keys are inserted, incremented and erased by all of the threads
+    std::vector<std::thread> thread_pool;
+    for (int t = 0; t < n_threads; ++t) {
+        thread_pool.emplace_back([&omap, t] {
+            for (int i = 0; i < n_iterations; ++i) {
+                int key = (i * 31 + t) % n_keys;
+                if (i % 4 == 0) {
+                    omap.erase(key);
+                } else {
+                    tomkv::ordered_map<int, std::size_t>::write_accessor wacc;
+                    omap.emplace(wacc, key, 0);
+                    ++wacc.mapped();
+                }
+            }
+        });
+    }
+    for (auto& thr : thread_pool) {
+        thr.join();
+    }
+
+    std::size_t count = 0;
+    omap.for_each([&count]( const std::pair<const int, std::size_t>& ) { ++count; });
+    REQUIRE_MESSAGE(count == omap.size(), "Size should be equal to the number of visited elements");
+    REQUIRE_MESSAGE(count <= std::size_t(n_keys), "Keys should be unique");
+}
+
+TEST_CASE("test memory leaks") {
+    using omap_type = tomkv::ordered_map<int, std::string, std::less<int>,
+                                         utils::counting_allocator<std::pair<const int, std::string>>>;
+
+    utils::counting_allocator<std::pair<const int, std::string>> count_alloc;
+
+    {
+    omap_type omap(count_alloc);
+
+    for (int i = 0; i < 10000; ++i) {
+        omap.emplace(i, std::to_string(i));
+        omap.emplace(i, std::to_string(i)); // Emplace duplicated
+    }
+    for (int i = 0; i < 1000; ++i) {
+        omap.erase(i);
+    }
+
+    omap_type omap_copy(omap);
+    omap_copy.clear();
+
+    // The nodes are stolen, not copied - only the empty head is created
+    std::size_t constructed = count_alloc.elements_constructed;
+    omap_type omap_moved(std::move(omap));
+    REQUIRE_MESSAGE(count_alloc.elements_constructed == constructed + 1, "Move should not construct the elements");
+    } // maps are destroyed here
+
+    REQUIRE_MESSAGE(count_alloc.elements_allocated != 0, "Incorrect test setup");
+    REQUIRE_MESSAGE(count_alloc.allocations == count_alloc.deallocations, "Memory leak: number of allocate and deallocate calls should be equal");
+    REQUIRE_MESSAGE(count_alloc.elements_allocated == count_alloc.elements_deallocated,
+                    "Memory leak: number of elements allocated and the number of elements deallocated should be equal");
+    REQUIRE_MESSAGE(count_alloc.elements_constructed == count_alloc.elements_destroyed,
+                    "Memory leak: number of elements constructed and the number of elements destroyed should be equal");
+    count_alloc.reset();
+}
@@ -27,6 +27,9 @@
 #include "utils.hpp"
 #include <tomkv/storage.hpp>
 #include <tomkv/tom_management.hpp>
+#include <algorithm>
+#include <atomic>
+#include <functional>
 #include <string>
 #include <thread>
 #include "boost/property_tree/ptree.hpp"
@@ -178,6 +181,31 @@ TEST_CASE("test mount, modify and read (single mount)") {
     tomkv::remove_tom(tom_name);
 }
 
+TEST_CASE("test nested mount path") {
+    auto tom_name = prepare_tom("1");
+    tomkv::storage<int, int> storage;
+
+    // The mount point is found by the prefix of the path which contains the delimiters
+    storage.mount("mnt/x", tom_name, "a");
+
+    auto key_list = storage.key("mnt/x/c/d");
+    REQUIRE_MESSAGE(key_list.size() == 1, "Only one path should be mounted");
+    REQUIRE_MESSAGE(*key_list.begin() == 4, "Incorrect key on the path mnt/x/c/d");
+
+    key_list = storage.key("mnt/x");
+    REQUIRE_MESSAGE(key_list.size() == 1, "Only one path should be mounted");
+    REQUIRE_MESSAGE(*key_list.begin() == 1, "Incorrect key on the path mnt/x");
+
+    bool thrown = false;
+    try {
+        storage.key("mnt/y/c/d");
+    } catch(tomkv::unmounted_path&) {
+        thrown = true;
+    }
+    REQUIRE_MESSAGE(thrown, "The path with the unmounted prefix should not be found");
+    tomkv::remove_tom(tom_name);
+}
+
 TEST_CASE("test unmounted path") {
     tomkv::storage<int, int> st;
 
@@ -1027,3 +1055,194 @@ TEST_CASE("test storage modification with huge over-subscription") {
     REQUIRE_MESSAGE(*mapped.begin() == thread_count, "Incorrect mapped after modification");
     tomkv::remove_tom(tom_name);
 }
+
+TEST_CASE("test reaping outdated keys") {
+    auto tom_name = prepare_tom("1");
+
+    tomkv::storage<int, int> st;
+
+    st.mount("mnt", tom_name, "a/c");
+
+    bool inserted = st.insert("mnt/q", std::pair{42, 4200}, std::chrono::seconds(1));
+    REQUIRE_MESSAGE(inserted, "Insertion should be successful");
+
+    // a/c has a child node d
+    set_outdated(tom_name, "a.c", std::chrono::seconds(1));
+
+    std::size_t reaped = st.reap_outdated();
+    REQUIRE_MESSAGE(reaped == 0, "No nodes should be reaped before the lifetime is over");
+
+    // Make the keys outdated
+    std::this_thread::sleep_for(std::chrono::seconds(2));
+
+    reaped = st.reap_outdated();
+    REQUIRE_MESSAGE(reaped == 2, "Incorrect number of reaped nodes");
+    REQUIRE_MESSAGE(st.reaped_count() == 2, "Incorrect total number of reaped nodes");
+
+    pt::ptree tree;
+    pt::read_xml(tom_name, tree);
+
+    REQUIRE_MESSAGE(!tree.get_child_optional("tom.root.a.c.q"), "Outdated node should be removed from the tom");
+    REQUIRE_MESSAGE(!tree.get_optional<int>("tom.root.a.c.key"), "Outdated key should be removed from the tom");
+    REQUIRE_MESSAGE(!tree.get_optional<int>("tom.root.a.c.lifetime"), "Lifetime of the outdated node should be removed from the tom");
+    REQUIRE_MESSAGE(tree.get<int>("tom.root.a.c.d.key") == 4, "Child of the outdated node should not be removed");
+
+    auto keys = st.key("mnt/d");
+    REQUIRE_MESSAGE(keys.size() == 1, "Child of the outdated node should be available");
+
+    reaped = st.reap_outdated();
+    REQUIRE_MESSAGE(reaped == 0, "Reaped nodes should not be reaped again");
+
+    // Test the background reaper
+    inserted = st.insert("mnt/d/q", std::pair{42, 4200}, std::chrono::seconds(1));
+    REQUIRE_MESSAGE(inserted, "Insertion should be successful");
+
+    st.start_reaper(std::chrono::milliseconds(100));
+    std::this_thread::sleep_for(std::chrono::seconds(3));
+    st.stop_reaper();
+
+    REQUIRE_MESSAGE(st.reaped_count() == 3, "Outdated node should be reaped by the background reaper");
+
+    pt::read_xml(tom_name, tree);
+    REQUIRE_MESSAGE(!tree.get_child_optional("tom.root.a.c.d.q"), "Outdated node should be removed by the background reaper");
+    tomkv::remove_tom(tom_name);
+}
+
+TEST_CASE("test lifetime with manual clock") {
+    auto tom_name = prepare_tom("1");
+
+    tomkv::manual_clock clock;
+    tomkv::storage<int, int, std::allocator<std::pair<const int, int>>, tomkv::manual_clock> st(clock);
+
+    st.mount("mnt", tom_name, "a/c");
+
+    bool inserted = st.insert("mnt/q", std::pair{42, 4200}, std::chrono::seconds(10));
+    REQUIRE_MESSAGE(inserted, "Insertion should be successful");
+
+    clock.advance(std::chrono::seconds(9));
+
+    auto values = st.value("mnt/q");
+    REQUIRE_MESSAGE(values.size() == 1, "Key should be available before the lifetime is over");
+    REQUIRE_MESSAGE(st.reap_outdated() == 0, "No nodes should be reaped before the lifetime is over");
+
+    clock.advance(std::chrono::seconds(2));
+
+    values = st.value("mnt/q");
+    REQUIRE_MESSAGE(values.size() == 0, "Key should not be available after the lifetime is over");
+
+    std::size_t modified = st.set_mapped("mnt/q", 42);
+    REQUIRE_MESSAGE(modified == 0, "Outdated key should not be modified");
+
+    // Renew the node
+    modified = st.set_mapped_as_new("mnt/q", 4242);
+    REQUIRE_MESSAGE(modified == 1, "Outdated key should be modified as new");
+    REQUIRE_MESSAGE(st.reap_outdated() == 0, "Renewed node should not be reaped");
+
+    clock.advance(std::chrono::seconds(11));
+    REQUIRE_MESSAGE(st.reap_outdated() == 1, "Outdated node should be reaped");
+
+    values = st.value("mnt/q");
+    REQUIRE_MESSAGE(values.size() == 0, "Reaped key should not be available");
+    tomkv::remove_tom(tom_name);
+}
+
+TEST_CASE("test lifetimes appearing in the tom without lifetimes") {
+    auto tom_name = prepare_tom("1");
+
+    tomkv::manual_clock clock;
+    tomkv::storage<int, int, std::allocator<std::pair<const int, int>>, tomkv::manual_clock> st(clock);
+
+    st.mount("mnt", tom_name, "a/c");
+
+    bool inserted = st.insert("mnt/p", std::pair{1, 100});
+    REQUIRE_MESSAGE(inserted, "Insertion should be successful");
+
+    inserted = st.insert("mnt/q", std::pair{42, 4200}, std::chrono::seconds(10));
+    REQUIRE_MESSAGE(inserted, "Insertion with lifetime should be successful");
+
+    clock.advance(std::chrono::seconds(11));
+
+    REQUIRE_MESSAGE(st.value("mnt/q").size() == 0, "Key should not be available after the lifetime is over");
+    REQUIRE_MESSAGE(st.value("mnt/p").size() == 1, "Key without lifetime should be available");
+
+    // Outdated node is replaced by the node without lifetime
+    inserted = st.insert("mnt/q", std::pair{43, 4300});
+    REQUIRE_MESSAGE(inserted, "Insertion instead of the outdated key should be successful");
+
+    clock.advance(std::chrono::seconds(100));
+
+    auto values = st.value("mnt/q");
+    REQUIRE_MESSAGE(values.size() == 1, "Key without lifetime should never become outdated");
+    REQUIRE_MESSAGE(values.begin()->second == 4300, "Incorrect value");
+    REQUIRE_MESSAGE(st.reap_outdated() == 0, "Nodes without lifetime should not be reaped");
+    tomkv::remove_tom(tom_name);
+}
+
+TEST_CASE("test lifetimes added to the tom externally") {
+    auto tom_name = prepare_tom("1");
+
+    tomkv::manual_clock clock;
+    tomkv::storage<int, int, std::allocator<std::pair<const int, int>>, tomkv::manual_clock> st(clock);
+
+    st.mount("mnt", tom_name, "a/c");
+
+    // The expiration index of the tom is built on the first read
+    REQUIRE_MESSAGE(st.value("mnt/d").size() == 1, "Key should be available");
+    REQUIRE_MESSAGE(st.expiration_index_size() == 0, "The tom has no lifetimes");
+
+    // The index is rebuilt on the next read since the file was modified
+    set_outdated(tom_name, "a.c.d", std::chrono::seconds(10));
+    REQUIRE_MESSAGE(st.value("mnt/d").size() == 1, "Key should be available before the lifetime is over");
+    REQUIRE_MESSAGE(st.expiration_index_size() == 1, "The lifetime added externally should be tracked");
+
+    clock.advance(std::chrono::seconds(11));
+    REQUIRE_MESSAGE(st.value("mnt/d").size() == 0, "Key should not be available after the lifetime is over");
+    REQUIRE_MESSAGE(st.reap_outdated() == 1, "Outdated node should be reaped");
+    tomkv::remove_tom(tom_name);
+}
+
+TEST_CASE("test expiration index size with renewed node") {
+    auto tom_name = prepare_tom("1");
+
+    tomkv::manual_clock clock;
+    tomkv::storage<int, int, std::allocator<std::pair<const int, int>>, tomkv::manual_clock> st(clock);
+
+    st.mount("mnt", tom_name, "a/c");
+
+    const std::size_t lifetime = 5;
+    bool inserted = st.insert("mnt/q", std::pair{42, 4200}, std::chrono::seconds(lifetime));
+    REQUIRE_MESSAGE(inserted, "Insertion with lifetime should be successful");
+
+    // Each renewal starts the reaping and the next renewal while the tom is locked,
+    // so the tree is not destroyed and the expiration index is not rebuilt from XML between them
+    const std::size_t num_renewals = 50;
+    std::vector<std::thread> thread_pool(2 * num_renewals - 1);
+    std::atomic<std::size_t> renewed{0};
+    std::atomic<std::size_t> reaped{0};
+
+    std::function<void(std::size_t)> renew = [&]( std::size_t step ) {
+        renewed += st.modify_mapped_as_new("mnt/q", [&, step]( int m ) {
+            if (step + 1 < num_renewals) {
+                // The node is renewed every second, the deadlines tracked by the previous renewals become due
+                clock.advance(std::chrono::seconds(1));
+                thread_pool[2 * step + 1] = std::thread([&] { reaped += st.reap_outdated(); });
+                thread_pool[2 * step + 2] = std::thread(renew, step + 1);
+                // Let both threads wait for the tom
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            return m + 1;
+        });
+    };
+
+    thread_pool[0] = std::thread(renew, 0);
+    for (auto& thr : thread_pool) {
+        thr.join();
+    }
+
+    REQUIRE_MESSAGE(renewed == num_renewals, "Outdated key should be modified as new");
+    REQUIRE_MESSAGE(reaped == 0, "Renewed node should not be reaped");
+    // Only the deadlines of the renewals during the last lifetime are not due yet
+    REQUIRE_MESSAGE(st.expiration_index_size() <= lifetime + 2, "Expiration index should not grow with the number of renewals");
+    REQUIRE_MESSAGE(st.value("mnt/q").size() == 1, "Renewed key should be available");
+    tomkv::remove_tom(tom_name);
+}
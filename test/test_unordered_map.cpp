@@ -30,6 +30,15 @@
 #include <thread>
 #include <algorithm>
 #include <random>
+#include <string>
+#include <string_view>
+#include <optional>
+#include <iterator>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <chrono>
+#include <atomic>
 
 TEST_CASE("test serial operations") {
     using key_type = int;
@@ -460,7 +469,7 @@ void test_copy() {
 }
 
 template <typename UmapType>
-void test_move_from_content( const UmapType& umap ) {
+void test_move_from_content( UmapType& umap ) {
     REQUIRE_MESSAGE(umap.size() == 0, "Incorrect moved-from umap size");
 
     for (int i = 0; i < 1000; ++i) {
@@ -483,16 +492,24 @@ void test_move() {
 
     REQUIRE_MESSAGE(umap_backup.size() == umap1.size(), "Incorrect test setup");
 
+    std::size_t bucket_count = umap1.bucket_count();
+    std::size_t initial_bucket_count = umap_type().bucket_count();
+    REQUIRE_MESSAGE(bucket_count > initial_bucket_count, "Incorrect test setup");
+
     // Move construct new map
     if constexpr (MoveWithAllocator) {
         // TODO: add tests for steal/deep move
         umap_type umap2(std::move(umap1), umap1.get_allocator());
         test_move_from_content(umap1);
+        REQUIRE_MESSAGE(umap1.bucket_count() == initial_bucket_count, "Moved-from umap should keep only the initial buckets");
+        REQUIRE_MESSAGE(umap2.bucket_count() == bucket_count, "Buckets should be moved");
         delete(umap1_ptr);
         test_copy_content(umap_backup, umap2);
     } else {
         umap_type umap2(std::move(umap1));
         test_move_from_content(umap1);
+        REQUIRE_MESSAGE(umap1.bucket_count() == initial_bucket_count, "Moved-from umap should keep only the initial buckets");
+        REQUIRE_MESSAGE(umap2.bucket_count() == bucket_count, "Buckets should be moved");
         delete(umap1_ptr);
         test_copy_content(umap_backup, umap2);
     }
@@ -504,8 +521,8 @@ TEST_CASE("test copy constructor") {
 }
 
 TEST_CASE("test move constructor") {
-    test_copy</*With allocator?*/true>();
-    test_copy</*With allocator?*/false>();
+    test_move</*With allocator?*/true>();
+    test_move</*With allocator?*/false>();
 }
 
 TEST_CASE("test assignments") {
@@ -552,4 +569,896 @@ TEST_CASE("test assignments") {
 
     REQUIRE_MESSAGE(umap3.find(racc, 200), "New element should be founc in move-assigned unordered_map");
     REQUIRE_MESSAGE(!umap2.find(racc, 200), "Move-assigned-from unordered_map should be unchanged");
-}
\ No newline at end of file
+}
+template <typename UnorderedMap>
+void test_parallel_growth() {
+    using umap_type = UnorderedMap;
+
+    umap_type umap;
+    constexpr int n_threads = 4;
+    constexpr int n_items = 20000;
+
+    // Elements are found and erased while the buckets are split by the other threads
+    std::vector<std::thread> thread_pool;
+    std::atomic<int> missed = 0;
+
+    for (int t = 0; t < n_threads; ++t) {
+        thread_pool.emplace_back([t, &umap, &missed] {
+            for (int i = 0; i < n_items; ++i) {
+                int key = i * n_threads + t;
+                umap.emplace(key, key);
+
+                typename umap_type::read_accessor racc;
+                if (!umap.find(racc, key) || racc.mapped() != key) {
+                    ++missed;
+                }
+                racc.release();
+
+                if (i % 2 == 0) {
+                    typename umap_type::write_accessor wacc;
+                    if (umap.find(wacc, key)) {
+                        umap.erase(wacc);
+                    } else {
+                        ++missed;
+                    }
+                }
+            }
+        });
+    }
+
+    for (auto& thr : thread_pool) {
+        thr.join();
+    }
+
+    REQUIRE_MESSAGE(missed == 0, "Inserted elements should be found while the table grows");
+    REQUIRE_MESSAGE(umap.size() == n_threads * n_items / 2, "Incorrect umap size after parallel growth");
+
+    umap_type umap_copy = umap;
+    REQUIRE_MESSAGE(umap_copy.size() == umap.size(), "Incorrect size of the copied unordered_map");
+
+    for (int key = 0; key < n_threads * n_items; ++key) {
+        typename umap_type::read_accessor racc;
+        bool expected = (key / n_threads) % 2 != 0;
+        REQUIRE_MESSAGE(umap.find(racc, key) == expected, "Incorrect element presence after parallel growth");
+        REQUIRE_MESSAGE(umap_copy.find(racc, key) == expected, "Incorrect element presence in the copied unordered_map");
+    }
+}
+
+TEST_CASE("test parallel growth") {
+    test_parallel_growth<tomkv::unordered_map<int, int>>();
+}
+
+TEST_CASE("test find copy") {
+    struct mapped_type {
+        int first;
+        int second;
+    };
+    using umap_type = tomkv::unordered_map<int, mapped_type>;
+
+    umap_type umap;
+    constexpr int n_items = 1000;
+    constexpr int n_iterations = 50;
+
+    for (int i = 0; i < n_items; ++i) {
+        umap.emplace(i, mapped_type{i, i});
+    }
+
+    auto copy = umap.find_copy(10);
+    REQUIRE_MESSAGE(copy.has_value(), "Element should be found");
+    REQUIRE_MESSAGE((copy->first == 10 && copy->second == 10), "Incorrect mapped in the copy");
+    REQUIRE_MESSAGE(!umap.find_copy(n_items).has_value(), "Non-existent element should not be found");
+
+    // Lock-free readers should never observe partially modified or erased elements
+    std::vector<std::thread> thread_pool;
+    std::atomic<int> torn = 0;
+
+    for (int t = 0; t < 4; ++t) {
+        thread_pool.emplace_back([t, &umap, &torn] {
+            for (int it = 0; it < n_iterations; ++it) {
+                if (t == 0) {
+                    // Modify the elements through the write accessors
+                    for (int i = 0; i < n_items; ++i) {
+                        umap_type::write_accessor wacc;
+                        if (umap.find(wacc, i)) {
+                            wacc.mapped().first = it;
+                            wacc.mapped().second = it;
+                        }
+                    }
+                } else if (t == 1) {
+                    // Erase and insert the odd elements, forcing the nodes to be reclaimed
+                    for (int i = 1; i < n_items; i += 2) {
+                        umap.erase(i);
+                        umap.emplace(i, mapped_type{it, it});
+                    }
+                } else {
+                    for (int i = 0; i < n_items; ++i) {
+                        auto copy = umap.find_copy(i);
+                        if (i % 2 == 0 && !copy.has_value()) {
+                            ++torn;
+                        }
+                        if (copy.has_value() && copy->first != copy->second) {
+                            ++torn;
+                        }
+                    }
+                }
+            }
+        });
+    }
+
+    for (auto& thr : thread_pool) {
+        thr.join();
+    }
+
+    REQUIRE_MESSAGE(torn == 0, "Lock-free find should return consistent copies");
+    REQUIRE_MESSAGE(umap.size() == n_items, "Incorrect umap size");
+
+    // Non-trivially copyable mapped types are copied under the lock
+    tomkv::unordered_map<int, std::string> string_umap;
+    string_umap.emplace(1, "one");
+    auto string_copy = string_umap.find_copy(1);
+    REQUIRE_MESSAGE((string_copy.has_value() && *string_copy == "one"), "Incorrect copy of the string");
+}
+
+TEST_CASE("test striped locking") {
+    using umap_type = tomkv::unordered_map<int, int, std::hash<int>, std::equal_to<int>,
+                                           std::allocator<std::pair<const int, int>>,
+                                           tomkv::striped_locking<4>>;
+
+    umap_type umap;
+
+    for (int i = 0; i < 100; ++i) {
+        umap_type::write_accessor wacc;
+        REQUIRE_MESSAGE(umap.emplace(wacc, i, i), "Insertion should be successful");
+        ++wacc.mapped();
+    }
+
+    for (int i = 0; i < 100; ++i) {
+        umap_type::read_accessor racc;
+        REQUIRE_MESSAGE(umap.find(racc, i), "Element should be found");
+        REQUIRE_MESSAGE(racc.mapped() == i + 1, "Incorrect mapped");
+        racc.release();
+        REQUIRE_MESSAGE(umap.find_copy(i) == i + 1, "Incorrect copy of mapped");
+    }
+
+    for (int i = 0; i < 100; i += 2) {
+        REQUIRE_MESSAGE(umap.erase(i), "Erasure should be successful");
+    }
+    REQUIRE_MESSAGE(umap.size() == 50, "Incorrect umap size after erasure");
+
+    // Parent and child buckets share the stripes while the table grows
+    test_parallel_growth<umap_type>();
+    test_parallel_growth<tomkv::unordered_map<int, int, std::hash<int>, std::equal_to<int>,
+                                              std::allocator<std::pair<const int, int>>,
+                                              tomkv::striped_locking<>>>();
+}
+
+TEST_CASE("test hash memoization") {
+    static std::size_t hasher_calls = 0;
+    static std::size_t equality_calls = 0;
+
+    struct counting_hasher {
+        std::size_t operator()( const std::string& key ) const {
+            ++hasher_calls;
+            return std::hash<std::string>{}(key);
+        }
+    };
+
+    struct counting_equal {
+        bool operator()( const std::string& lhs, const std::string& rhs ) const {
+            ++equality_calls;
+            return lhs == rhs;
+        }
+    };
+
+    using umap_type = tomkv::unordered_map<std::string, int, counting_hasher, counting_equal>;
+    constexpr std::size_t n_items = 10000;
+
+    umap_type umap;
+
+    // The table grows several times, but the hash codes of the elements are not recomputed
+    for (std::size_t i = 0; i < n_items; ++i) {
+        umap.emplace("key" + std::to_string(i), int(i));
+    }
+    REQUIRE_MESSAGE(hasher_calls == n_items, "Hash code should be computed once per insertion");
+    REQUIRE_MESSAGE(equality_calls == 0, "Keys with different hash codes should not be compared");
+
+    for (std::size_t i = 0; i < n_items; ++i) {
+        umap_type::read_accessor racc;
+        REQUIRE_MESSAGE(umap.find(racc, "key" + std::to_string(i)), "Element should be found");
+    }
+    REQUIRE_MESSAGE(equality_calls == n_items, "Only the equal keys should be compared");
+
+    umap_type umap_copy = umap;
+    REQUIRE_MESSAGE(hasher_calls == 2 * n_items, "Hash codes should not be recomputed while copying");
+    REQUIRE_MESSAGE(umap_copy.size() == n_items, "Incorrect size of the copied unordered_map");
+
+    umap_type::read_accessor racc;
+    REQUIRE_MESSAGE(umap_copy.find(racc, "key0"), "Element should be found in the copied unordered_map");
+}
+
+TEST_CASE("test capacity management") {
+    using umap_type = tomkv::unordered_map<int, int>;
+    constexpr int n_items = 10000;
+
+    umap_type umap;
+    umap.reserve(n_items);
+    std::size_t reserved_bucket_count = umap.bucket_count();
+    REQUIRE_MESSAGE(reserved_bucket_count >= n_items, "Incorrect number of buckets after reserve");
+
+    for (int i = 0; i < n_items; ++i) {
+        umap.emplace(i, i);
+    }
+    REQUIRE_MESSAGE(umap.bucket_count() == reserved_bucket_count, "The table should not grow after reserve");
+    REQUIRE_MESSAGE(umap.load_factor() <= umap.max_load_factor(), "Load factor should not exceed the maximum");
+
+    {
+        // The number of elements is not representable as float exactly
+        umap_type large_umap;
+        large_umap.max_load_factor(float(1 << 20));
+        large_umap.reserve((std::size_t(1) << 30) + 1);
+        REQUIRE_MESSAGE(large_umap.bucket_count() > (std::size_t(1) << 10), "Incorrect number of buckets after the large reserve");
+    }
+
+    umap.rehash(2 * reserved_bucket_count);
+    REQUIRE_MESSAGE(umap.bucket_count() == 2 * reserved_bucket_count, "Incorrect number of buckets after rehash");
+    umap.rehash(1);
+    REQUIRE_MESSAGE(umap.bucket_count() == 2 * reserved_bucket_count, "Rehash should not decrease the number of buckets");
+
+    // Erase the most of the elements and merge the buckets
+    for (int i = 0; i < n_items; ++i) {
+        if (i % 100 != 0) {
+            umap.erase(i);
+        }
+    }
+    umap.shrink_to_fit();
+    REQUIRE_MESSAGE(umap.bucket_count() < reserved_bucket_count, "The number of buckets should be decreased");
+    REQUIRE_MESSAGE(umap.size() == n_items / 100, "Incorrect size after shrink_to_fit");
+
+    for (int i = 0; i < n_items; ++i) {
+        umap_type::read_accessor racc;
+        REQUIRE_MESSAGE(umap.find(racc, i) == (i % 100 == 0), "Incorrect element presence after shrink_to_fit");
+    }
+
+    // The table grows again after shrinking
+    for (int i = n_items; i < 2 * n_items; ++i) {
+        REQUIRE_MESSAGE(umap.emplace(i, i), "Insertion after shrink_to_fit should be successful");
+    }
+    REQUIRE_MESSAGE(umap.size() == n_items + n_items / 100, "Incorrect size after the growth");
+
+    // Higher load factor results in the smaller number of buckets
+    umap_type dense_umap;
+    dense_umap.max_load_factor(4.0);
+    for (int i = 0; i < n_items; ++i) {
+        dense_umap.emplace(i, i);
+    }
+    REQUIRE_MESSAGE(dense_umap.bucket_count() * 4 <= umap.bucket_count(), "Incorrect number of buckets with the higher load factor");
+    REQUIRE_MESSAGE(dense_umap.load_factor() <= 4.0, "Load factor should not exceed the maximum");
+
+    umap_type presized_umap(n_items);
+    REQUIRE_MESSAGE(presized_umap.bucket_count() >= n_items, "Incorrect number of buckets of presized unordered_map");
+
+    // The largest segments of the big table span several huge pages
+    constexpr std::size_t huge_bucket_count = std::size_t(1) << 20;
+    umap_type huge_umap(huge_bucket_count);
+    REQUIRE_MESSAGE(huge_umap.bucket_count() == huge_bucket_count, "Incorrect number of buckets of presized unordered_map");
+    for (int i = 0; i < n_items; ++i) {
+        huge_umap.emplace(i, i);
+    }
+    for (int i = 0; i < n_items; ++i) {
+        REQUIRE_MESSAGE(huge_umap.find_copy(i) == i, "Element should be found in the big table");
+    }
+    huge_umap.shrink_to_fit();
+    REQUIRE_MESSAGE(huge_umap.bucket_count() < huge_bucket_count, "The number of buckets should be decreased");
+    REQUIRE_MESSAGE(huge_umap.size() == n_items, "Incorrect size after shrink_to_fit");
+
+    // Reserve concurrently with the insertions
+    umap_type concurrent_umap;
+    std::vector<std::thread> thread_pool;
+
+    for (int t = 0; t < 4; ++t) {
+        thread_pool.emplace_back([t, &concurrent_umap] {
+            for (int i = 0; i < n_items; ++i) {
+                if (t == 0) {
+                    if (i % 1000 == 0) {
+                        concurrent_umap.reserve(std::size_t(i) * 8);
+                    }
+                } else {
+                    concurrent_umap.emplace(i * 3 + t, i);
+                }
+            }
+        });
+    }
+
+    for (auto& thr : thread_pool) {
+        thr.join();
+    }
+
+    REQUIRE_MESSAGE(concurrent_umap.size() == 3 * n_items, "Incorrect size after the concurrent reserve");
+    for (int i = 0; i < n_items; ++i) {
+        for (int t = 1; t < 4; ++t) {
+            REQUIRE_MESSAGE(concurrent_umap.find_copy(i * 3 + t) == i, "Element should be found after the concurrent reserve");
+        }
+    }
+}
+
+TEST_CASE("test concurrent for each") {
+    using umap_type = tomkv::unordered_map<int, int>;
+    constexpr int n_stable = 10000;
+    constexpr int n_threads = 4;
+
+    umap_type umap;
+    for (int i = 0; i < n_stable; ++i) {
+        umap.emplace(i, i);
+    }
+
+    // Split the range into the parts for each of the traversing threads
+    std::vector<umap_type::bucket_range> ranges{umap.range()};
+    while (ranges.size() < n_threads) {
+        auto r = ranges.back().split();
+        std::swap(ranges.back(), ranges.front());
+        ranges.push_back(r);
+    }
+
+    std::vector<std::atomic<int>> visits(n_stable);
+    std::atomic<int> finished = 0;
+    std::vector<std::thread> thread_pool;
+
+    for (int t = 0; t < 2 * n_threads; ++t) {
+        thread_pool.emplace_back([t, &umap, &ranges, &visits, &finished] {
+            if (t < n_threads) {
+                // Traverse the part of the map
+                ranges[t].for_each([&visits]( std::pair<const int, int>& value ) {
+                    if (value.first < n_stable) {
+                        ++visits[value.first];
+                    }
+                });
+                ++finished;
+            } else {
+                // Grow the table and insert and erase the elements during the traversal
+                for (int i = 0; finished.load() < n_threads || i < 1000; ++i) {
+                    int key = n_stable + i * n_threads + t;
+                    umap.emplace(key, key);
+                    if (i % 2 == 0) {
+                        umap.erase(key);
+                    }
+                }
+            }
+        });
+    }
+
+    for (auto& thr : thread_pool) {
+        thr.join();
+    }
+
+    for (int i = 0; i < n_stable; ++i) {
+        REQUIRE_MESSAGE(visits[i] == 1, "Element which is present during the traversal should be visited exactly once");
+    }
+
+    // The whole table can be traversed while the other threads operate on it
+    int total = 0;
+    umap.for_each([&total]( std::pair<const int, int>& ) { ++total; });
+    REQUIRE_MESSAGE(std::size_t(total) == umap.size(), "Each element should be visited once");
+}
+
+template <typename UnorderedMap>
+void test_bulk_insertion() {
+    using value_type = std::pair<const int, int>;
+    constexpr int n_keys = 50000;
+
+    // Each key is repeated twice, the first value should be inserted
+    std::vector<value_type> input;
+    for (int i = 0; i < 2 * n_keys; ++i) {
+        input.emplace_back(i % n_keys, i);
+    }
+
+    UnorderedMap umap(input.begin(), input.end(), tomkv::parallel_policy(4));
+    REQUIRE_MESSAGE(umap.size() == std::size_t(n_keys), "Incorrect size after the parallel construction");
+    REQUIRE_MESSAGE(umap.load_factor() <= umap.max_load_factor(), "The table should be pre-sized for the input");
+    for (int i = 0; i < n_keys; ++i) {
+        auto value = umap.find_copy(i);
+        REQUIRE_MESSAGE((value && *value == i), "The first of the equal keys should be inserted");
+    }
+
+    // Insertion into the non-empty table does not replace the existing elements
+    std::vector<value_type> more;
+    for (int i = 0; i < 2 * n_keys; ++i) {
+        more.emplace_back(i, -i);
+    }
+    umap.insert(more.begin(), more.end(), tomkv::parallel_policy(4));
+    REQUIRE_MESSAGE(umap.size() == std::size_t(2 * n_keys), "Incorrect size after the parallel insertion");
+    for (int i = 0; i < 2 * n_keys; ++i) {
+        auto value = umap.find_copy(i);
+        REQUIRE_MESSAGE((value && *value == (i < n_keys ? i : -i)), "Incorrect value after the parallel insertion");
+    }
+
+    // Copy of the large table is made by several threads
+    UnorderedMap umap_copy(umap);
+    REQUIRE_MESSAGE(umap_copy.size() == umap.size(), "Incorrect size of the copy");
+    for (int i = 0; i < 2 * n_keys; ++i) {
+        REQUIRE_MESSAGE(umap_copy.find_copy(i) == umap.find_copy(i), "Incorrect value in the copy");
+    }
+}
+
+TEST_CASE("test bulk insertion") {
+    test_bulk_insertion<tomkv::unordered_map<int, int>>();
+    test_bulk_insertion<tomkv::unordered_map<int, int, std::hash<int>, std::equal_to<int>,
+                                             std::allocator<std::pair<const int, int>>, tomkv::striped_locking<>>>();
+
+    // Serial range constructor accepts the input iterators
+    std::vector<std::pair<int, std::string>> input{{1, "one"}, {2, "two"}, {1, "uno"}};
+    tomkv::unordered_map<int, std::string> umap(input.begin(), input.end());
+    REQUIRE_MESSAGE(umap.size() == 2, "Incorrect size after the range construction");
+    REQUIRE_MESSAGE(umap.find_copy(1) == std::string("one"), "The first of the equal keys should be inserted");
+
+    // Small input is inserted by the calling thread
+    tomkv::unordered_map<int, std::string> small(input.begin(), input.end(), tomkv::parallel_policy());
+    REQUIRE_MESSAGE(small.size() == 2, "Incorrect size after the range construction");
+}
+
+TEST_CASE("test size counters") {
+    using umap_type = tomkv::unordered_map<int, int>;
+    constexpr int n_items = 100000;
+    constexpr int n_threads = 4;
+
+    umap_type umap;
+    std::vector<std::thread> thread_pool;
+
+    // Elements inserted by one thread are erased by the other, so the per-thread counters become unbalanced
+    for (int t = 0; t < n_threads; ++t) {
+        thread_pool.emplace_back([t, &umap] {
+            for (int i = 0; i < n_items; ++i) {
+                umap.emplace(i * n_threads + t, i);
+                if (i % 2 == 0) {
+                    umap.erase(i * n_threads + (t + 1) % n_threads);
+                }
+            }
+        });
+    }
+
+    for (auto& thr : thread_pool) {
+        thr.join();
+    }
+
+    std::size_t expected_size = 0;
+    umap.for_each([&expected_size]( std::pair<const int, int>& ) { ++expected_size; });
+    REQUIRE_MESSAGE(umap.size() == expected_size, "Incorrect size after the concurrent insertions and erasures");
+
+    // The approximate size lags behind by a fraction of the bucket count
+    std::size_t approximate_size = umap.approximate_size();
+    std::size_t max_difference = umap.bucket_count() / 4;
+    REQUIRE_MESSAGE((approximate_size + max_difference >= expected_size && approximate_size <= expected_size + max_difference),
+                    "Approximate size is too far from the size");
+    REQUIRE_MESSAGE(umap.load_factor() <= 1.25f * umap.max_load_factor(), "The table should grow with the size");
+
+    umap_type umap_copy(umap);
+    REQUIRE_MESSAGE(umap_copy.size() == expected_size, "Incorrect size of the copy");
+    REQUIRE_MESSAGE(umap_copy.approximate_size() == expected_size, "Incorrect approximate size of the copy");
+
+    umap.clear();
+    REQUIRE_MESSAGE((umap.size() == 0 && umap.approximate_size() == 0), "Incorrect size after clear");
+}
+
+// Key which counts its constructions to check that the heterogeneous operations do not create the keys
+struct counted_key {
+    counted_key( std::string_view v ) : value(v) { ++constructions; }
+    counted_key( const counted_key& other ) : value(other.value) { ++constructions; }
+
+    std::string value;
+    static inline std::size_t constructions = 0;
+}; // struct counted_key
+
+struct transparent_key_hasher {
+    using is_transparent = void;
+
+    std::size_t operator()( std::string_view v ) const { return std::hash<std::string_view>{}(v); }
+    std::size_t operator()( const counted_key& k ) const { return (*this)(std::string_view(k.value)); }
+}; // struct transparent_key_hasher
+
+struct transparent_key_equality {
+    using is_transparent = void;
+
+    std::string_view view( std::string_view v ) const { return v; }
+    std::string_view view( const counted_key& k ) const { return k.value; }
+
+    template <typename K1, typename K2>
+    bool operator()( const K1& lhs, const K2& rhs ) const { return view(lhs) == view(rhs); }
+}; // struct transparent_key_equality
+
+TEST_CASE("test heterogeneous lookup") {
+    using umap_type = tomkv::unordered_map<counted_key, int, transparent_key_hasher, transparent_key_equality>;
+    constexpr int n_items = 1000;
+
+    umap_type umap;
+    for (int i = 0; i < n_items; ++i) {
+        std::string key = std::to_string(i);
+        REQUIRE_MESSAGE(umap.try_emplace(std::string_view(key), i), "Insertion of the new key should be successful");
+    }
+    REQUIRE_MESSAGE(counted_key::constructions == n_items, "The key should be constructed once per insertion");
+
+    counted_key::constructions = 0;
+    for (int i = 0; i < n_items; ++i) {
+        std::string key = std::to_string(i);
+        std::string_view key_view = key;
+
+        REQUIRE_MESSAGE(!umap.try_emplace(key_view, -1), "Insertion of the existing key should fail");
+
+        umap_type::read_accessor racc;
+        REQUIRE_MESSAGE(umap.find(racc, key_view), "Element should be found by the string_view");
+        REQUIRE_MESSAGE(racc.mapped() == i, "Incorrect element found by the string_view");
+        racc.release();
+
+        umap_type::write_accessor wacc;
+        REQUIRE_MESSAGE(umap.try_emplace(wacc, key_view, -1) == false, "Insertion of the existing key should fail");
+        REQUIRE_MESSAGE(wacc.mapped() == i, "Accessor should refer the existing element");
+        wacc.release();
+
+        REQUIRE_MESSAGE(umap.find_copy(key_view) == i, "Element should be found by the string_view");
+    }
+    REQUIRE_MESSAGE(counted_key::constructions == 0, "Heterogeneous lookup should not construct the keys");
+
+    for (int i = 0; i < n_items; i += 2) {
+        std::string key = std::to_string(i);
+        REQUIRE_MESSAGE(umap.erase(std::string_view(key)), "Element should be erased by the string_view");
+    }
+    REQUIRE_MESSAGE(counted_key::constructions == 0, "Heterogeneous erasure should not construct the keys");
+    REQUIRE_MESSAGE(umap.size() == n_items / 2, "Incorrect size after the erasure");
+
+    // The key and the mapped object are constructed only on insertion
+    tomkv::unordered_map<int, std::string> string_umap;
+    std::string long_value(100, 'x');
+    REQUIRE_MESSAGE(string_umap.try_emplace(1, long_value), "Insertion of the new key should be successful");
+    REQUIRE_MESSAGE(!string_umap.try_emplace(1, std::move(long_value)), "Insertion of the existing key should fail");
+    REQUIRE_MESSAGE(long_value.size() == 100, "The arguments should not be moved if the key exists");
+}
+
+// Mapped object which counts its constructions
+struct counted_mapped {
+    counted_mapped( int v = 0 ) : value(v) { ++constructions; }
+    counted_mapped( const counted_mapped& other ) : value(other.value) { ++constructions; }
+
+    int value;
+    static inline std::size_t constructions = 0;
+}; // struct counted_mapped
+
+TEST_CASE("test in-place updates") {
+    using umap_type = tomkv::unordered_map<int, int>;
+    constexpr int n_items = 1000;
+    constexpr int n_threads = 4;
+
+    umap_type umap;
+
+    // insert_or_assign
+    for (int i = 0; i < n_items; ++i) {
+        REQUIRE_MESSAGE(umap.insert_or_assign(i, i), "The new element should be inserted");
+    }
+    for (int i = 0; i < n_items; ++i) {
+        REQUIRE_MESSAGE(!umap.insert_or_assign(i, -i), "The existing element should be assigned");
+        REQUIRE_MESSAGE(umap.find_copy(i) == -i, "Incorrect value after the assignment");
+    }
+    REQUIRE_MESSAGE(umap.size() == n_items, "Incorrect size after insert_or_assign");
+
+    // update_if modifies only the existing elements which satisfy the predicate
+    for (int i = 0; i < 2 * n_items; ++i) {
+        bool updated = umap.update_if(i, []( const int& v ) { return v % 2 == 0; }, []( int& v ) { v = 1; });
+        REQUIRE_MESSAGE(updated == (i < n_items && i % 2 == 0), "Incorrect result of update_if");
+    }
+    for (int i = 0; i < n_items; ++i) {
+        REQUIRE_MESSAGE(umap.find_copy(i) == (i % 2 == 0 ? 1 : -i), "Incorrect value after update_if");
+    }
+    REQUIRE_MESSAGE(umap.size() == n_items, "update_if should not insert the elements");
+
+    // Concurrent counters are incremented in place
+    umap_type counters;
+    std::vector<std::thread> thread_pool;
+    for (int t = 0; t < n_threads; ++t) {
+        thread_pool.emplace_back([&counters] {
+            for (int i = 0; i < n_items; ++i) {
+                counters.compute(i % 100, []( int& counter ) { ++counter; });
+            }
+        });
+    }
+    for (auto& thr : thread_pool) {
+        thr.join();
+    }
+
+    REQUIRE_MESSAGE(counters.size() == 100, "compute should insert the missing elements");
+    for (int i = 0; i < 100; ++i) {
+        REQUIRE_MESSAGE(counters.find_copy(i) == n_threads * n_items / 100, "Incorrect counter after the concurrent compute");
+    }
+
+    // emplace with the key does not construct the mapped object if the key exists
+    tomkv::unordered_map<int, counted_mapped> counted_umap;
+    counted_mapped value(42);
+    REQUIRE_MESSAGE(counted_umap.emplace(1, value), "The new element should be inserted");
+    REQUIRE_MESSAGE(counted_umap.emplace(std::pair<const int, counted_mapped>(2, value)), "The new element should be inserted");
+
+    counted_mapped::constructions = 0;
+    REQUIRE_MESSAGE(!counted_umap.emplace(1, value), "The existing element should not be replaced");
+    REQUIRE_MESSAGE(!counted_umap.try_emplace(1, value), "The existing element should not be replaced");
+    tomkv::unordered_map<int, counted_mapped>::read_accessor racc;
+    REQUIRE_MESSAGE(!counted_umap.emplace(racc, 1, 0), "The existing element should not be replaced");
+    REQUIRE_MESSAGE(racc.mapped().value == 42, "Accessor should refer the existing element");
+    racc.release();
+    REQUIRE_MESSAGE(counted_mapped::constructions == 0, "Mapped object should not be constructed if the key exists");
+}
+
+TEST_CASE("test find many") {
+    using umap_type = tomkv::unordered_map<int, int>;
+    constexpr int n_items = 10000;
+
+    umap_type umap;
+    for (int i = 0; i < n_items; i += 2) {
+        umap.emplace(i, i * 10);
+    }
+
+    // The number of keys is not a multiple of the prefetch window
+    for (std::size_t n_keys : {std::size_t(0), std::size_t(1), std::size_t(7), std::size_t(17), std::size_t(n_items + 3)}) {
+        std::vector<int> keys;
+        for (std::size_t i = 0; i < n_keys; ++i) {
+            keys.push_back(int((i * 7919) % (n_items + 100)));
+        }
+
+        std::vector<std::optional<int>> results;
+        std::size_t found = umap.find_many(keys.begin(), keys.end(), std::back_inserter(results));
+
+        REQUIRE_MESSAGE(results.size() == n_keys, "Result should be written for each key");
+        std::size_t expected_found = 0;
+        for (std::size_t i = 0; i < n_keys; ++i) {
+            bool present = keys[i] < n_items && keys[i] % 2 == 0;
+            expected_found += present;
+            REQUIRE_MESSAGE(results[i].has_value() == present, "Incorrect presence of the element found by find_many");
+            if (present) {
+                REQUIRE_MESSAGE(*results[i] == keys[i] * 10, "Incorrect element found by find_many");
+            }
+        }
+        REQUIRE_MESSAGE(found == expected_found, "Incorrect number of the found elements");
+    }
+
+    // Non-trivially copyable mapped objects are copied under the read lock
+    tomkv::unordered_map<std::string, std::string> string_umap;
+    string_umap.emplace("a", "1");
+    string_umap.emplace("b", "2");
+    std::vector<std::string> keys{"a", "c", "b"};
+    std::vector<std::optional<std::string>> results(keys.size());
+    REQUIRE_MESSAGE(string_umap.find_many(keys.begin(), keys.end(), results.begin()) == 2, "Incorrect number of the found elements");
+    REQUIRE_MESSAGE((results[0] == std::string("1") && !results[1] && results[2] == std::string("2")), "Incorrect elements found by find_many");
+}
+
+TEST_CASE("test snapshots") {
+    constexpr int n_items = 20000;
+    const std::string path = "test_unordered_map_snapshot.bin";
+
+    // Fixed size records
+    tomkv::unordered_map<int, int> umap;
+    for (int i = 0; i < n_items; ++i) {
+        umap.emplace(i, i * 2);
+    }
+    umap.save_snapshot(path);
+
+    tomkv::unordered_map<int, int> loaded_umap;
+    loaded_umap.load_snapshot(path, tomkv::parallel_policy(4));
+    REQUIRE_MESSAGE(loaded_umap.size() == n_items, "Incorrect size of the loaded unordered_map");
+    for (int i = 0; i < n_items; ++i) {
+        REQUIRE_MESSAGE(loaded_umap.find_copy(i) == i * 2, "Incorrect element of the loaded unordered_map");
+    }
+
+    // The existing elements are not replaced by the loaded ones
+    tomkv::unordered_map<int, int> nonempty_umap;
+    nonempty_umap.emplace(0, -1);
+    nonempty_umap.emplace(-1, -1);
+    nonempty_umap.load_snapshot(path);
+    REQUIRE_MESSAGE(nonempty_umap.size() == n_items + 1, "Incorrect size of the non-empty unordered_map after loading");
+    REQUIRE_MESSAGE(nonempty_umap.find_copy(0) == -1, "The existing element should not be replaced");
+
+    // Variable size records
+    tomkv::unordered_map<std::string, std::string> string_umap;
+    for (int i = 0; i < n_items; ++i) {
+        string_umap.emplace(std::to_string(i), std::string(std::size_t(i % 50), 'x'));
+    }
+    string_umap.emplace("", "empty key");
+    string_umap.save_snapshot(path);
+
+    tomkv::unordered_map<std::string, std::string> loaded_string_umap;
+    loaded_string_umap.load_snapshot(path, tomkv::parallel_policy(4));
+    REQUIRE_MESSAGE(loaded_string_umap.size() == n_items + 1, "Incorrect size of the loaded unordered_map");
+    for (int i = 0; i < n_items; ++i) {
+        REQUIRE_MESSAGE(loaded_string_umap.find_copy(std::to_string(i)) == std::string(std::size_t(i % 50), 'x'),
+                        "Incorrect element of the loaded unordered_map");
+    }
+    REQUIRE_MESSAGE(loaded_string_umap.find_copy("") == "empty key", "Incorrect element with the empty key");
+
+    // The type mismatch is detected
+    tomkv::unordered_map<int, int> mismatched_umap;
+    REQUIRE_THROWS_AS(mismatched_umap.load_snapshot(path), tomkv::snapshot_error);
+    REQUIRE_MESSAGE(mismatched_umap.empty(), "Nothing should be loaded from the mismatched snapshot");
+
+    // Truncated snapshot is detected before the insertion
+    {
+        std::FILE* file = std::fopen(path.c_str(), "r+b");
+        REQUIRE(file != nullptr);
+        std::fseek(file, 0, SEEK_END);
+        long size = std::ftell(file);
+        std::fclose(file);
+        std::vector<char> content(static_cast<std::size_t>(size));
+        file = std::fopen(path.c_str(), "rb");
+        REQUIRE(std::fread(content.data(), 1, content.size(), file) == content.size());
+        std::fclose(file);
+        file = std::fopen(path.c_str(), "wb");
+        std::fwrite(content.data(), 1, content.size() - 1, file);
+        std::fclose(file);
+    }
+    tomkv::unordered_map<std::string, std::string> truncated_umap;
+    REQUIRE_THROWS_AS(truncated_umap.load_snapshot(path), tomkv::snapshot_error);
+    REQUIRE_MESSAGE(truncated_umap.empty(), "Nothing should be loaded from the truncated snapshot");
+
+    // Inflated element count is detected before the allocations for the records
+    auto inflate_element_count = [&path] {
+        std::FILE* file = std::fopen(path.c_str(), "r+b");
+        REQUIRE(file != nullptr);
+        std::uint64_t element_count = std::uint64_t(1) << 60;
+        std::fseek(file, long(offsetof(tomkv::internal::snapshot_header, element_count)), SEEK_SET);
+        REQUIRE(std::fwrite(&element_count, sizeof(element_count), 1, file) == 1);
+        std::fclose(file);
+    };
+
+    string_umap.save_snapshot(path);
+    inflate_element_count();
+    tomkv::unordered_map<std::string, std::string> inflated_string_umap;
+    REQUIRE_THROWS_AS(inflated_string_umap.load_snapshot(path), tomkv::snapshot_error);
+    REQUIRE_MESSAGE(inflated_string_umap.empty(), "Nothing should be loaded from the snapshot with the inflated count");
+
+    nonempty_umap.save_snapshot(path);
+    inflate_element_count();
+    tomkv::unordered_map<int, int> inflated_umap;
+    REQUIRE_THROWS_AS(inflated_umap.load_snapshot(path), tomkv::snapshot_error);
+    REQUIRE_MESSAGE(inflated_umap.empty(), "Nothing should be loaded from the snapshot with the inflated count");
+
+    std::remove(path.c_str());
+    REQUIRE_THROWS_AS(truncated_umap.load_snapshot(path), tomkv::snapshot_error);
+
+    // Snapshot is saved concurrently with the modifications
+    // Elements which are not modified during the saving are always in the snapshot
+    tomkv::unordered_map<int, int> concurrent_umap;
+    for (int i = 0; i < n_items; ++i) {
+        concurrent_umap.emplace(i, i);
+    }
+    std::atomic<bool> done{false};
+    std::thread writer([&] {
+        for (int i = n_items; !done.load(); ++i) {
+            concurrent_umap.emplace(i, i);
+            concurrent_umap.erase(i - 100 < n_items ? i : i - 100);
+        }
+    });
+    concurrent_umap.save_snapshot(path);
+    done.store(true);
+    writer.join();
+
+    tomkv::unordered_map<int, int> loaded_concurrent_umap;
+    loaded_concurrent_umap.load_snapshot(path);
+    for (int i = 0; i < n_items; ++i) {
+        REQUIRE_MESSAGE(loaded_concurrent_umap.find_copy(i) == i, "Unmodified element should be in the snapshot");
+    }
+    std::remove(path.c_str());
+}
+
+TEST_CASE("test contended bucket") {
+    using umap_type = tomkv::unordered_map<int, std::size_t>;
+    constexpr std::size_t n_threads = 8;
+    constexpr std::size_t n_updates = 5000;
+
+    umap_type umap;
+    umap.emplace(0, 0);
+    std::atomic<bool> found{true};
+
+    // Short critical sections are waited by spinning, long ones - by parking
+    for (bool long_hold : {false, true}) {
+        std::vector<std::thread> thread_pool;
+        for (std::size_t t = 0; t < n_threads; ++t) {
+            thread_pool.emplace_back([&umap, &found, long_hold, t] {
+                for (std::size_t i = 0; i < (long_hold ? n_updates / 50 : n_updates); ++i) {
+                    if (t % 2 == 0) {
+                        umap_type::write_accessor wacc;
+                        if (!umap.find(wacc, 0)) {
+                            found.store(false);
+                            continue;
+                        }
+                        std::size_t value = wacc.mapped();
+                        if (long_hold) {
+                            std::this_thread::sleep_for(std::chrono::microseconds(50));
+                        }
+                        wacc.mapped() = value + 1;
+                    } else {
+                        umap_type::read_accessor racc;
+                        if (!umap.find(racc, 0)) {
+                            found.store(false);
+                        }
+                    }
+                }
+            });
+        }
+        for (auto& thr : thread_pool) {
+            thr.join();
+        }
+    }
+    REQUIRE_MESSAGE(found.load(), "Element should be found under the contention");
+    REQUIRE_MESSAGE(umap.find_copy(0) == n_threads / 2 * (n_updates + n_updates / 50), "Updates under the write lock should not be lost");
+}
+
+struct constant_hash {
+    std::size_t operator()( int ) const { return 0; }
+};
+
+TEST_CASE("test statistics") {
+    using umap_type = tomkv::unordered_map<int, int>;
+    constexpr int n_elements = 1000;
+
+    umap_type umap;
+    tomkv::hash_table_statistics stats = umap.stats();
+    REQUIRE_MESSAGE(stats.size == 0, "Incorrect size of the empty table");
+    REQUIRE_MESSAGE(stats.max_chain_length == 0, "Empty table should have no chains");
+
+    for (int i = 0; i < n_elements; ++i) {
+        umap.emplace(i, i);
+    }
+    stats = umap.stats();
+    REQUIRE_MESSAGE(stats.size == std::size_t(n_elements), "Incorrect size");
+    REQUIRE_MESSAGE(stats.bucket_count == umap.bucket_count(), "Incorrect bucket count");
+    REQUIRE_MESSAGE(stats.load_factor <= stats.max_load_factor * 2, "Load factor should be kept near the maximum");
+
+    std::size_t counted_buckets = 0, counted_elements = 0;
+    for (std::size_t length = 0; length < stats.chain_lengths.size(); ++length) {
+        counted_buckets += stats.chain_lengths[length];
+        counted_elements += length * stats.chain_lengths[length];
+    }
+    REQUIRE_MESSAGE(counted_buckets + stats.unsplit_buckets == stats.bucket_count, "Each bucket should be counted once");
+    REQUIRE_MESSAGE(counted_elements == std::size_t(n_elements), "Each element should be counted once");
+    REQUIRE_MESSAGE(stats.chain_lengths.size() == stats.max_chain_length + 1, "Incorrect maximal chain length");
+
+    // All of the elements with the poor hash function are stored in one chain
+    tomkv::unordered_map<int, int, constant_hash> collided_umap;
+    for (int i = 0; i < n_elements; ++i) {
+        collided_umap.emplace(i, i);
+    }
+    REQUIRE_MESSAGE(collided_umap.stats().max_chain_length == std::size_t(n_elements), "Collisions should be reported by the chain lengths");
+
+    REQUIRE_MESSAGE(stats.events_recorded == tomkv::internal::statistics_enabled, "Events should be recorded only if enabled");
+    if (stats.events_recorded) {
+        REQUIRE_MESSAGE(stats.growth_count > 0, "Growth should be recorded");
+        REQUIRE_MESSAGE(stats.split_count > 0, "Splits of the buckets should be recorded");
+        std::uint64_t growths = 0;
+        for (std::uint64_t count : stats.growth_durations) {
+            growths += count;
+        }
+        REQUIRE_MESSAGE(growths == stats.growth_count, "Each growth should be in the histogram");
+
+        // The reader waits for the writer which holds the lock
+        umap_type::write_accessor wacc;
+        REQUIRE(umap.find(wacc, 1));
+        std::thread reader([&umap] {
+            umap_type::read_accessor racc;
+            umap.find(racc, 1);
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        wacc.release();
+        reader.join();
+
+        stats = umap.stats();
+        REQUIRE_MESSAGE(stats.contended_lock_count > 0, "Contended locking should be recorded");
+        REQUIRE_MESSAGE(stats.total_lock_wait_ns > 0, "Waiting time should be recorded");
+
+        // The traversal waits for the writer which holds the lock of one of the buckets
+        std::uint64_t contended_before_traversal = stats.contended_lock_count;
+        REQUIRE(umap.find(wacc, 1));
+        std::thread traversal([&umap] {
+            umap.for_each([]( umap_type::value_type& ) {});
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        wacc.release();
+        traversal.join();
+
+        stats = umap.stats();
+        REQUIRE_MESSAGE(stats.contended_lock_count > contended_before_traversal, "Contended locking by the traversal should be recorded");
+    } else {
+        REQUIRE_MESSAGE(stats.growth_count == 0, "Events should not be recorded");
+    }
+}
@@ -25,6 +25,7 @@
 #ifndef __TOMKV_TEST_UTILS_HPP
 #define __TOMKV_TEST_UTILS_HPP
 
+#include <cstdlib>
 #include <memory>
 
 namespace utils {